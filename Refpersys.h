@@ -243,11 +243,20 @@ typedef uint32_t RpsHash_t;
 
 typedef struct RpsZoneObject_st RpsObject_t;	///// forward declaration
 typedef struct RpsPayl_AttrTable_st RpsAttrTable_t;	//// forward declaration
+typedef struct RpsShape_st RpsShape_t;	//// forward declaration
 typedef struct RpsClosure_st RpsClosure_t;	//// forward declaration
 
 /// callback function, by convention returning false to "stop" or "fail" e.g. some iteration
 typedef bool rps_object_callback_sig_t (RpsObject_t * ob, void *data);
 
+/// callback for parallel iteration on objects, also given the index of
+/// the worker thread; returning false stops the whole iteration
+typedef bool rps_parallel_object_callback_sig_t (RpsObject_t * ob,
+						 int workix, void *data);
+/// callback for parallel loops on indexes, e.g. of arrays
+typedef void rps_parallel_index_callback_sig_t (unsigned long ix,
+						int workix, void *data);
+
 /// a value is a word, sometimes a pointer, sometimes a tagged integer (odd word)
 typedef uintptr_t RpsValue_t;
 
@@ -276,6 +285,8 @@ extern RpsObject_t *rps_loader_json_to_object (RpsLoader_t * ld, json_t * jv);
 typedef void rpsldpysig_t (RpsObject_t * obz, RpsLoader_t * ld,
 			   const json_t * jv, int spaceindex);
 #define RPS_PAYLOADING_PREFIX "rpsldpy_"
+extern rpsldpysig_t rpsldpy_classinfo, rpsldpy_symbol, rpsldpy_agenda,
+  rpsldpy_setob, rpsldpy_string_dictionary, rpsldpy_space;
 
 /// the dumper internals are in file dump_rps.c
 typedef struct RpsPayl_Dumper_st RpsDumper_t;	///// forward declaration
@@ -658,22 +669,36 @@ extern int rps_print_oid (RpsOid oid);
  *
  * The ob_class is an object representing the RefPerSys class of our
  * object.  The ob_space is its space. Different spaces are persisted
- * in different files.  The ob_attrtable is for the attributes of that
- * object.  The ob_routsig and ob_routaddr is for the routine inside
+ * in different files.  The attributes of that object are usually
+ * described by its shared immutable ob_shape, giving the index of each
+ * attribute in the ob_shapvals array of values; a NULL ob_shape means
+ * no attributes.  Objects with too many attributes have instead an
+ * ob_attrtable and no shape.  The ob_routsig and ob_routaddr is for the routine inside
  * that object, e.g. when that object is a closure connective.  The
  * ob_nbcomp is the used length of the component array ob_comparr,
  * whose allocated size is ob_compsize.  The ob_payload is the
- * optional object payload.
+ * optional object payload.  The ob_index is a small dense index,
+ * unique among live objects and recycled once the object is freed,
+ * used by bit sets of objects.  The ob_version is incremented when
+ * the object changes, for optimistic transactions.  The ob_history
+ * keeps older states still visible to some open snapshot, and
+ * ob_changepoch is the snapshot clock when the current state was made.
  ****************************************************************/
 #define RPSFIELDS_OBJECT                                        \
   RPSFIELDS_ZONED_VALUE;                                        \
   RpsOid ob_id;                                                 \
   double ob_mtime;                                              \
   long ob_magic       /*should be RPS_OBJ_MAGIC*/;              \
+  uint32_t ob_index   /*dense index, see rps_object_index*/;    \
+  atomic_ulong ob_version /*even, bumped by 2 on changes*/;     \
+  unsigned long ob_changepoch;                                  \
+  struct rps_objhistory_st* ob_history;                         \
   pthread_mutex_t ob_mtx;                                       \
   RpsObject_t* ob_class;                                        \
   RpsObject_t* ob_space;                                        \
   RpsAttrTable_t* ob_attrtable /*unowned!*/;                    \
+  const RpsShape_t*_Atomic ob_shape /*shared, see shape_rps.c*/; \
+  RpsValue_t*_Atomic ob_shapvals /*values of shaped attributes*/; \
   RpsObject_t* ob_routsig      /* signature of routine */;      \
   void* ob_routaddr;           /* dlsymed address of routine */ \
   unsigned ob_nbcomp;                                           \
@@ -691,6 +716,18 @@ struct RpsZoneObject_st
   RPSFIELDS_OBJECT;
 };
 
+struct rps_objhistory_st;	/* private to snapshot_rps.c */
+
+/* To be called by every routine changing some locked object, before
+   changing its attributes or components.  It bumps its version, and
+   keeps its current state when some snapshot could see it. */
+extern void rps_locked_object_touch (RpsObject_t * ob);
+
+/* Likewise, to be called by every routine changing some payload,
+   before changing it; touches its owner, which should be locked, if
+   there is one. */
+extern void rps_locked_payload_touch (void *payl);
+
 struct internal_rootob_node_rps_st
 {
   RpsObject_t *rootobrps_obj;
@@ -703,12 +740,80 @@ extern bool rps_is_valid_object (RpsObject_t * obj);
 extern bool rps_object_less (RpsObject_t * ob1, RpsObject_t * ob2);
 extern int rps_object_cmp (const RpsObject_t * ob1, const RpsObject_t * ob2);
 extern void rps_object_array_qsort (const RpsObject_t ** arr, int size);
+/* Lock distinct objects by increasing oid, to avoid deadlocks.  The
+   OBARR is sorted in place, with duplicates and nulls moved to the end
+   and cleared; the number of locked objects is returned, and should be
+   given to rps_unlock_objects with the same array. */
+#define RPS_MAX_LOCKED_OBJECTS 64
+extern unsigned rps_lock_objects (unsigned nbob, RpsObject_t ** obarr);
+extern void rps_unlock_objects (unsigned nbob, RpsObject_t ** obarr);
 extern RpsObject_t *rps_create_object_of_class (const RpsObject_t * obclass);
 extern RpsObject_t *rps_find_object_by_oid (const RpsOid oid);
 extern RpsObject_t *rps_get_loaded_object_by_oid (RpsLoader_t * ld,
 						  const RpsOid oid);
+/* Bulk creation of objects, locking each affected bucket once.  The
+   objects of the NBOB oids in OIDARR are created, or found when they
+   already exist, and stored in OBARR.  New objects get class OBCLASS,
+   or `object` if it is NULL.  They return the number of created
+   objects.  Threads working in parallel should each own a disjoint
+   bucket range [BIXLO,BIXHI) of bucket numbers, see rps_oid_bucket_num. */
+extern unsigned rps_bulk_create_objects_by_oid (const RpsObject_t * obclass,
+						unsigned nbob,
+						const RpsOid * oidarr,
+						RpsObject_t ** obarr);
+extern unsigned rps_bulk_create_objects_in_bucket_range (const RpsObject_t *
+							 obclass,
+							 unsigned nbob,
+							 const RpsOid *
+							 oidarr,
+							 RpsObject_t **
+							 obarr,
+							 unsigned bixlo,
+							 unsigned bixhi);
+/* Create NBOB new objects of fresh random oids into OBARR */
+extern unsigned rps_bulk_create_fresh_objects (const RpsObject_t * obclass,
+					       unsigned nbob,
+					       RpsObject_t ** obarr);
+/* Dense object indexes, starting from 1; index 0 means no object */
+extern uint32_t rps_object_index (const RpsObject_t * ob);
+extern RpsObject_t *rps_object_of_index (uint32_t ix);
+/* one more than the largest object index ever given */
+extern uint32_t rps_object_index_bound (void);
+/* to be called when freeing an object, its index becomes reusable */
+extern void rps_object_release_index (RpsObject_t * ob);
+/* Apply ROUT to every object using NBTHREADS threads (or
+   rps_nb_threads if not positive), return the number of objects seen */
+extern unsigned long
+rps_parallel_for_each_object (rps_parallel_object_callback_sig_t * rout,
+			      void *data, int nbthreads);
+/* Apply ROUT to every index below NB using NBTHREADS threads (or
+   rps_nb_threads if not positive) */
+extern void rps_parallel_for_each_index (unsigned long nb, int nbthreads,
+					 rps_parallel_index_callback_sig_t *
+					 rout, void *data);
 extern RpsValue_t rps_get_object_attribute (RpsObject_t * ob,
 					    RpsObject_t * obattr);
+extern void rps_put_object_attribute (RpsObject_t * ob,
+				      RpsObject_t * obattr, RpsValue_t val);
+// set the class of a locked, or not yet visible, object
+extern void rps_locked_object_put_class (RpsObject_t * ob,
+					 RpsObject_t * obclass);
+/// for locked objects, also handling the class and space attributes
+extern RpsValue_t rps_locked_object_get_any_attribute (RpsObject_t * ob,
+						       RpsObject_t * obattr);
+extern void rps_locked_object_put_any_attribute (RpsObject_t * ob,
+						 RpsObject_t * obattr,
+						 RpsValue_t val);
+/* Batched attribute access, locking the object once.  The get fills
+   VALARR and returns the number of attributes found. */
+extern unsigned rps_object_get_attributes (RpsObject_t * ob,
+					   unsigned nbattrs,
+					   RpsObject_t * const *attrarr,
+					   RpsValue_t * valarr);
+extern unsigned rps_object_put_attributes (RpsObject_t * ob,
+					   unsigned nbattrs,
+					   RpsObject_t * const *attrarr,
+					   const RpsValue_t * valarr);
 extern RpsValue_t rps_get_object_component (RpsObject_t * ob, int ix);
 // In a given object, get its payload if it has type paylty; accepts
 // any payload if paylty is 0.  For example:
@@ -717,6 +822,32 @@ extern void *rps_get_object_payload_of_type (RpsObject_t * ob, int paylty);
 extern void rps_check_all_objects_buckets_are_valid (void);
 extern void rps_object_reserve_components (RpsObject_t * obj,
 					   unsigned nbcomp);
+/* The components of an object form a growable vector; each of these
+   functions locks the object once.  Negative positions count from the
+   end, like in rps_get_object_component. */
+extern void rps_object_append_component (RpsObject_t * obj, RpsValue_t val);
+// these append functions return the new number of components
+extern unsigned rps_object_append_components (RpsObject_t * obj,
+					      unsigned nbval,
+					      const RpsValue_t * valarr);
+extern unsigned rps_object_append_tuple_components (RpsObject_t * obj,
+						    const RpsTupleOb_t * tup);
+// components in [LO,HI) which are not objects become NULL in the tuple
+extern const RpsTupleOb_t *rps_object_components_slice_to_tuple (RpsObject_t
+								 * obj,
+								 int lo,
+								 int hi);
+// replace NBDEL components at POS by the NBINS ones of INSARR
+extern bool rps_object_splice_components (RpsObject_t * obj, int pos,
+					  unsigned nbdel, unsigned nbins,
+					  const RpsValue_t * insarr);
+extern void rps_object_truncate_components (RpsObject_t * obj,
+					    unsigned nbcomp);
+/// for objects locked by the caller; the put fails outside of the components
+extern void rps_locked_object_append_component (RpsObject_t * obj,
+						RpsValue_t val);
+extern bool rps_locked_object_put_component (RpsObject_t * obj, int ix,
+					     RpsValue_t val);
 extern void rps_add_global_root_object (RpsObject_t * obj);
 extern void rps_remove_global_root_object (RpsObject_t * obj);
 extern unsigned rps_nb_global_root_objects (void);
@@ -778,6 +909,14 @@ typedef void rps_payload_verifier_t (RpsObject_t * ob,
 extern void rps_register_payload_verifier (int paylty,
 					   rps_payload_verifier_t *,
 					   void *data);
+// the NAME is the "payload" string in JSON, e.g. "symbol"
+extern void rps_register_payload_loader (int paylty, const char *name,
+					 rpsldpysig_t * rout);
+// registered, or else dlsym-ed once, payload loader of some name
+extern rpsldpysig_t *rps_payload_loader_of_name (const char *name);
+/* Called once all payload types are registered, before any other
+   thread starts; the registry is then read without locking */
+extern void rps_freeze_payload_registry (void);
 
 
 extern void rps_dump_scan_object_payload (RpsDumper_t * du, RpsObject_t * ob);
@@ -792,7 +931,8 @@ extern bool rps_is_dumpable_object (RpsDumper_t * du, RpsObject_t * ob);
  * values.
  ****************************************************************/
 /////////////// table of attributes (objects) with their values
-/////////////// entries are either empty or sorted by ascending attributes
+/////////////// small tables have packed unsorted entries, larger ones
+/////////////// are hashed on the zv_hash of attributes, see object_rps.c
 struct rps_attrentry_st
 {
   RpsObject_t *ent_attr;
@@ -800,6 +940,8 @@ struct rps_attrentry_st
 };
 
 #define RPS_MAX_NB_ATTRS (1U<<28)
+/// tables of allocated size not above this are scanned linearly
+#define RPS_ATTR_TABLE_SMALL_SIZE 8
 //// the zm_xtra is a prime index for the allocated size
 //// the zm_length is the actual number of non-empty entries
 #define RPSFIELDS_ATTRTABLE			\
@@ -820,6 +962,9 @@ extern RpsAttrTable_t *rps_attr_table_put (RpsAttrTable_t * tbl,
 					   RpsValue_t val);
 extern RpsAttrTable_t *rps_attr_table_remove (RpsAttrTable_t * tbl,
 					      RpsObject_t * obattr);
+/// return TBL if it has room for NBEXTRA more attributes, or a bigger copy
+extern RpsAttrTable_t *rps_attr_table_reserve (RpsAttrTable_t * tbl,
+					       unsigned nbextra);
 extern unsigned rps_attr_table_size (const RpsAttrTable_t * tbl);
 extern unsigned rps_attr_table_iterate (const RpsAttrTable_t * tbl,
 					rps_object_callback_sig_t * routattr,
@@ -828,6 +973,153 @@ extern unsigned rps_attr_table_iterate (const RpsAttrTable_t * tbl,
 extern const RpsSetOb_t *rps_attr_table_set_of_attributes (const
 							   RpsAttrTable_t
 							   * tbl);
+
+/****************************************************************
+ * Shapes, also called hidden classes, of object attributes.  A shape
+ * is an immutable sequence of attributes, shared by every object
+ * having the same attributes added in the same order.  Shapes are
+ * malloc-ed, never freed, and related by cached transitions adding
+ * one attribute.
+ ****************************************************************/
+#define RPS_SHAPE_MAGIC 0x2f41c9d7	/*792840663 */
+/// objects with more attributes use an RpsAttrTable_t
+#define RPS_SHAPE_MAX_ATTRS 64
+struct rps_shape_transitions_st;	/* private to shape_rps.c */
+struct RpsShape_st
+{
+  unsigned shap_magic;		/* always RPS_SHAPE_MAGIC */
+  unsigned shap_nbattrs;	/* number of attributes */
+  const RpsShape_t *shap_parent;	/* shape without the last attribute */
+  struct rps_shape_transitions_st *_Atomic shap_transitions;
+  unsigned shap_indexsize;	/* prime size of shap_index, or 0 if small */
+  unsigned short *shap_index;	/* hashed slot+1, or 0 if empty */
+  RpsObject_t *shap_attrs[];	/* attributes by slot */
+};
+/// an attribute cache for some call site, should be static and zeroed
+struct rps_attrcache_st
+{
+  const RpsShape_t *_Atomic ac_shape;
+  atomic_uint ac_slot;
+};
+typedef struct rps_attrcache_st RpsAttrCache_t;
+extern bool rps_is_valid_shape (const RpsShape_t * sh);
+// the shape of objects without attributes
+extern const RpsShape_t *rps_shape_root (void);
+// the slot index of an attribute in a shape, or -1 if absent
+extern int rps_shape_slot_of_attribute (const RpsShape_t * sh,
+					const RpsObject_t * obattr);
+// the shape with one more attribute, not in SH, or NULL if too big
+extern const RpsShape_t *rps_shape_add_attribute (const RpsShape_t * sh,
+						  RpsObject_t * obattr);
+// the allocated size of the ob_shapvals array for NBATTRS attributes
+static inline unsigned
+rps_shape_values_capacity (unsigned nbattrs)
+{
+  return (nbattrs + 3) & ~3U;
+}
+/// These functions are for objects locked by their caller
+extern RpsValue_t rps_locked_object_get_attribute (RpsObject_t * ob,
+						   const RpsObject_t *
+						   obattr);
+extern void rps_locked_object_put_attribute (RpsObject_t * ob,
+					     RpsObject_t * obattr,
+					     RpsValue_t val);
+/* Put NBATTRS attributes at once, sorting them once and allocating at
+   most once; the last value wins for repeated attributes.  Returns the
+   number of distinct attributes put. */
+extern unsigned rps_locked_object_put_attributes (RpsObject_t * ob,
+						  unsigned nbattrs,
+						  RpsObject_t * const *attrarr,
+						  const RpsValue_t * valarr);
+extern unsigned rps_locked_object_nb_attributes (RpsObject_t * ob);
+extern unsigned rps_locked_object_iterate_attributes (RpsObject_t * ob,
+						      rps_object_callback_sig_t
+						      * routattr,
+						      rps_value_callback_sig_t
+						      * routval, void *data);
+extern const RpsSetOb_t *rps_locked_object_set_of_attributes (RpsObject_t *
+							      ob);
+/* Get an attribute using the CACHE of the calling site; this is a
+   shape compare and an indexed load when the cache hits, e.g.
+     static RpsAttrCache_t namecache;
+     RpsValue_t v = rps_get_object_attribute_cached (ob, obname, &namecache);
+*/
+extern RpsValue_t rps_get_object_attribute_cached (RpsObject_t * ob,
+						   RpsObject_t * obattr,
+						   RpsAttrCache_t * cache);
+
+/****************************************************************
+ * Optimistic transactions on objects, in transaction_rps.c.  Reads
+ * remember the ob_version of each object, writes to attributes and
+ * components are buffered, and the commit locks only the written
+ * objects in oid order, validates the versions of every accessed
+ * object, then applies the writes.  A transaction is used by a
+ * single thread.
+ ****************************************************************/
+typedef struct RpsTransaction_st RpsTransaction_t;	/* private */
+extern RpsTransaction_t *rps_transaction_begin (void);
+// forget the buffered writes and accesses, to retry the transaction
+extern void rps_transaction_reset (RpsTransaction_t * tr);
+extern void rps_transaction_destroy (RpsTransaction_t * tr);
+// true if the transaction already saw a conflict and cannot commit
+extern bool rps_transaction_doomed (const RpsTransaction_t * tr);
+/// reads see the writes buffered by the same transaction
+extern RpsValue_t rps_transaction_get_attribute (RpsTransaction_t * tr,
+						 RpsObject_t * ob,
+						 RpsObject_t * obattr);
+extern void rps_transaction_put_attribute (RpsTransaction_t * tr,
+					   RpsObject_t * ob,
+					   RpsObject_t * obattr,
+					   RpsValue_t val);
+extern unsigned rps_transaction_nb_components (RpsTransaction_t * tr,
+					       RpsObject_t * ob);
+extern RpsValue_t rps_transaction_get_component (RpsTransaction_t * tr,
+						 RpsObject_t * ob, int ix);
+// fails outside of the components
+extern bool rps_transaction_put_component (RpsTransaction_t * tr,
+					   RpsObject_t * ob, int ix,
+					   RpsValue_t val);
+extern void rps_transaction_append_component (RpsTransaction_t * tr,
+					      RpsObject_t * ob,
+					      RpsValue_t val);
+// returns false on conflict, then nothing has been written
+extern bool rps_transaction_commit (RpsTransaction_t * tr);
+/* Run a transaction routine, which returns false to abort, then
+   commit it, retrying on conflicts at most MAXRETRIES times.  Returns
+   true once committed. */
+typedef bool rps_transaction_sig_t (RpsTransaction_t * tr, void *data);
+extern bool rps_run_transaction (rps_transaction_sig_t * rout, void *data,
+				 unsigned maxretries);
+
+/****************************************************************
+ * Snapshots, in snapshot_rps.c, are consistent read views of the
+ * attributes and components of every object, as they were when the
+ * snapshot was opened.  Changed objects keep their older states as
+ * long as some open snapshot needs them.  Long analyses, e.g. dumps or
+ * heap verifications, can use them while other threads mutate objects.
+ ****************************************************************/
+typedef struct RpsSnapshot_st RpsSnapshot_t;	/* private */
+extern RpsSnapshot_t *rps_snapshot_open (void);
+extern void rps_snapshot_close (RpsSnapshot_t * snap);
+extern unsigned long rps_snapshot_epoch (const RpsSnapshot_t * snap);
+extern unsigned rps_nb_open_snapshots (void);
+/* Changes of several locked objects which should be seen together,
+   e.g. by a transaction commit, are bracketed by these. */
+extern void rps_snapshot_begin_atomic_change (void);
+extern void rps_snapshot_end_atomic_change (void);
+/// these lock the object briefly
+extern RpsObject_t *rps_snapshot_object_class (const RpsSnapshot_t * snap,
+					       RpsObject_t * ob);
+extern RpsValue_t rps_snapshot_get_attribute (const RpsSnapshot_t * snap,
+					      RpsObject_t * ob,
+					      RpsObject_t * obattr);
+extern const RpsSetOb_t *rps_snapshot_set_of_attributes (const RpsSnapshot_t
+							 * snap,
+							 RpsObject_t * ob);
+extern unsigned rps_snapshot_nb_components (const RpsSnapshot_t * snap,
+					    RpsObject_t * ob);
+extern RpsValue_t rps_snapshot_get_component (const RpsSnapshot_t * snap,
+					      RpsObject_t * ob, int ix);
 /****************************************************************
  * Owned symbol payload
  ****************************************************************/
@@ -867,10 +1159,34 @@ extern rps_payload_dump_serializer_t rps_symbol_payload_dump_serializer;
   uint64_t pclass_magic /*always RPS_CLASSINFO_MAGIC*/;         \
   RpsObject_t* pclass_super /*:superclass*/;			\
   RpsAttrTable_t *pclass_methdict/*:method dictionary*/;	\
-  RpsObject_t* pclass_symbol	/*:optional symbol */
+  RpsObject_t* pclass_symbol	/*:optional symbol */;		\
+  struct rps_flatmethods_st*_Atomic pclass_flatmeth /*lazy, malloc-ed*/; \
+  struct rps_classdisplay_st* pclass_display /*lazy, malloc-ed*/
 
 #define RPS_CLASSINFO_MAGIC 0x3d3c6b284031d237UL
 
+/// the flattened methods of a class, including inherited ones, indexed
+/// by selector numbers; valid only at the method cache epoch fm_epoch
+struct rps_flatmethods_st
+{
+  unsigned long fm_epoch;
+  unsigned fm_size;		/* bound on selector numbers */
+  unsigned fm_count;		/* number of non-null methods */
+  RpsClosure_t *fm_arr[];
+};
+
+/// the maximal depth of a class, bounding its superclass chain
+#define RPS_CLASSDISPLAY_MAX_DEPTH 100
+/// the ancestors of a class, cd_arr[0] being the root class and
+/// cd_arr[cd_depth] the class itself; valid only at the class
+/// hierarchy epoch cd_epoch
+struct rps_classdisplay_st
+{
+  unsigned long cd_epoch;
+  unsigned cd_depth;
+  RpsObject_t *cd_arr[];
+};
+
 struct RpsPayl_ClassInfo_st
 {
   RPSFIELDS_PAYLOAD_CLASSINFO;
@@ -884,17 +1200,275 @@ extern RpsAttrTable_t *rps_classinfo_methdict (const RpsClassInfo_t * clinf);
 extern RpsClosure_t *rps_classinfo_get_method (const RpsClassInfo_t *
 					       clinf, RpsObject_t * selob);
 
+// for an object locked by the caller
+extern RpsClassInfo_t *rps_locked_object_classinfo (RpsObject_t * obcla);
 extern RpsObject_t *rps_obclass_super (RpsObject_t * obcla);
 extern RpsObject_t *rps_obclass_symbol (RpsObject_t * obcla);
 extern RpsAttrTable_t *rps_obclass_methdict (RpsObject_t * obcla);
 extern RpsClosure_t *rps_obclass_get_method (RpsObject_t * obcla,
 					     RpsObject_t * selob);
 
+/* These change a class and invalidate the method cache; they return
+   false if OBCLA is not a class, and rps_obclass_put_super also if
+   OBSUPER is OBCLA or inherits from it, or is too deep */
+extern bool rps_obclass_put_method (RpsObject_t * obcla, RpsObject_t * selob,
+				    RpsClosure_t * clos);
+extern bool rps_obclass_remove_method (RpsObject_t * obcla,
+				       RpsObject_t * selob);
+extern bool rps_obclass_put_super (RpsObject_t * obcla,
+				   RpsObject_t * obsuper);
+
+/* Selectors get small dense numbers, starting from 1, in
+   selector_rps.c; 0 is for no selector.  Classes have flattened
+   method tables indexed by them, lazily rebuilt when any class
+   changed. */
+extern unsigned rps_selector_number (const RpsObject_t * selob);
+extern unsigned rps_selector_number_bound (void);
+extern RpsObject_t *rps_selector_of_number (unsigned selnum);
+extern RpsClosure_t *rps_obclass_flat_method (RpsObject_t * obcla,
+					      unsigned selnum);
+extern bool rps_obclass_responds_to (RpsObject_t * obcla,
+				     const RpsObject_t * selob);
+// the set of all selectors, own or inherited, of a class
+extern const RpsSetOb_t *rps_obclass_set_of_selectors (RpsObject_t * obcla);
+// called by the classinfo remover, with its owner locked
+extern void rps_classinfo_free_flat_methods (RpsClassInfo_t * clinf);
+
+/* Classes have lazily computed ancestor displays, in
+   classdisplay_rps.c, so subclass tests are constant time.  They
+   become stale when rps_class_hierarchy_changed is called, whenever
+   some superclass is set. */
+extern unsigned long rps_class_hierarchy_epoch (void);
+extern void rps_class_hierarchy_changed (void);
+// the depth of a class, 0 for a root class, or -1 if not a class
+extern int rps_obclass_depth (RpsObject_t * obcla);
+// true if OBSUB is OBSUPER or inherits from it
+extern bool rps_is_subclass (RpsObject_t * obsub, RpsObject_t * obsuper);
+// the class of any value, e.g. int∈class for tagged integers
+extern RpsObject_t *rps_class_of_value (RpsValue_t val);
+extern bool rps_is_instance_of (RpsValue_t val, RpsObject_t * obcla);
+// called by the classinfo remover, with its owner locked
+extern void rps_classinfo_free_display (RpsClassInfo_t * clinf);
+
+/* Class extents, in extent_rps.c, are the sets of direct instances
+   of classes, built by one scan of all objects when first needed and
+   then maintained, so finding instances is proportional to their
+   number. */
+extern void rps_enable_class_extents (void);
+extern bool rps_class_extents_enabled (void);
+// called with OB locked, when its class changes from OLDCLA to NEWCLA
+extern void rps_class_extent_change (RpsObject_t * ob, RpsObject_t * oldcla,
+				     RpsObject_t * newcla);
+/// with WITHSUB, the instances of subclasses are included
+extern unsigned long rps_obclass_count_instances (RpsObject_t * obcla,
+						  bool withsub);
+extern unsigned long rps_obclass_iterate_instances (RpsObject_t * obcla,
+						    bool withsub,
+						    rps_object_callback_sig_t
+						    * rout, void *data);
+extern const RpsSetOb_t *rps_obclass_set_of_instances (RpsObject_t * obcla,
+						       bool withsub);
+
+/* Declared attribute indexes, in attrindex_rps.c, map the values of
+   some attribute to the direct instances of some class having it.
+   They are derived data, not dumped, so are declared again, e.g.
+   after loading, and then maintained on every change. */
+// a total order on values, numbers compared by value, strings by content
+extern int rps_value_cmp (RpsValue_t val1, RpsValue_t val2);
+// returns false if OBCLA is not a class
+extern bool rps_declare_attribute_index (RpsObject_t * obcla,
+					 RpsObject_t * obattr);
+extern bool rps_has_attribute_index (RpsObject_t * obcla,
+				     RpsObject_t * obattr);
+// these give NULL without such an index
+extern const RpsSetOb_t *rps_attribute_index_find (RpsObject_t * obcla,
+						   RpsObject_t * obattr,
+						   RpsValue_t val);
+// between LOVAL and HIVAL included, a null bound being unlimited
+extern const RpsSetOb_t *rps_attribute_index_range (RpsObject_t * obcla,
+						    RpsObject_t * obattr,
+						    RpsValue_t loval,
+						    RpsValue_t hival);
+/// called with OB locked, by attribute and class changes
+extern bool rps_attr_indexes_exist (void);
+extern void rps_attr_index_update (RpsObject_t * ob, RpsObject_t * obattr,
+				   RpsValue_t oldval, RpsValue_t newval);
+extern void rps_attr_index_class_change (RpsObject_t * ob,
+					 RpsObject_t * oldcla,
+					 RpsObject_t * newcla);
+
+/* The optional trigram index of trigram_rps.c finds objects having
+   some string attribute value, component or payload string, e.g. a
+   symbol name or string dictionary key, containing a given
+   substring.  It is built in parallel, e.g. after loading, then
+   maintained as strings are put into objects. */
+extern void rps_build_trigram_index (int nbthreads);
+extern bool rps_trigram_index_built (void);
+// called with OB locked, for any value put into it
+extern void rps_trigram_note_value (RpsObject_t * ob, RpsValue_t val);
+// called with OB locked, when it gets a new payload
+extern void rps_trigram_note_payload (RpsObject_t * ob);
+// NULL if the index is not built
+extern const RpsSetOb_t *rps_trigram_search (const char *substr);
+
+/* The modification time index of mtime_rps.c records every change of
+   ob_mtime, which rps_locked_object_touch bumps, for queries about
+   recently changed objects.  Payload changes are seen only because
+   payload mutators call rps_locked_payload_touch. */
+extern void rps_mtime_index_note (RpsObject_t * ob, double mtime);
+// nestable; the notes of the calling thread are ignored in between
+extern void rps_mtime_index_suspend (void);
+extern void rps_mtime_index_resume (void);
+// UNTIL is unlimited if not above SINCE
+extern const RpsSetOb_t *rps_objects_changed_between (double since,
+						      double until);
+// by increasing mtime, until ROUT returns false; gives the count
+extern unsigned long rps_iterate_objects_changed_since (double since,
+							 rps_object_callback_sig_t
+							 * rout, void *data);
+// the merge sequence, which only grows, of the last merged change
+extern unsigned long rps_mtime_index_sequence (void);
+// whatever their mtime, for changes merged after SEQ
+extern const RpsSetOb_t *rps_objects_changed_after_sequence (unsigned long
+							     seq,
+							     unsigned long
+							     *pnextseq);
+
+/* The query engine of query_rps.c runs, in parallel, a pipeline of
+   stages on a source of objects: all objects, the instances of a class
+   or the elements of a set.  Stages are added in order, then the query
+   is run, possibly several times, and explicitly freed. */
+typedef struct rps_query_st RpsQuery_t;
+extern RpsQuery_t *rps_query_of_all_objects (void);
+extern RpsQuery_t *rps_query_of_class (RpsObject_t * obcla, bool withsub);
+extern RpsQuery_t *rps_query_of_set (const RpsSetOb_t * set);
+// keep the objects to which CLOS applies a non-nil result
+extern void rps_query_filter (RpsQuery_t * q, const RpsClosure_t * clos);
+// keep the objects for which ROUT returns true, it should not block
+extern void rps_query_filter_c (RpsQuery_t * q,
+				rps_object_callback_sig_t * rout,
+				void *data);
+/// replace each object by the object, or elements of the set or tuple,
+/// of its attribute OBATTR or its component of given RANK (negative
+/// ranks counting from the end)
+extern void rps_query_follow_attribute (RpsQuery_t * q, RpsObject_t * obattr);
+extern void rps_query_follow_component (RpsQuery_t * q, int rank);
+/// join on oid: keep the objects, or their OBATTR value when OBATTR is
+/// not null, which are in the result of OTHER, which is run at once
+extern void rps_query_join (RpsQuery_t * q, RpsQuery_t * other,
+			    RpsObject_t * obattr, int nbthreads);
+extern void rps_query_free (RpsQuery_t * q);
+// NBTHREADS is rps_nb_threads when not positive
+extern const RpsSetOb_t *rps_query_run_set (RpsQuery_t * q, int nbthreads);
+// the tuple is ordered by oid
+extern const RpsTupleOb_t *rps_query_run_tuple (RpsQuery_t * q,
+						int nbthreads);
+extern unsigned long rps_query_count (RpsQuery_t * q, int nbthreads);
+struct rps_query_group_st
+{
+  RpsValue_t qg_key;
+  unsigned long qg_count;
+  const RpsSetOb_t *qg_set;
+};
+// gives a malloc-ed array of groups ordered by their key
+extern struct rps_query_group_st *rps_query_group_by (RpsQuery_t * q,
+						      RpsObject_t * obattr,
+						      int nbthreads,
+						      unsigned *pnbgroups);
+
+/* The reverse reference index of refgraph_rps.c tells which objects
+   refer to some object, thru class, space, attributes, components or
+   payload.  It is a snapshot made by a parallel walk of the heap from
+   the global roots, which also gives shortest reference paths. */
+extern void rps_object_scan_references (RpsObject_t * ob,
+					rps_object_callback_sig_t * rout,
+					void *data);
+// likewise for strings in attributes, components and payload
+extern void rps_object_scan_strings (RpsObject_t * ob,
+				     rps_value_callback_sig_t * rout,
+				     void *data);
+extern void rps_locked_object_scan_payload_strings (RpsObject_t * ob,
+						    rps_value_callback_sig_t
+						    * rout, void *data);
+// gives the number of reached objects
+extern unsigned long rps_build_reverse_references (int nbthreads);
+extern bool rps_reverse_references_built (void);
+extern void rps_forget_reverse_references (void);
+// NULL if the index is not built
+extern const RpsSetOb_t *rps_objects_referring_to (RpsObject_t * ob);
+// a tuple from some root to OB, NULL if OB is unreachable
+extern const RpsTupleOb_t *rps_reference_path_from_roots (RpsObject_t * ob);
+
+/* Structural hashing, in merkle_rps.c, gives a hash of the content of
+   each object and a Merkle hash of each space, both updated only for
+   changed objects.  Comparing them is cheaper than comparing dumps. */
+// the canonical JSON content of a locked object, for hashing
+extern json_t *rps_locked_object_content_json (RpsObject_t * ob);
+extern uint64_t rps_object_content_hash (RpsObject_t * ob);
+// WITHMTIME also hashes the dumped modification times
+extern uint64_t rps_set_merkle_hash (const RpsSetOb_t * set, bool withmtime);
+extern void rps_refresh_merkle_hashes (int nbthreads);
+extern uint64_t rps_space_merkle_hash (RpsObject_t * obspace,
+				       unsigned long *pnbobjects);
+
+/* The generic traversal of traverse_rps.c walks the objects reachable
+   from a set of starting objects, for whole heap tools. */
+enum rps_traversal_mode_en
+{
+  RPS_TRAVERSE_BFS,		/* serial, breadth first */
+  RPS_TRAVERSE_DFS,		/* serial, depth first */
+  RPS_TRAVERSE_PARALLEL,	/* level by level, in several threads */
+};
+enum rps_visited_kind_en
+{
+  RPS_VISITED_BITSET,		/* a bit set by object index */
+  RPS_VISITED_HASHTBL,		/* a hash table of objects, for small walks */
+  RPS_VISITED_MARKS,		/* atomic marks, forced in parallel mode */
+};
+enum rps_visit_en
+{
+  RPS_VISIT_CONTINUE,		/* also scan the references of the object */
+  RPS_VISIT_PRUNE,		/* do not scan them */
+  RPS_VISIT_STOP,		/* stop the whole traversal */
+};
+/// OBFROM is null for the starting objects, of depth 0
+typedef enum rps_visit_en rps_traversal_visitor_sig_t (RpsObject_t * ob,
+						       RpsObject_t * obfrom,
+						       unsigned depth,
+						       int workix,
+						       void *data);
+/// called with OBFROM locked, for every reference
+typedef void rps_traversal_edge_sig_t (RpsObject_t * obfrom,
+				       RpsObject_t * obto, int workix,
+				       void *data);
+extern unsigned long rps_traverse_objects (const RpsSetOb_t * startset,
+					   enum rps_traversal_mode_en mode,
+					   enum rps_visited_kind_en visited,
+					   rps_traversal_visitor_sig_t *
+					   visitor,
+					   rps_traversal_edge_sig_t *
+					   edgerout, void *data,
+					   int nbthreads);
+
 //// given some non-nil value, return the closure to send a method of given selector
 extern RpsClosure_t *rps_value_compute_method_closure (RpsValue_t val,
 						       const RpsObject_t
 						       * selob);
 
+/* The global method cache of methcache_rps.c, from a class and
+   selector to a closure, NULL for a missing method, read without
+   locking.  It should be invalidated when any class changes. */
+extern unsigned long rps_method_cache_epoch (void);
+extern void rps_method_cache_invalidate (void);
+// return true if found in the cache, then filling *PCLOS
+extern bool rps_method_cache_lookup (const RpsObject_t * clasob,
+				     const RpsObject_t * selob,
+				     RpsClosure_t ** pclos);
+// EPOCH should be the rps_method_cache_epoch before the lookup
+extern void rps_method_cache_store (const RpsObject_t * clasob,
+				    const RpsObject_t * selob,
+				    RpsClosure_t * clos, unsigned long epoch);
+
 extern rps_payload_remover_t rps_classinfo_payload_remover;
 extern rps_payload_dump_scanner_t rps_classinfo_payload_dump_scanner;
 extern rps_payload_dump_serializer_t rps_classinfo_payload_dump_serializer;
@@ -1034,6 +1608,51 @@ extern unsigned rps_hash_tbl_iterate (RpsHashTblOb_t * htb,
 // make a set from the elements of an hash table
 extern const RpsSetOb_t *rps_hash_tbl_set_elements (RpsHashTblOb_t * htb);
 
+/****************************************************************
+ * Bit sets, notably of objects by their dense index; these are
+ * malloc-ed, not garbage collected, so should be destroyed.
+ ****************************************************************/
+#define RPS_BITSET_MAGIC 0x1d6b30e5	/*493564133 */
+struct RpsBitSet_st
+{
+  unsigned bs_magic;		/* always RPS_BITSET_MAGIC */
+  unsigned bs_nbwords;		/* allocated number of words */
+  uint64_t *bs_words;
+};
+typedef struct RpsBitSet_st RpsBitSet_t;
+/// callback function on bit indexes, returning false to stop
+typedef bool rps_bitindex_callback_sig_t (uint32_t ix, void *data);
+extern bool rps_bitset_is_valid (const RpsBitSet_t * bs);
+// create a bit set for NBBITS bits, or for all objects if 0; it grows
+extern RpsBitSet_t *rps_bitset_create (uint32_t nbbits);
+extern void rps_bitset_destroy (RpsBitSet_t * bs);
+extern bool rps_bitset_test (const RpsBitSet_t * bs, uint32_t ix);
+// set a bit, return true if it was not already set
+extern bool rps_bitset_put (RpsBitSet_t * bs, uint32_t ix);
+// clear a bit, return true if it was set
+extern bool rps_bitset_remove (RpsBitSet_t * bs, uint32_t ix);
+extern void rps_bitset_clear_all (RpsBitSet_t * bs);
+extern unsigned long rps_bitset_popcount (const RpsBitSet_t * bs);
+extern void rps_bitset_union_with (RpsBitSet_t * dst,
+				   const RpsBitSet_t * src);
+extern void rps_bitset_intersect_with (RpsBitSet_t * dst,
+				       const RpsBitSet_t * src);
+extern void rps_bitset_difference_with (RpsBitSet_t * dst,
+					const RpsBitSet_t * src);
+// iterate in increasing order on the set bits, till ROUT returns false
+extern unsigned long rps_bitset_iterate (const RpsBitSet_t * bs,
+					 rps_bitindex_callback_sig_t * rout,
+					 void *data);
+extern bool rps_bitset_put_object (RpsBitSet_t * bs, const RpsObject_t * ob);
+extern bool rps_bitset_remove_object (RpsBitSet_t * bs,
+				      const RpsObject_t * ob);
+extern bool rps_bitset_contains_object (const RpsBitSet_t * bs,
+					const RpsObject_t * ob);
+extern unsigned long rps_bitset_iterate_objects (const RpsBitSet_t * bs,
+						 rps_object_callback_sig_t *
+						 rout, void *data);
+extern const RpsSetOb_t *rps_bitset_set_of_objects (const RpsBitSet_t * bs);
+
 /****************************************************************
  * String dictionary payload for -RpsPyt_StringDict
  ****************************************************************/
@@ -1169,6 +1788,25 @@ extern rps_payload_dump_scanner_t rps_agenda_payload_dump_scanner;
 extern rps_payload_dump_serializer_t rps_agenda_payload_dump_serializer;
 
 
+/****************************************************************
+ * Quiescent state based reclamation of memory read without locks,
+ * see file epoch_rps.c
+ ****************************************************************/
+typedef void rps_epoch_free_sig_t (void *ptr);
+extern int rps_epoch_register_thread (void);
+extern bool rps_epoch_is_registered (void);
+extern void rps_epoch_unregister_thread (void);
+// the current thread holds no pointer to lock-free shared data
+extern void rps_epoch_quiescent (void);
+// around some long blocking wait
+extern void rps_epoch_go_offline (void);
+extern void rps_epoch_go_online (void);
+// free PTR with FREEROUT (or free if NULL) once no thread can use it
+extern void rps_epoch_retire (void *ptr, rps_epoch_free_sig_t * freerout);
+extern void rps_epoch_reclaim (void);
+// replace and retire tables under concurrent readers; fatal on failure
+extern void rps_epoch_stress_test (int nbreaders, unsigned long nbrounds);
+
 ////////////////////////////////////////////////////////////////
 extern volatile double rps_real_time (void);
 extern volatile double rps_process_cpu_time (void);
@@ -72,6 +72,10 @@ extern bool rps_oid_is_valid (const RpsOid oid);
 extern int rps_oid_cmp (const RpsOid oid1, const RpsOid oid2);
 extern void rps_oid_to_cbuf (const RpsOid oid, char cbuf[RPS_OID_BUFLEN]);
 extern RpsOid rps_cstr_to_oid (const char *cstr, const char **pend);
+extern void rps_oids_to_cbufs (const RpsOid * oidarr,
+			       char (*cbufarr)[RPS_OID_BUFLEN], unsigned nb);
+extern unsigned rps_cstrs_to_oids (const char *const *cstrarr,
+				   RpsOid * oidarr, unsigned nb);
 extern unsigned rps_oid_bucket_num (const RpsOid oid);
 extern RpsHash_t rps_oid_hash (const RpsOid oid);
 
@@ -127,5 +131,8 @@ rps_oid_greater_than_equal (RpsOid lhs, RpsOid rhs)
 // compute a random and valid oid
 extern RpsOid rps_oid_random (void);
 
+// fast per-thread pseudo-random 64 bits number, not cryptographic
+extern uint64_t rps_random_uint64 (void);
+
 #endif /* __REFPERSYS_INCLUDE_OID_RPS_H_INCLUDED__ */
 
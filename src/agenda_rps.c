@@ -171,9 +171,13 @@ rps_thread_routine (void *ptr)
    * + execute that tasklet, hopefully in a dozen of milliseconds
    *****/
   RpsObject_t *obtasklet = NULL;
+  rps_epoch_register_thread ();
   while (atomic_load (&rps_agenda_running))
     {
       obtasklet = NULL;
+      /// between two tasklets, this thread holds no pointer to any
+      /// lock-free data, see epoch_rps.c
+      rps_epoch_quiescent ();
       uint64_t count = atomic_fetch_add (&d->agth_loop_counter, 1) + 1;
       /// We sometimes sleep to give other threads the opportunity to
       /// run.  When debugged and code reviewed, the constants below
@@ -199,8 +203,10 @@ rps_thread_routine (void *ptr)
 	  struct timespec ts = { 0, 0 };
 	  clock_gettime (CLOCK_REALTIME, &ts);
 	  ts.tv_sec += 1;
+	  rps_epoch_go_offline ();
 	  pthread_cond_timedwait (&rps_agenda_changed_cond,
 				  &RPS_THE_AGENDA_OBJECT->ob_mtx, &ts);
+	  rps_epoch_go_online ();
 	}
       pthread_mutex_unlock (&RPS_THE_AGENDA_OBJECT->ob_mtx);
       if (obtasklet != NULL)
@@ -226,6 +232,8 @@ rps_thread_routine (void *ptr)
       usleep (10000);
       RPS_FATAL ("incomplete rps_thread_routine %d", d->agth_index);
     };				/* end while rps_agenda_running */
+  rps_epoch_unregister_thread ();
+  return NULL;
 }				/* end rps_thread_routine */
 
 void
@@ -0,0 +1,357 @@
+/****************************************************************
+ * file attrindex_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the declared secondary indexes, from the value of
+ *      some attribute to the instances of some class having it.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "Refpersys.h"
+
+/* An attribute index of a class and an attribute is an AVL tree,
+   using "kavl.h", of value and object pairs, ordered by rps_value_cmp
+   then by oid.  It holds the direct instances of the class having
+   that attribute, and serves exact and range lookups.  It is kept up
+   to date by rps_attr_index_update and rps_attr_index_class_change,
+   called with the changed object locked; each index has its own
+   mutex, taken after object locks.  Indexes are not dumped: they are
+   derived data, built by a scan of the class extent when declared,
+   e.g. after loading.  They are never removed, and are linked in a
+   list read without locking. */
+
+struct rps_attrindex_node_st
+{
+  RpsValue_t ainod_val;
+  RpsObject_t *ainod_ob;
+    KAVL_HEAD (struct rps_attrindex_node_st) ainod_head;
+};
+
+struct rps_attrindex_st
+{
+  RpsObject_t *ai_class;
+  RpsObject_t *ai_attr;
+  struct rps_attrindex_st *ai_next;	/* immutable once published */
+  pthread_mutex_t ai_mtx;
+  unsigned long ai_count;
+  struct rps_attrindex_node_st *ai_root;
+};
+
+static struct rps_attrindex_st *_Atomic rps_attrindex_first;
+static pthread_mutex_t rps_attrindex_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* A total order on values: first the null value, then numbers
+   compared numerically, strings by their UTF8 bytes, objects by oid,
+   then other values by type and address. */
+static int
+rps_value_rank (RpsValue_t val)
+{
+  enum RpsType ty = rps_value_type (val);
+  switch (ty)
+    {
+    case RPS_TYPE__NONE:
+      return 0;
+    case RPS_TYPE_INT:
+    case RPS_TYPE_DOUBLE:
+      return 1;
+    case RPS_TYPE_STRING:
+      return 2;
+    case RPS_TYPE_OBJECT:
+      return 3;
+    default:
+      return 10 + (int) ty;
+    }
+}				/* end rps_value_rank */
+
+int
+rps_value_cmp (RpsValue_t val1, RpsValue_t val2)
+{
+  if (val1 == val2)
+    return 0;
+  int rk1 = rps_value_rank (val1);
+  int rk2 = rps_value_rank (val2);
+  if (rk1 != rk2)
+    return (rk1 < rk2) ? -1 : 1;
+  switch (rk1)
+    {
+    case 0:
+      return 0;
+    case 1:
+      {
+	bool isint1 = rps_is_tagged_integer (val1);
+	bool isint2 = rps_is_tagged_integer (val2);
+	if (isint1 && isint2)
+	  {
+	    intptr_t i1 = rps_value_to_integer (val1);
+	    intptr_t i2 = rps_value_to_integer (val2);
+	    return (i1 < i2) ? -1 : (i1 > i2) ? 1 : 0;
+	  };
+	double d1 = isint1 ? (double) rps_value_to_integer (val1)
+	  : rps_double_value (val1);
+	double d2 = isint2 ? (double) rps_value_to_integer (val2)
+	  : rps_double_value (val2);
+	if (d1 < d2)
+	  return -1;
+	if (d1 > d2)
+	  return 1;
+	/// equal numbers, integers first
+	if (isint1 != isint2)
+	  return isint1 ? -1 : 1;
+	return 0;
+      }
+    case 2:
+      {
+	int cmp = strcmp (rps_stringv_utf8bytes (val1),
+			  rps_stringv_utf8bytes (val2));
+	return (cmp < 0) ? -1 : (cmp > 0) ? 1 : 0;
+      }
+    case 3:
+      return rps_object_cmp ((const RpsObject_t *) val1,
+			     (const RpsObject_t *) val2);
+    default:
+      return ((uintptr_t) val1 < (uintptr_t) val2) ? -1 : 1;
+    }
+}				/* end rps_value_cmp */
+
+static int
+rps_attrindex_node_cmp (const struct rps_attrindex_node_st *left,
+			const struct rps_attrindex_node_st *right)
+{
+  int cmp = rps_value_cmp (left->ainod_val, right->ainod_val);
+  if (cmp)
+    return cmp;
+  /// a null object is below every object, for range lookups
+  if (left->ainod_ob == right->ainod_ob)
+    return 0;
+  if (!left->ainod_ob)
+    return -1;
+  if (!right->ainod_ob)
+    return 1;
+  return rps_object_cmp (left->ainod_ob, right->ainod_ob);
+}				/* end rps_attrindex_node_cmp */
+
+KAVL_INIT (rpsattrindex, struct rps_attrindex_node_st, ainod_head,
+	   rps_attrindex_node_cmp);
+
+bool
+rps_attr_indexes_exist (void)
+{
+  return atomic_load (&rps_attrindex_first) != NULL;
+}				/* end rps_attr_indexes_exist */
+
+static struct rps_attrindex_st *
+rps_attrindex_find (const RpsObject_t * obcla, const RpsObject_t * obattr)
+{
+  for (struct rps_attrindex_st * ai = atomic_load (&rps_attrindex_first);
+       ai; ai = ai->ai_next)
+    if (ai->ai_class == obcla && ai->ai_attr == obattr)
+      return ai;
+  return NULL;
+}				/* end rps_attrindex_find */
+
+/// called with the index locked
+static void
+rps_attrindex_add (struct rps_attrindex_st *ai, RpsValue_t val,
+		   RpsObject_t * ob)
+{
+  struct rps_attrindex_node_st *newnod =
+    RPS_ALLOC_ZEROED (sizeof (struct rps_attrindex_node_st));
+  newnod->ainod_val = val;
+  newnod->ainod_ob = ob;
+  if (kavl_insert_rpsattrindex (&ai->ai_root, newnod, NULL) == newnod)
+    ai->ai_count++;
+  else
+    free (newnod);
+}				/* end rps_attrindex_add */
+
+/// called with the index locked
+static void
+rps_attrindex_remove (struct rps_attrindex_st *ai, RpsValue_t val,
+		      RpsObject_t * ob)
+{
+  struct rps_attrindex_node_st keynod = {.ainod_val = val,.ainod_ob = ob };
+  struct rps_attrindex_node_st *removednod =
+    kavl_erase_rpsattrindex (&ai->ai_root, &keynod, NULL);
+  if (removednod)
+    {
+      free (removednod);
+      ai->ai_count--;
+    }
+}				/* end rps_attrindex_remove */
+
+void
+rps_attr_index_update (RpsObject_t * ob, RpsObject_t * obattr,
+		       RpsValue_t oldval, RpsValue_t newval)
+{
+  if (!ob || !obattr || oldval == newval)
+    return;
+  struct rps_attrindex_st *ai = rps_attrindex_find (ob->ob_class, obattr);
+  if (!ai)
+    return;
+  pthread_mutex_lock (&ai->ai_mtx);
+  if (oldval != RPS_NULL_VALUE)
+    rps_attrindex_remove (ai, oldval, ob);
+  if (newval != RPS_NULL_VALUE)
+    rps_attrindex_add (ai, newval, ob);
+  pthread_mutex_unlock (&ai->ai_mtx);
+}				/* end rps_attr_index_update */
+
+void
+rps_attr_index_class_change (RpsObject_t * ob, RpsObject_t * oldcla,
+			     RpsObject_t * newcla)
+{
+  if (!ob || oldcla == newcla)
+    return;
+  for (struct rps_attrindex_st * ai = atomic_load (&rps_attrindex_first);
+       ai; ai = ai->ai_next)
+    {
+      if (ai->ai_class != oldcla && ai->ai_class != newcla)
+	continue;
+      RpsValue_t val = rps_locked_object_get_attribute (ob, ai->ai_attr);
+      if (val == RPS_NULL_VALUE)
+	continue;
+      pthread_mutex_lock (&ai->ai_mtx);
+      if (ai->ai_class == oldcla)
+	rps_attrindex_remove (ai, val, ob);
+      else
+	rps_attrindex_add (ai, val, ob);
+      pthread_mutex_unlock (&ai->ai_mtx);
+    }
+}				/* end rps_attr_index_class_change */
+
+static rps_object_callback_sig_t rps_attrindex_fill_cb;
+static bool
+rps_attrindex_fill_cb (RpsObject_t * ob, void *data)
+{
+  struct rps_attrindex_st *ai = data;
+  pthread_mutex_lock (&ob->ob_mtx);
+  if (ob->ob_class == ai->ai_class)
+    {
+      RpsValue_t val = rps_locked_object_get_attribute (ob, ai->ai_attr);
+      if (val != RPS_NULL_VALUE)
+	{
+	  pthread_mutex_lock (&ai->ai_mtx);
+	  rps_attrindex_add (ai, val, ob);
+	  pthread_mutex_unlock (&ai->ai_mtx);
+	}
+    };
+  pthread_mutex_unlock (&ob->ob_mtx);
+  return true;
+}				/* end rps_attrindex_fill_cb */
+
+bool
+rps_declare_attribute_index (RpsObject_t * obcla, RpsObject_t * obattr)
+{
+  if (!obcla || !obattr)
+    return false;
+  RPS_ASSERT (rps_is_valid_object (obcla));
+  RPS_ASSERT (rps_is_valid_object (obattr));
+  if (rps_obclass_depth (obcla) < 0)
+    return false;
+  pthread_mutex_lock (&rps_attrindex_mtx);
+  struct rps_attrindex_st *ai = rps_attrindex_find (obcla, obattr);
+  if (ai)
+    {
+      pthread_mutex_unlock (&rps_attrindex_mtx);
+      return true;
+    };
+  ai = RPS_ALLOC_ZEROED (sizeof (struct rps_attrindex_st));
+  ai->ai_class = obcla;
+  ai->ai_attr = obattr;
+  pthread_mutex_init (&ai->ai_mtx, NULL);
+  ai->ai_next = atomic_load (&rps_attrindex_first);
+  atomic_store (&rps_attrindex_first, ai);
+  pthread_mutex_unlock (&rps_attrindex_mtx);
+  /* Once published, changes are recorded; every instance is then
+     scanned under its lock, so nothing is missed. */
+  rps_obclass_iterate_instances (obcla, false, rps_attrindex_fill_cb, ai);
+  return true;
+}				/* end rps_declare_attribute_index */
+
+bool
+rps_has_attribute_index (RpsObject_t * obcla, RpsObject_t * obattr)
+{
+  return rps_attrindex_find (obcla, obattr) != NULL;
+}				/* end rps_has_attribute_index */
+
+/* The set of indexed objects whose value is between LOVAL and HIVAL
+   included; a null bound is unlimited. */
+const RpsSetOb_t *
+rps_attribute_index_range (RpsObject_t * obcla, RpsObject_t * obattr,
+			   RpsValue_t loval, RpsValue_t hival)
+{
+  struct rps_attrindex_st *ai = rps_attrindex_find (obcla, obattr);
+  if (!ai)
+    return NULL;
+  const RpsSetOb_t *set = NULL;
+  pthread_mutex_lock (&ai->ai_mtx);
+  if (!ai->ai_root)
+    goto end;
+  const RpsObject_t **obarr =
+    RPS_ALLOC_ZEROED ((ai->ai_count + 1) * sizeof (RpsObject_t *));
+  unsigned nbob = 0;
+  struct kavl_itr_rpsattrindex iter = { };
+  bool more = false;
+  if (loval == RPS_NULL_VALUE)
+    {
+      kavl_itr_first_rpsattrindex (ai->ai_root, &iter);
+      more = true;
+    }
+  else
+    {
+      /// positioned on the first node not below the key
+      struct rps_attrindex_node_st keynod = {.ainod_val = loval };
+      (void) kavl_itr_find_rpsattrindex (ai->ai_root, &keynod, &iter);
+      more = iter.top >= iter.stack;
+    };
+  while (more)
+    {
+      const struct rps_attrindex_node_st *nod = kavl_at (&iter);
+      if (hival != RPS_NULL_VALUE && rps_value_cmp (nod->ainod_val, hival) > 0)
+	break;
+      RPS_ASSERT (nbob < ai->ai_count);
+      obarr[nbob++] = nod->ainod_ob;
+      more = kavl_itr_next_rpsattrindex (&iter);
+    };
+  set = rps_alloc_set_sized (nbob, obarr);
+  free (obarr);
+end:
+  pthread_mutex_unlock (&ai->ai_mtx);
+  return set;
+}				/* end rps_attribute_index_range */
+
+const RpsSetOb_t *
+rps_attribute_index_find (RpsObject_t * obcla, RpsObject_t * obattr,
+			  RpsValue_t val)
+{
+  if (val == RPS_NULL_VALUE)
+    return NULL;
+  return rps_attribute_index_range (obcla, obattr, val, val);
+}				/* end rps_attribute_index_find */
+
+/****** end of file attrindex_rps.c ******/
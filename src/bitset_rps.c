@@ -0,0 +1,326 @@
+/****************************************************************
+ * file bitset_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the bit sets indexed by dense object indexes, see
+ *      rps_object_index in object_rps.c
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "Refpersys.h"
+
+/* A bit set is a plain malloc-ed array of 64 bits words, which grows
+   when needed.  It is not a value and is not garbage collected, so it
+   should be explicitly destroyed.  The set operations work word by
+   word in simple loops, and counting or iterating on set bits uses the
+   popcount and count trailing zeros builtins of GCC. */
+
+#define RPS_BITSET_WORDBITS 64
+
+static inline unsigned
+rps_bitset_nbwords_for (uint32_t nbbits)
+{
+  return (unsigned) (((uint64_t) nbbits + RPS_BITSET_WORDBITS - 1)
+		     / RPS_BITSET_WORDBITS);
+}				/* end rps_bitset_nbwords_for */
+
+bool
+rps_bitset_is_valid (const RpsBitSet_t * bs)
+{
+  if (!bs)
+    return false;
+  if (bs->bs_magic != RPS_BITSET_MAGIC)
+    return false;
+  if (bs->bs_nbwords > 0 && !bs->bs_words)
+    return false;
+  return true;
+}				/* end rps_bitset_is_valid */
+
+RpsBitSet_t *
+rps_bitset_create (uint32_t nbbits)
+{
+  if (nbbits == 0)
+    nbbits = rps_object_index_bound ();
+  RpsBitSet_t *bs = RPS_ALLOC_ZEROED (sizeof (RpsBitSet_t));
+  bs->bs_magic = RPS_BITSET_MAGIC;
+  bs->bs_nbwords = rps_bitset_nbwords_for (nbbits) + 1;
+  bs->bs_words = RPS_ALLOC_ZEROED (bs->bs_nbwords * sizeof (uint64_t));
+  return bs;
+}				/* end rps_bitset_create */
+
+void
+rps_bitset_destroy (RpsBitSet_t * bs)
+{
+  if (!rps_bitset_is_valid (bs))
+    return;
+  free (bs->bs_words);
+  bs->bs_words = NULL;
+  bs->bs_nbwords = 0;
+  bs->bs_magic = 0;
+  free (bs);
+}				/* end rps_bitset_destroy */
+
+/* grow the bit set to be able to contain bit index IX */
+static void
+rps_bitset_reserve (RpsBitSet_t * bs, uint32_t ix)
+{
+  RPS_ASSERT (rps_bitset_is_valid (bs));
+  unsigned wix = ix / RPS_BITSET_WORDBITS;
+  if (wix < bs->bs_nbwords)
+    return;
+  unsigned newnbw = wix + wix / 4 + 8;
+  uint64_t *newarr = RPS_ALLOC_ZEROED (newnbw * sizeof (uint64_t));
+  if (bs->bs_nbwords > 0)
+    memcpy (newarr, bs->bs_words, bs->bs_nbwords * sizeof (uint64_t));
+  free (bs->bs_words);
+  bs->bs_words = newarr;
+  bs->bs_nbwords = newnbw;
+}				/* end rps_bitset_reserve */
+
+bool
+rps_bitset_test (const RpsBitSet_t * bs, uint32_t ix)
+{
+  if (!rps_bitset_is_valid (bs))
+    return false;
+  unsigned wix = ix / RPS_BITSET_WORDBITS;
+  if (wix >= bs->bs_nbwords)
+    return false;
+  return (bs->bs_words[wix] >> (ix % RPS_BITSET_WORDBITS)) & 1;
+}				/* end rps_bitset_test */
+
+// set a bit, return true if it was not already set
+bool
+rps_bitset_put (RpsBitSet_t * bs, uint32_t ix)
+{
+  if (!rps_bitset_is_valid (bs))
+    return false;
+  rps_bitset_reserve (bs, ix);
+  uint64_t mask = (uint64_t) 1 << (ix % RPS_BITSET_WORDBITS);
+  uint64_t *pw = bs->bs_words + ix / RPS_BITSET_WORDBITS;
+  if (*pw & mask)
+    return false;
+  *pw |= mask;
+  return true;
+}				/* end rps_bitset_put */
+
+// clear a bit, return true if it was set
+bool
+rps_bitset_remove (RpsBitSet_t * bs, uint32_t ix)
+{
+  if (!rps_bitset_is_valid (bs))
+    return false;
+  unsigned wix = ix / RPS_BITSET_WORDBITS;
+  if (wix >= bs->bs_nbwords)
+    return false;
+  uint64_t mask = (uint64_t) 1 << (ix % RPS_BITSET_WORDBITS);
+  if (!(bs->bs_words[wix] & mask))
+    return false;
+  bs->bs_words[wix] &= ~mask;
+  return true;
+}				/* end rps_bitset_remove */
+
+void
+rps_bitset_clear_all (RpsBitSet_t * bs)
+{
+  if (!rps_bitset_is_valid (bs))
+    return;
+  memset (bs->bs_words, 0, bs->bs_nbwords * sizeof (uint64_t));
+}				/* end rps_bitset_clear_all */
+
+unsigned long
+rps_bitset_popcount (const RpsBitSet_t * bs)
+{
+  unsigned long cnt = 0;
+  if (!rps_bitset_is_valid (bs))
+    return 0;
+  for (unsigned wix = 0; wix < bs->bs_nbwords; wix++)
+    cnt += __builtin_popcountll (bs->bs_words[wix]);
+  return cnt;
+}				/* end rps_bitset_popcount */
+
+// DST becomes the union of DST and SRC
+void
+rps_bitset_union_with (RpsBitSet_t * dst, const RpsBitSet_t * src)
+{
+  if (!rps_bitset_is_valid (dst) || !rps_bitset_is_valid (src))
+    return;
+  if (src->bs_nbwords > dst->bs_nbwords)
+    rps_bitset_reserve (dst, src->bs_nbwords * RPS_BITSET_WORDBITS - 1);
+  uint64_t *restrict dw = dst->bs_words;
+  const uint64_t *restrict sw = src->bs_words;
+  unsigned nbw = src->bs_nbwords;
+  for (unsigned wix = 0; wix < nbw; wix++)
+    dw[wix] |= sw[wix];
+}				/* end rps_bitset_union_with */
+
+// DST becomes the intersection of DST and SRC
+void
+rps_bitset_intersect_with (RpsBitSet_t * dst, const RpsBitSet_t * src)
+{
+  if (!rps_bitset_is_valid (dst) || !rps_bitset_is_valid (src))
+    return;
+  uint64_t *restrict dw = dst->bs_words;
+  const uint64_t *restrict sw = src->bs_words;
+  unsigned nbw = (dst->bs_nbwords < src->bs_nbwords)
+    ? dst->bs_nbwords : src->bs_nbwords;
+  for (unsigned wix = 0; wix < nbw; wix++)
+    dw[wix] &= sw[wix];
+  if (dst->bs_nbwords > nbw)
+    memset (dw + nbw, 0, (dst->bs_nbwords - nbw) * sizeof (uint64_t));
+}				/* end rps_bitset_intersect_with */
+
+// DST becomes DST without the bits of SRC
+void
+rps_bitset_difference_with (RpsBitSet_t * dst, const RpsBitSet_t * src)
+{
+  if (!rps_bitset_is_valid (dst) || !rps_bitset_is_valid (src))
+    return;
+  uint64_t *restrict dw = dst->bs_words;
+  const uint64_t *restrict sw = src->bs_words;
+  unsigned nbw = (dst->bs_nbwords < src->bs_nbwords)
+    ? dst->bs_nbwords : src->bs_nbwords;
+  for (unsigned wix = 0; wix < nbw; wix++)
+    dw[wix] &= ~sw[wix];
+}				/* end rps_bitset_difference_with */
+
+/* iterate in increasing order on the set bits, till ROUT returns
+   false; return the number of successful calls to ROUT */
+unsigned long
+rps_bitset_iterate (const RpsBitSet_t * bs, rps_bitindex_callback_sig_t * rout,
+		    void *data)
+{
+  unsigned long cnt = 0;
+  if (!rps_bitset_is_valid (bs) || !rout)
+    return 0;
+  for (unsigned wix = 0; wix < bs->bs_nbwords; wix++)
+    {
+      uint64_t w = bs->bs_words[wix];
+      while (w != 0)
+	{
+	  int bix = __builtin_ctzll (w);
+	  w &= w - 1;
+	  if (!(*rout) (wix * RPS_BITSET_WORDBITS + bix, data))
+	    return cnt;
+	  cnt++;
+	}
+    };
+  return cnt;
+}				/* end rps_bitset_iterate */
+
+
+/********** bit sets of objects, using their dense index **********/
+bool
+rps_bitset_put_object (RpsBitSet_t * bs, const RpsObject_t * ob)
+{
+  uint32_t ix = rps_object_index (ob);
+  if (ix == 0)
+    return false;
+  return rps_bitset_put (bs, ix);
+}				/* end rps_bitset_put_object */
+
+bool
+rps_bitset_remove_object (RpsBitSet_t * bs, const RpsObject_t * ob)
+{
+  uint32_t ix = rps_object_index (ob);
+  if (ix == 0)
+    return false;
+  return rps_bitset_remove (bs, ix);
+}				/* end rps_bitset_remove_object */
+
+bool
+rps_bitset_contains_object (const RpsBitSet_t * bs, const RpsObject_t * ob)
+{
+  uint32_t ix = rps_object_index (ob);
+  if (ix == 0)
+    return false;
+  return rps_bitset_test (bs, ix);
+}				/* end rps_bitset_contains_object */
+
+struct rps_bitset_objiter_st
+{
+  rps_object_callback_sig_t *boi_rout;
+  void *boi_data;
+  const RpsObject_t **boi_arr;	/* for rps_bitset_set_of_objects */
+  unsigned long boi_count;
+};
+
+static rps_bitindex_callback_sig_t rps_bitset_objiter_call;
+static bool
+rps_bitset_objiter_call (uint32_t ix, void *data)
+{
+  struct rps_bitset_objiter_st *boi = data;
+  RpsObject_t *ob = rps_object_of_index (ix);
+  if (!ob)			/* stale index, whose object was freed */
+    return true;
+  if (!(*boi->boi_rout) (ob, boi->boi_data))
+    return false;
+  boi->boi_count++;
+  return true;
+}				/* end rps_bitset_objiter_call */
+
+/* iterate on the objects of a bit set, till ROUT returns false; return
+   the number of successful calls to ROUT, so without stale indexes */
+unsigned long
+rps_bitset_iterate_objects (const RpsBitSet_t * bs,
+			    rps_object_callback_sig_t * rout, void *data)
+{
+  struct rps_bitset_objiter_st boi = {.boi_rout = rout,.boi_data = data };
+  if (!rout)
+    return 0;
+  (void) rps_bitset_iterate (bs, rps_bitset_objiter_call, &boi);
+  return boi.boi_count;
+}				/* end rps_bitset_iterate_objects */
+
+static rps_bitindex_callback_sig_t rps_bitset_collect_object;
+static bool
+rps_bitset_collect_object (uint32_t ix, void *data)
+{
+  struct rps_bitset_objiter_st *boi = data;
+  RpsObject_t *ob = rps_object_of_index (ix);
+  if (ob)
+    boi->boi_arr[boi->boi_count++] = ob;
+  return true;
+}				/* end rps_bitset_collect_object */
+
+// make a set value of the objects of a bit set
+const RpsSetOb_t *
+rps_bitset_set_of_objects (const RpsBitSet_t * bs)
+{
+  const RpsSetOb_t *setv = NULL;
+  if (!rps_bitset_is_valid (bs))
+    return NULL;
+  unsigned long card = rps_bitset_popcount (bs);
+  struct rps_bitset_objiter_st boi = { };
+  boi.boi_arr = RPS_ALLOC_ZEROED ((card + 1) * sizeof (RpsObject_t *));
+  rps_bitset_iterate (bs, rps_bitset_collect_object, &boi);
+  RPS_ASSERT (boi.boi_count <= card);
+  setv = rps_alloc_set_sized (boi.boi_count, boi.boi_arr);
+  free (boi.boi_arr);
+  return setv;
+}				/* end rps_bitset_set_of_objects */
+
+/************************ end of file bitset_rps.c ******************/
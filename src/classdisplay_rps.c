@@ -0,0 +1,217 @@
+/****************************************************************
+ * file classdisplay_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the ancestor displays of classes, for constant
+ *      time subclass and instance tests.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "Refpersys.h"
+
+/* The display of a class is the array of its ancestors, indexed by
+   their depth.  Then OBSUB is a subclass of OBSUPER of depth D iff the
+   display of OBSUB has OBSUPER at index D.  Displays are computed
+   lazily like flattened method tables in selector_rps.c, walking the
+   superclasses one lock at a time without holding the lock of the
+   class, and stamped with the hierarchy epoch read before.  A class
+   whose hierarchy is deeper than RPS_CLASSDISPLAY_MAX_DEPTH, or
+   circular, e.g. as loaded or because a deep subtree was put under
+   another class, has no display: it then has no depth and is a
+   subclass of nothing. */
+
+static atomic_ulong rps_classdisplay_epoch = 1;
+
+unsigned long
+rps_class_hierarchy_epoch (void)
+{
+  return atomic_load (&rps_classdisplay_epoch);
+}				/* end rps_class_hierarchy_epoch */
+
+void
+rps_class_hierarchy_changed (void)
+{
+  atomic_fetch_add (&rps_classdisplay_epoch, 1);
+}				/* end rps_class_hierarchy_changed */
+
+static struct rps_classdisplay_st *
+rps_build_class_display (RpsObject_t * obcla, unsigned long epoch)
+{
+  RpsObject_t *chainarr[RPS_CLASSDISPLAY_MAX_DEPTH];
+  unsigned nbchain = 0;
+  RpsObject_t *curcla = obcla;
+  memset (chainarr, 0, sizeof (chainarr));
+  while (curcla)
+    {
+      RpsObject_t *superob = NULL;
+      if (nbchain >= RPS_CLASSDISPLAY_MAX_DEPTH)
+	{
+	  char idbuf[32];
+	  memset (idbuf, 0, sizeof (idbuf));
+	  rps_oid_to_cbuf (obcla->ob_id, idbuf);
+	  RPS_DEBUG_PRINTF (MISC, "too deep or circular class hierarchy for %s",
+			    idbuf);
+	  return NULL;
+	};
+      pthread_mutex_lock (&curcla->ob_mtx);
+      RpsClassInfo_t *clinf = rps_locked_object_classinfo (curcla);
+      if (clinf && clinf->pclass_magic == RPS_CLASSINFO_MAGIC)
+	{
+	  chainarr[nbchain++] = curcla;
+	  superob = clinf->pclass_super;
+	};
+      pthread_mutex_unlock (&curcla->ob_mtx);
+      curcla = superob;
+    };
+  if (nbchain == 0)
+    return NULL;
+  struct rps_classdisplay_st *disp =
+    RPS_ALLOC_ZEROED (sizeof (struct rps_classdisplay_st)
+		      + nbchain * sizeof (RpsObject_t *));
+  disp->cd_epoch = epoch;
+  disp->cd_depth = nbchain - 1;
+  for (unsigned ix = 0; ix < nbchain; ix++)
+    disp->cd_arr[ix] = chainarr[nbchain - 1 - ix];
+  return disp;
+}				/* end rps_build_class_display */
+
+/* lock the class OBCLA, returning its up to date display, or NULL if
+   it is not a class or its hierarchy is too deep */
+static struct rps_classdisplay_st *
+rps_lock_class_with_display (RpsObject_t * obcla)
+{
+  unsigned long epoch = atomic_load (&rps_classdisplay_epoch);
+  pthread_mutex_lock (&obcla->ob_mtx);
+  RpsClassInfo_t *clinf = rps_locked_object_classinfo (obcla);
+  if (!clinf || clinf->pclass_magic != RPS_CLASSINFO_MAGIC)
+    return NULL;
+  if (clinf->pclass_display && clinf->pclass_display->cd_epoch == epoch)
+    return clinf->pclass_display;
+  pthread_mutex_unlock (&obcla->ob_mtx);
+  struct rps_classdisplay_st *newdisp =
+    rps_build_class_display (obcla, epoch);
+  pthread_mutex_lock (&obcla->ob_mtx);
+  clinf = rps_locked_object_classinfo (obcla);
+  if (!clinf || clinf->pclass_magic != RPS_CLASSINFO_MAGIC || !newdisp)
+    {
+      free (newdisp);
+      return NULL;
+    };
+  /// readers of the old display hold the class lock, so it can be freed
+  free (clinf->pclass_display);
+  clinf->pclass_display = newdisp;
+  return newdisp;
+}				/* end rps_lock_class_with_display */
+
+int
+rps_obclass_depth (RpsObject_t * obcla)
+{
+  int depth = -1;
+  if (!obcla || !rps_is_valid_object (obcla))
+    return -1;
+  struct rps_classdisplay_st *disp = rps_lock_class_with_display (obcla);
+  if (disp)
+    depth = (int) disp->cd_depth;
+  pthread_mutex_unlock (&obcla->ob_mtx);
+  return depth;
+}				/* end rps_obclass_depth */
+
+bool
+rps_is_subclass (RpsObject_t * obsub, RpsObject_t * obsuper)
+{
+  bool res = false;
+  if (!obsub || !obsuper)
+    return false;
+  if (obsub == obsuper)
+    return rps_obclass_depth (obsub) >= 0;
+  /// the classes are locked one after the other, never together
+  int superdepth = rps_obclass_depth (obsuper);
+  if (superdepth < 0)
+    return false;
+  if (!rps_is_valid_object (obsub))
+    return false;
+  struct rps_classdisplay_st *disp = rps_lock_class_with_display (obsub);
+  if (disp && (unsigned) superdepth <= disp->cd_depth)
+    res = disp->cd_arr[superdepth] == obsuper;
+  pthread_mutex_unlock (&obsub->ob_mtx);
+  return res;
+}				/* end rps_is_subclass */
+
+RpsObject_t *
+rps_class_of_value (RpsValue_t val)
+{
+  switch (rps_value_type (val))
+    {
+    case RPS_TYPE_INT:
+      return RPS_ROOT_OB (_2A2mrPpR3Qf03p6o5b);	//int∈class
+    case RPS_TYPE_DOUBLE:
+      return RPS_ROOT_OB (_98sc8kSOXV003i86w5);	//double∈class
+    case RPS_TYPE_STRING:
+      return RPS_ROOT_OB (_62LTwxwKpQ802SsmjE);	//string∈class
+    case RPS_TYPE_JSON:
+      return RPS_ROOT_OB (_3GHJQW0IIqS01QY8qD);	//json∈class
+    case RPS_TYPE_TUPLE:
+      return RPS_ROOT_OB (_6NVM7sMcITg01ug5TC);	//tuple∈class
+    case RPS_TYPE_SET:
+      return RPS_ROOT_OB (_6JYterg6iAu00cV9Ye);	//set∈class
+    case RPS_TYPE_CLOSURE:
+      return RPS_ROOT_OB (_4jISxMJ4PYU0050nUl);	//closure∈class
+    case RPS_TYPE_OBJECT:
+      {
+	RpsObject_t *ob = (RpsObject_t *) val;
+	RpsObject_t *obclass = NULL;
+	pthread_mutex_lock (&ob->ob_mtx);
+	obclass = ob->ob_class;
+	pthread_mutex_unlock (&ob->ob_mtx);
+	return obclass;
+      }
+    default:
+      return NULL;
+    }
+}				/* end rps_class_of_value */
+
+bool
+rps_is_instance_of (RpsValue_t val, RpsObject_t * obcla)
+{
+  if (val == RPS_NULL_VALUE || !obcla)
+    return false;
+  RpsObject_t *obvalclass = rps_class_of_value (val);
+  if (!obvalclass)
+    return false;
+  return rps_is_subclass (obvalclass, obcla);
+}				/* end rps_is_instance_of */
+
+void
+rps_classinfo_free_display (RpsClassInfo_t * clinf)
+{
+  if (!clinf)
+    return;
+  free (clinf->pclass_display);
+  clinf->pclass_display = NULL;
+}				/* end rps_classinfo_free_display */
+
+/****** end of file classdisplay_rps.c ******/
@@ -132,14 +132,11 @@ rps_alloc_set_sized (unsigned nbcomp, const RpsObject_t ** arr)
   rps_object_array_qsort (arrcpy, (int) nbob);
   int card = 0;
   bool duplicate = false;
-  if (nbob == 1 && arrcpy[0])
-    card = 1;
-  else
-    for (int ix = 0; ix < (int) nbob - 1; ix++)
-      if (arrcpy[ix + 1] != arrcpy[ix])
-	card++;
-      else
-	duplicate = true;
+  for (int ix = 0; ix < (int) nbob; ix++)
+    if (ix == 0 || arrcpy[ix] != arrcpy[ix - 1])
+      card++;
+    else
+      duplicate = true;
   set =
     RPS_ALLOC_ZONE (sizeof (RpsSetOb_t) + (card * sizeof (RpsObject_t *)),
 		    RPS_TYPE_SET);
@@ -149,15 +146,11 @@ rps_alloc_set_sized (unsigned nbcomp, const RpsObject_t ** arr)
       if (card > 0)
 	{
 	  int setix = 0;
-	  for (int ix = 0; ix < (int) nbob - 1; ix++)
+	  for (int ix = 0; ix < (int) nbob; ix++)
 	    {
-	      if (arrcpy[ix + 1] != arrcpy[ix] && arrcpy[ix])
+	      if (ix == 0 || arrcpy[ix] != arrcpy[ix - 1])
 		set->set_elem[setix++] = arrcpy[ix];
 	    };
-	  if (nbob == 1 && arrcpy[0])
-	    set->set_elem[0] = arrcpy[0];
-	  else if (nbob > 1 && arrcpy[nbob - 1] != arrcpy[nbob - 2])
-	    set->set_elem[setix] = arrcpy[nbob - 1];
 	  RPS_ASSERT (card == setix);
 	}
     }
@@ -558,6 +551,7 @@ rps_paylsetob_add_element (RpsMutableSetOb_t * paylmset,
 {
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (paylmset) == -RpsPyt_MutableSetOb);
   RPS_ASSERT (ob != NULL && rps_is_valid_object ((RpsObject_t *) ob));
+  rps_locked_payload_touch (paylmset);
   struct internal_mutable_set_ob_node_rps_st *newnod =
     RPS_ALLOC_ZEROED (sizeof (struct internal_mutable_set_ob_node_rps_st));
   newnod->setobnodrps_obelem = ob;
@@ -585,6 +579,7 @@ rps_paylsetob_remove_element (RpsMutableSetOb_t * paylmset,
 {
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (paylmset) == -RpsPyt_MutableSetOb);
   RPS_ASSERT (ob != NULL && rps_is_valid_object ((RpsObject_t *) ob));
+  rps_locked_payload_touch (paylmset);
   struct internal_mutable_set_ob_node_rps_st *newnod =
     RPS_ALLOC_ZEROED (sizeof (struct internal_mutable_set_ob_node_rps_st));
   newnod->setobnodrps_obelem = ob;
@@ -898,7 +893,13 @@ rps_payl_string_dictionary_add_cstr (RpsStringDictOb_t * paylstrdic,
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (paylstrdic) == -RpsPyt_StringDict);
   RPS_ASSERT (cstr && g_utf8_validate (cstr, -1, NULL));
   RPS_ASSERT (val != RPS_NULL_VALUE);
+  rps_locked_payload_touch (paylstrdic);
   const RpsString_t *strv = rps_alloc_string (cstr);
+  if (paylstrdic->payl_owner)
+    {
+      rps_trigram_note_value (paylstrdic->payl_owner, (RpsValue_t) strv);
+      rps_trigram_note_value (paylstrdic->payl_owner, val);
+    };
   struct internal_string_dict_node_rps_st *newnod =
     RPS_ALLOC_ZEROED (sizeof (struct internal_string_dict_node_rps_st));
   newnod->strdicnodrps_name = strv;
@@ -922,6 +923,12 @@ rps_payl_string_dictionary_add_valstr (RpsStringDictOb_t * paylstrdic,
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (paylstrdic) == -RpsPyt_StringDict);
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (strv) == RPS_TYPE_STRING);
   RPS_ASSERT (val != RPS_NULL_VALUE);
+  rps_locked_payload_touch (paylstrdic);
+  if (paylstrdic->payl_owner)
+    {
+      rps_trigram_note_value (paylstrdic->payl_owner, (RpsValue_t) strv);
+      rps_trigram_note_value (paylstrdic->payl_owner, val);
+    };
   struct internal_string_dict_node_rps_st *newnod =
     RPS_ALLOC_ZEROED (sizeof (struct internal_string_dict_node_rps_st));
   newnod->strdicnodrps_name = strv;
@@ -1228,6 +1235,7 @@ rps_payldeque_pop_first (RpsDequeOb_t * payldeq)
     }
   RPS_ASSERT (payldeq->zm_length > 0);
   RPS_ASSERT (firstlink->dequeob_prev == NULL);
+  rps_locked_payload_touch (payldeq);
   for (int i = 0; i < RPS_DEQUE_CHUNKSIZE; i++)
     {
       resob = firstlink->dequeob_chunk[i];
@@ -1277,6 +1285,7 @@ rps_payldeque_push_first (RpsDequeOb_t * deq, RpsObject_t * obelem)
   bool pushed = false;
   if (!deq || RPS_ZONED_MEMORY_TYPE (deq) != -RpsPyt_DequeOb)
     goto end;
+  rps_locked_payload_touch (deq);
   struct rps_dequeob_link_st *firstlink = deq->deqob_first;
   if (!firstlink)
     {
@@ -1380,6 +1389,7 @@ rps_payldeque_pop_last (RpsDequeOb_t * payldeq)
       goto end;
     }
   RPS_ASSERT (lastlink->dequeob_next == NULL);
+  rps_locked_payload_touch (payldeq);
   for (int i = RPS_DEQUE_CHUNKSIZE - 1; i >= 0; i--)
     {
       resob = lastlink->dequeob_chunk[i];
@@ -1437,6 +1447,7 @@ rps_payldeque_push_last (RpsDequeOb_t * payldeq, RpsObject_t * obelem)
     goto end;
   if (RPS_ZONED_MEMORY_TYPE (payldeq) != -RpsPyt_DequeOb)
     goto end;
+  rps_locked_payload_touch (payldeq);
   struct rps_dequeob_link_st *lastlink = payldeq->deqob_last;
   if (!lastlink)
     {
@@ -1818,6 +1829,7 @@ rps_hash_tbl_ob_add (RpsHashTblOb_t * htb, RpsObject_t * obelem)
     return false;
   RPS_ASSERT (htb->htbob_magic == RPS_HTBOB_MAGIC);
   RPS_ASSERT (rps_is_valid_object (obelem));
+  rps_locked_payload_touch (htb);
   int oldprix = htb->zm_xtra;
   unsigned curlen = htb->zm_length;
   unsigned oldsiz = rps_prime_of_index (oldprix);
@@ -1842,6 +1854,7 @@ rps_hash_tbl_ob_remove (RpsHashTblOb_t * htb, RpsObject_t * obelem)
     return false;
   RPS_ASSERT (htb->htbob_magic == RPS_HTBOB_MAGIC);
   RPS_ASSERT (rps_is_valid_object (obelem));
+  rps_locked_payload_touch (htb);
   int oldprix = htb->zm_xtra;
   unsigned curlen = htb->zm_length;
   if (curlen == 0)
@@ -51,21 +51,19 @@ struct RpsPayl_Dumper_st
   rps_callframe_t *du_callframe;
   double du_start_realtime;
   double du_start_cputime;
-  /* The dumper probably needs to contain a big hash table of visited
+  /* The dumper needs to contain a big bit set of visited
      objects; a first pass is scanning the heap, starting from global
      roots including the agenda. During the dump only one pthread should
      be running, every other pthread should be blocked. The agenda should
      be "idle".
    */
   const RpsString_t *du_dirnam;
-  // the large hash table of visited objects....
-  RpsHashTblOb_t *du_visitedht;
+  // the large bit set of visited objects, by their object index....
+  RpsBitSet_t *du_visitedbits;
   // the smaller hash table of visited spaces...
   RpsHashTblOb_t *du_spaceht;
   // the smaller hash table for the current space
   RpsHashTblOb_t *du_htcurspace;
-  // the queue of object to scan internally....
-  RpsDequeOb_t *du_deque;
   // small set of space objects; at most RPS_DUMP_MAX_NB_SPACE elements
   const RpsSetOb_t *du_spaceset;
   // for each dumped space
@@ -74,6 +72,14 @@ struct RpsPayl_Dumper_st
     unsigned sp_size;
     FILE *sp_file;
   } du_spacedescr[RPS_DUMP_MAX_NB_SPACE];
+  /* When du_refrout is set, this is not a real dumper: scanned objects
+     are just given to it, see rps_object_scan_references. */
+  rps_object_callback_sig_t *du_refrout;
+  void *du_refdata;
+  /* When du_refvalrout is set, scanned strings are given to it, with
+     du_refdata, and scanned objects are ignored unless du_refrout is
+     also set; see rps_object_scan_strings. */
+  rps_value_callback_sig_t *du_refvalrout;
 };				/* end struct RpsPayl_Dumper_st */
 
 enum rps_dump_state_en
@@ -126,8 +132,9 @@ rps_dumper_scan_internal_object (RpsDumper_t * du, RpsObject_t * ob)
 {
   RPS_ASSERT (du && du->du_magic == RPS_DUMPER_MAGIC);
   RPS_ASSERT (ob && rps_is_valid_object (ob));
-  RPS_ASSERT (du->du_spaceht
-	      && du->du_spaceht->htbob_magic == RPS_HTBOB_MAGIC);
+  RPS_ASSERT (du->du_refrout || du->du_refvalrout
+	      || (du->du_spaceht
+		  && du->du_spaceht->htbob_magic == RPS_HTBOB_MAGIC));
   char oidbuf[32];
   memset (oidbuf, 0, sizeof (oidbuf));
   rps_oid_to_cbuf (ob->ob_id, oidbuf);
@@ -146,7 +153,8 @@ rps_dumper_scan_internal_object (RpsDumper_t * du, RpsObject_t * ob)
   if (ob->ob_space)
     {
       RPS_ASSERT (rps_is_valid_object (ob->ob_space));
-      (void) rps_hash_tbl_ob_add (du->du_spaceht, ob->ob_space);
+      if (du->du_spaceht)
+	(void) rps_hash_tbl_ob_add (du->du_spaceht, ob->ob_space);
       rps_dumper_scan_object (du, ob->ob_space);
     }
   /// scan the table of attributes
@@ -171,6 +179,19 @@ rps_dumper_scan_internal_object (RpsDumper_t * du, RpsObject_t * ob)
 	RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (atbl) == -RpsPyt_AttrTable);
       };
   }
+  /// scan the shaped attributes
+  {
+    const RpsShape_t *sh = ob->ob_shape;
+    if (sh)
+      {
+	RPS_ASSERT (rps_is_valid_shape (sh));
+	for (unsigned slot = 0; slot < sh->shap_nbattrs; slot++)
+	  {
+	    rps_dumper_scan_object (du, sh->shap_attrs[slot]);
+	    rps_dumper_scan_value (du, ob->ob_shapvals[slot], 0);
+	  }
+      };
+  }
   /// scan the components
   {
     unsigned nbcomp = ob->ob_nbcomp;
@@ -195,6 +216,89 @@ end:
   RPS_DEBUG_PRINTF (DUMP, "end scan-internal-ob %s\n", oidbuf);
 }				/* end rps_dumper_scan_internal_object */
 
+/* Apply ROUT to every object directly referenced by OB, thru its class,
+   space, attributes, components or payload, with OB locked.  The
+   payload dump scanners are reused, with a fake dumper, so ROUT
+   should not lock any object and may get the same object twice. */
+void
+rps_object_scan_references (RpsObject_t * ob,
+			    rps_object_callback_sig_t * rout, void *data)
+{
+  RPS_ASSERT (rps_is_valid_object (ob));
+  if (!rout)
+    return;
+  RpsDumper_t refdu;
+  memset (&refdu, 0, sizeof (refdu));
+  refdu.du_magic = RPS_DUMPER_MAGIC;
+  refdu.zm_xtra = (int) rpsdumpstate_scanning;
+  refdu.du_refrout = rout;
+  refdu.du_refdata = data;
+  rps_dumper_scan_internal_object (&refdu, ob);
+}				/* end rps_object_scan_references */
+
+/* Apply ROUT to every string value in OB, thru its attributes,
+   components or payload, with OB locked.  Like the references, they
+   are found by the payload dump scanners with a fake dumper. */
+void
+rps_object_scan_strings (RpsObject_t * ob,
+			 rps_value_callback_sig_t * rout, void *data)
+{
+  RPS_ASSERT (rps_is_valid_object (ob));
+  if (!rout)
+    return;
+  RpsDumper_t strdu;
+  memset (&strdu, 0, sizeof (strdu));
+  strdu.du_magic = RPS_DUMPER_MAGIC;
+  strdu.zm_xtra = (int) rpsdumpstate_scanning;
+  strdu.du_refvalrout = rout;
+  strdu.du_refdata = data;
+  rps_dumper_scan_internal_object (&strdu, ob);
+}				/* end rps_object_scan_strings */
+
+/// likewise, only for the payload of the locked object OB
+void
+rps_locked_object_scan_payload_strings (RpsObject_t * ob,
+					rps_value_callback_sig_t * rout,
+					void *data)
+{
+  RPS_ASSERT (rps_is_valid_object (ob));
+  if (!rout || !ob->ob_payload)
+    return;
+  RpsDumper_t strdu;
+  memset (&strdu, 0, sizeof (strdu));
+  strdu.du_magic = RPS_DUMPER_MAGIC;
+  strdu.zm_xtra = (int) rpsdumpstate_scanning;
+  strdu.du_refvalrout = rout;
+  strdu.du_refdata = data;
+  rps_dump_scan_object_payload (&strdu, ob);
+}				/* end rps_locked_object_scan_payload_strings */
+
+/* Give the JSON of the content of a locked object, as dumped without
+   dump closure, but without its oid and mtime: its class, space,
+   components, attributes and payload.  This is the canonical form
+   hashed by rps_object_content_hash, using a fake dumper. */
+json_t *
+rps_locked_object_content_json (RpsObject_t * ob)
+{
+  RPS_ASSERT (rps_is_valid_object (ob));
+  RpsDumper_t hashdu;
+  memset (&hashdu, 0, sizeof (hashdu));
+  hashdu.du_magic = RPS_DUMPER_MAGIC;
+  hashdu.zm_xtra = (int) rpsdumpstate_dumpingdata;
+  json_t *jsob = json_object ();
+  json_object_set_new (jsob, "class",
+		       rps_dump_json_for_object (&hashdu, ob->ob_class));
+  json_object_set_new (jsob, "space",
+		       rps_dump_json_for_object (&hashdu, ob->ob_space));
+  (void) rpscloj_dump_object_components (NULL, NULL, &hashdu,
+					 (RpsValue_t) ob, jsob);
+  (void) rpscloj_dump_object_attributes (NULL, NULL, &hashdu,
+					 (RpsValue_t) ob, jsob);
+  if (ob->ob_payload)
+    rps_dump_serialize_object_payload (&hashdu, ob, jsob);
+  return jsob;
+}				/* end rps_locked_object_content_json */
+
 
 void
 rps_dumper_scan_value (RpsDumper_t * du, RpsValue_t val, unsigned depth)
@@ -212,6 +316,8 @@ rps_dumper_scan_value (RpsDumper_t * du, RpsValue_t val, unsigned depth)
     case RPS_TYPE_INT:
       return;
     case RPS_TYPE_STRING:
+      if (du->du_refvalrout)
+	(void) (*du->du_refvalrout) (val, du->du_refdata);
       return;
     case RPS_TYPE_JSON:
       return;
@@ -265,6 +371,12 @@ rps_dumper_scan_object (RpsDumper_t * du, RpsObject_t * ob)
   RPS_ASSERT (rps_is_valid_dumper (du));
   if (!ob)
     return;
+  if (du->du_refrout || du->du_refvalrout)
+    {
+      if (du->du_refrout)
+	(void) (*du->du_refrout) (ob, du->du_refdata);
+      return;
+    };
   char obid[32];
   memset (obid, 0, sizeof (obid));
   rps_oid_to_cbuf (ob->ob_id, obid);
@@ -275,22 +387,47 @@ rps_dumper_scan_object (RpsDumper_t * du, RpsObject_t * ob)
       RPS_DEBUG_PRINTF (DUMP, "start dumpscan €strange obid %s", obid);
     }
   RPS_ASSERT (rps_is_valid_object (ob));
-  bool absent = rps_hash_tbl_ob_add (du->du_visitedht, ob);
-  if (ob->ob_space)
-    (void) rps_hash_tbl_ob_add (du->du_spaceht, ob->ob_space);
-  /* If the object was already visited by the dumper, do nothing;
-     otherwise postpone the scan of object internal data (class,
-     attributes and their values, components, payload...) */
-  if (absent)
-    {
-      rps_payldeque_push_last (du->du_deque, ob);
-    }
-  if (absent)
-    RPS_DEBUG_PRINTF (DUMP, "scan new object %s", obid);
-  else
-    RPS_DEBUG_PRINTF (DUMP, "scan known object %s", obid);
+  /* The heap is scanned by rps_traverse_objects, which reaches the
+     references of objects thru rps_object_scan_references, so only
+     with a fake dumper. */
+  RPS_FATAL ("real dumper scanning object %s outside of a traversal", obid);
 }				/* end rps_dumper_scan_object */
 
+/* Tell if the previously dumped file FILNAM of some space, in the dump
+   directory, has the given Merkle hash in its prologue. */
+static bool
+rps_dumped_space_has_merkle (RpsDumper_t * du, const char *filnam,
+			     const char *merkle)
+{
+  RPS_ASSERT (rps_is_valid_dumper (du));
+  char pathbuf[256];
+  char linbuf[256];
+  char wantbuf[64];
+  memset (pathbuf, 0, sizeof (pathbuf));
+  memset (wantbuf, 0, sizeof (wantbuf));
+  snprintf (pathbuf, sizeof (pathbuf), "%s/%s",
+	    rps_stringv_utf8bytes ((RpsValue_t) du->du_dirnam), filnam);
+  snprintf (wantbuf, sizeof (wantbuf), "\"merkle\" : \"%s\"", merkle);
+  FILE *oldfil = fopen (pathbuf, "r");
+  if (!oldfil)
+    return false;
+  bool same = false;
+  /// the merkle is in the prologue, before the first object
+  while (memset (linbuf, 0, sizeof (linbuf)),
+	 fgets (linbuf, sizeof (linbuf), oldfil))
+    {
+      if (strstr (linbuf, wantbuf))
+	{
+	  same = true;
+	  break;
+	};
+      if (!strncmp (linbuf, "//+ob", 5))
+	break;
+    };
+  fclose (oldfil);
+  return same;
+}				/* end rps_dumped_space_has_merkle */
+
 void
 rps_dump_one_space (RpsDumper_t * du, int spix, const RpsObject_t * spacob,
 		    const RpsSetOb_t * universet)
@@ -342,6 +479,21 @@ rps_dump_one_space (RpsDumper_t * du, int spix, const RpsObject_t * spacob,
   const RpsSetOb_t *curspaceset =
     rps_hash_tbl_set_elements (du->du_htcurspace);
   unsigned spacesize = rps_set_cardinal (curspaceset);
+  /// an unchanged space, with the same Merkle hash in its previous
+  /// file, is not rewritten
+  char merklebuf[24];
+  memset (merklebuf, 0, sizeof (merklebuf));
+  snprintf (merklebuf, sizeof (merklebuf), "%016llx",
+	    (unsigned long long) rps_set_merkle_hash (curspaceset, true));
+  if (rps_dumped_space_has_merkle (du, filnambuf, merklebuf))
+    {
+      RPS_DEBUG_PRINTF (DUMP,
+			"dump-one-space spix#%d %s unchanged, merkle %s",
+			spix, spacid, merklebuf);
+      du->du_htcurspace = NULL;
+      du->du_i = old_dui;
+      return;
+    };
   FILE *spfil = du->du_spacedescr[spix].sp_file = fopen (tempathbuf, "w");
   if (!spfil)
     RPS_FATAL ("failed to open %s - %m", tempathbuf);
@@ -352,6 +504,7 @@ rps_dump_one_space (RpsDumper_t * du, int spix, const RpsObject_t * spacob,
   fprintf (spfil, "///!!! prologue of RefPerSys space file:\n");
   fprintf (spfil, "{\n");
   fprintf (spfil, " \"format\" : \"%s\",\n", RPS_MANIFEST_FORMAT);
+  fprintf (spfil, " \"merkle\" : \"%s\",\n", merklebuf);
   fprintf (spfil, " \"nbobjects\" : %u,\n", spacesize);
   fprintf (spfil, " \"spaceid\" : \"%s\"\n", spacid);
   fprintf (spfil, "}\n\n");
@@ -530,10 +683,7 @@ rps_dump_json_for_value (RpsDumper_t * du, RpsValue_t val, unsigned depth)
       }
       break;
     case RPS_TYPE_OBJECT:
-      {
-	json_t *jres =		//
-	  rps_dump_json_for_object (du, (RpsObject_t *) val);
-      }
+      jres = rps_dump_json_for_object (du, (RpsObject_t *) val);
       break;
     case RPS_TYPE_FILE:
       jres = json_null ();
@@ -746,6 +896,38 @@ rps_json_dump_writing_cb (const char *buffer, size_t size, void *data)
 }				/* end rps_json_dump_writing_cb */
 
 
+/* The visitor of the dumper traversal records every reached object,
+   and its space; the traversal is serial, so the dumper tables need no
+   lock. */
+static rps_traversal_visitor_sig_t rps_dumper_traversal_visitor;
+static enum rps_visit_en
+rps_dumper_traversal_visitor (RpsObject_t * ob, RpsObject_t * obfrom,
+			      unsigned depth, int workix, void *data)
+{
+  RpsDumper_t *du = data;
+  RPS_ASSERT (rps_is_valid_dumper (du));
+  RPS_ASSERT (rps_is_valid_object (ob));
+  RpsObject_t *obspace = NULL;
+  pthread_mutex_lock (&ob->ob_mtx);
+  obspace = ob->ob_space;
+  pthread_mutex_unlock (&ob->ob_mtx);
+  (void) rps_bitset_put_object (du->du_visitedbits, ob);
+  if (obspace)
+    {
+      RPS_ASSERT (rps_is_valid_object (obspace));
+      (void) rps_hash_tbl_ob_add (du->du_spaceht, obspace);
+    };
+  if (RPS_DEBUG_ENABLED (DUMP))
+    {
+      char oidbuf[32];
+      memset (oidbuf, 0, sizeof (oidbuf));
+      rps_oid_to_cbuf (ob->ob_id, oidbuf);
+      RPS_DEBUG_PRINTF (DUMP, "dump visit oid %s %s depth %u", oidbuf,
+			obspace ? "!" : "°", depth);
+    };
+  return RPS_VISIT_CONTINUE;
+}				/* end rps_dumper_traversal_visitor */
+
 #warning a lot of dumping routines are missing here
 void
 rps_dump_heap (rps_callframe_t * frame, const char *dirn)
@@ -780,12 +962,10 @@ rps_dump_heap (rps_callframe_t * frame, const char *dirn)
     fflush (NULL);
     free (realdirn);
   }
-  dumper->du_visitedht =	//
-    rps_hash_tbl_ob_create (16 + 3 * rps_nb_global_root_objects ());
+  dumper->du_visitedbits =	//
+    rps_bitset_create (0);
   dumper->du_spaceht =		//
     rps_hash_tbl_ob_create (3 + rps_nb_global_root_objects () / 5);
-  dumper->du_deque =		//
-    rps_deque_for_dumper (dumper);
 #warning temporary call to mallopt. Should be removed once loading and dumping completes.
   mallopt (M_CHECK_ACTION, 03);
   rps_dumper_set_state (dumper, rpsdumpstate_scanning);
@@ -808,35 +988,19 @@ rps_dump_heap (rps_callframe_t * frame, const char *dirn)
 			    (int) getpid ());
 	}
     };
-  /* scan the global objects */
-  rps_dumper_scan_value (dumper,
-			 (RpsValue_t) (rps_set_of_global_root_objects ()), 0);
-  RpsObject_t *curob = NULL;
-  long scancnt = 0;
   RPS_ASSERT (dumper->du_spaceht
 	      && rps_hash_tbl_is_valid (dumper->du_spaceht));
-  RPS_ASSERT (dumper->du_visitedht
-	      && rps_hash_tbl_is_valid (dumper->du_visitedht));
-  /* loop to scan visited, but unscanned objects */
-  while ((curob = rps_payldeque_pop_first (dumper->du_deque)) != NULL)
-    {
-      char oidbuf[32];
-      memset (oidbuf, 0, sizeof (oidbuf));
-      scancnt++;
-      rps_oid_to_cbuf (curob->ob_id, oidbuf);
-      RPS_DEBUG_PRINTF (DUMP, "dump scan internal#%ld oid %s %s remaining %d",
-			scancnt, oidbuf,
-			curob->ob_space ? "!" : "°",
-			rps_payldeque_length (dumper->du_deque));
-      rps_dumper_scan_internal_object (dumper, curob);
-      if (scancnt % 16 == 0)
-	{
-	  RPS_ASSERT (rps_hash_tbl_ob_cardinal (dumper->du_spaceht) > 0);
-	  RPS_ASSERT (rps_hash_tbl_ob_cardinal (dumper->du_visitedht) > 0);
-	}
-    };				/* end while du_deque not empty */
+  RPS_ASSERT (dumper->du_visitedbits
+	      && rps_bitset_is_valid (dumper->du_visitedbits));
+  /* scan the objects reachable from the global ones */
+  unsigned long scancnt =
+    rps_traverse_objects (rps_set_of_global_root_objects (),
+			  RPS_TRAVERSE_BFS, RPS_VISITED_BITSET,
+			  rps_dumper_traversal_visitor, NULL, dumper, 1);
+  RPS_DEBUG_PRINTF (DUMP, "dump scanned %lu objects", scancnt);
   const RpsSetOb_t *universet =
-    rps_hash_tbl_set_elements (dumper->du_visitedht);
+    rps_bitset_set_of_objects (dumper->du_visitedbits);
+  rps_bitset_destroy (dumper->du_visitedbits), dumper->du_visitedbits = NULL;
   const RpsSetOb_t *spaceset =	//
     rps_hash_tbl_set_elements (dumper->du_spaceht);
   unsigned nbspace = rps_set_cardinal (spaceset);
@@ -0,0 +1,423 @@
+/****************************************************************
+ * file epoch_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the quiescent state based memory reclamation,
+ *      for data replaced and read without locks.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "Refpersys.h"
+
+/****************************************************************
+ * Quiescent state based reclamation (QSBR).
+ *
+ * Some data, e.g. caches or tables replaced by a newer copy, is read
+ * by several threads without any lock.  The old copy cannot be freed
+ * at once, since some reader could still use it.  So it is retired
+ * with rps_epoch_retire, tagged by a new value of a global epoch.
+ *
+ * Every registered thread periodically announces a quiescent state,
+ * where it holds no pointer to such lock-free data, by calling
+ * rps_epoch_quiescent, e.g. at each loop of rps_thread_routine.  It
+ * then records the current global epoch.  Retired memory is freed
+ * once every online thread has recorded an epoch at least equal to
+ * its tag.  A thread going to block for a long time (e.g. on some
+ * condition variable) goes offline, and is then ignored.
+ *
+ * Every thread which may read such data must be registered: the main
+ * thread (also running the GTK loop), the agenda threads, and the
+ * threads of rps_parallel_for_each_object and
+ * rps_parallel_for_each_index.
+ ****************************************************************/
+
+#define RPS_EPOCH_MAX_THREADS (RPS_MAX_NB_THREADS + 8)
+/* reclaim a thread's retired memory when it has that many entries */
+#define RPS_EPOCH_RECLAIM_THRESHOLD 64
+
+struct rps_epoch_limbo_st
+{
+  struct rps_epoch_limbo_st *elim_next;
+  void *elim_ptr;
+  rps_epoch_free_sig_t *elim_freerout;
+  unsigned long elim_epoch;
+};
+
+struct rps_epoch_thread_st
+{
+  atomic_bool eth_used;
+  /* the last epoch seen in a quiescent state, 0 when offline */
+  atomic_ulong eth_seen;
+  /* retired memory, only handled by the owning thread */
+  struct rps_epoch_limbo_st *eth_limbo;
+  unsigned eth_nblimbo;
+};
+
+static struct rps_epoch_thread_st rps_epoch_thrarr[RPS_EPOCH_MAX_THREADS];
+static atomic_ulong rps_epoch_global = 1;
+
+/* memory retired by unregistered threads, freed by anyone */
+static pthread_mutex_t rps_epoch_orphan_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct rps_epoch_limbo_st *rps_epoch_orphan_limbo;
+
+static _Thread_local int rps_epoch_thread_index = -1;
+
+/* register the current thread, return its slot index */
+int
+rps_epoch_register_thread (void)
+{
+  if (rps_epoch_thread_index >= 0)
+    return rps_epoch_thread_index;
+  for (int ix = 0; ix < RPS_EPOCH_MAX_THREADS; ix++)
+    {
+      bool expected = false;
+      if (atomic_compare_exchange_strong (&rps_epoch_thrarr[ix].eth_used,
+					  &expected, true))
+	{
+	  struct rps_epoch_thread_st *eth = rps_epoch_thrarr + ix;
+	  eth->eth_limbo = NULL;
+	  eth->eth_nblimbo = 0;
+	  atomic_store (&eth->eth_seen, atomic_load (&rps_epoch_global));
+	  rps_epoch_thread_index = ix;
+	  return ix;
+	}
+    };
+  RPS_FATAL ("too many threads (%d) registered for epoch reclamation",
+	     RPS_EPOCH_MAX_THREADS);
+}				/* end rps_epoch_register_thread */
+
+bool
+rps_epoch_is_registered (void)
+{
+  return rps_epoch_thread_index >= 0;
+}				/* end rps_epoch_is_registered */
+
+/* the smallest epoch seen by online threads */
+static unsigned long
+rps_epoch_min_seen (void)
+{
+  unsigned long minseen = atomic_load (&rps_epoch_global);
+  for (int ix = 0; ix < RPS_EPOCH_MAX_THREADS; ix++)
+    {
+      struct rps_epoch_thread_st *eth = rps_epoch_thrarr + ix;
+      if (!atomic_load (&eth->eth_used))
+	continue;
+      unsigned long seen = atomic_load (&eth->eth_seen);
+      if (seen > 0 && seen < minseen)
+	minseen = seen;
+    };
+  return minseen;
+}				/* end rps_epoch_min_seen */
+
+/* free the entries of a limbo list whose epoch is not above MINSEEN,
+   return the list of remaining ones and update *PNB */
+static struct rps_epoch_limbo_st *
+rps_epoch_free_limbo (struct rps_epoch_limbo_st *limbo,
+		      unsigned long minseen, unsigned *pnb)
+{
+  struct rps_epoch_limbo_st *kept = NULL;
+  struct rps_epoch_limbo_st *next = NULL;
+  unsigned nbkept = 0;
+  for (struct rps_epoch_limbo_st * cur = limbo; cur != NULL; cur = next)
+    {
+      next = cur->elim_next;
+      if (cur->elim_epoch <= minseen)
+	{
+	  if (cur->elim_freerout)
+	    (*cur->elim_freerout) (cur->elim_ptr);
+	  else
+	    free (cur->elim_ptr);
+	  free (cur);
+	}
+      else
+	{
+	  cur->elim_next = kept;
+	  kept = cur;
+	  nbkept++;
+	}
+    };
+  if (pnb)
+    *pnb = nbkept;
+  return kept;
+}				/* end rps_epoch_free_limbo */
+
+/* free whatever retired memory is safe to free */
+void
+rps_epoch_reclaim (void)
+{
+  unsigned long minseen = rps_epoch_min_seen ();
+  int thix = rps_epoch_thread_index;
+  if (thix >= 0)
+    {
+      struct rps_epoch_thread_st *eth = rps_epoch_thrarr + thix;
+      eth->eth_limbo =
+	rps_epoch_free_limbo (eth->eth_limbo, minseen, &eth->eth_nblimbo);
+    };
+  pthread_mutex_lock (&rps_epoch_orphan_mtx);
+  rps_epoch_orphan_limbo =
+    rps_epoch_free_limbo (rps_epoch_orphan_limbo, minseen, NULL);
+  pthread_mutex_unlock (&rps_epoch_orphan_mtx);
+}				/* end rps_epoch_reclaim */
+
+/* announce that the current thread holds no lock-free pointer */
+void
+rps_epoch_quiescent (void)
+{
+  if (rps_epoch_thread_index < 0)
+    rps_epoch_register_thread ();
+  struct rps_epoch_thread_st *eth = rps_epoch_thrarr + rps_epoch_thread_index;
+  atomic_store (&eth->eth_seen, atomic_load (&rps_epoch_global));
+  if (eth->eth_nblimbo >= RPS_EPOCH_RECLAIM_THRESHOLD)
+    rps_epoch_reclaim ();
+}				/* end rps_epoch_quiescent */
+
+/* the current thread will block or stay away from lock-free data */
+void
+rps_epoch_go_offline (void)
+{
+  if (rps_epoch_thread_index < 0)
+    return;
+  atomic_store (&rps_epoch_thrarr[rps_epoch_thread_index].eth_seen, 0);
+}				/* end rps_epoch_go_offline */
+
+void
+rps_epoch_go_online (void)
+{
+  if (rps_epoch_thread_index < 0)
+    rps_epoch_register_thread ();
+  else
+    atomic_store (&rps_epoch_thrarr[rps_epoch_thread_index].eth_seen,
+		  atomic_load (&rps_epoch_global));
+}				/* end rps_epoch_go_online */
+
+/* retire PTR, to be freed by FREEROUT (or free when NULL) once no
+   thread can still use it */
+void
+rps_epoch_retire (void *ptr, rps_epoch_free_sig_t * freerout)
+{
+  if (!ptr)
+    return;
+  struct rps_epoch_limbo_st *lim =
+    RPS_ALLOC_ZEROED (sizeof (struct rps_epoch_limbo_st));
+  lim->elim_ptr = ptr;
+  lim->elim_freerout = freerout;
+  /// readers that see this new epoch in a quiescent state have
+  /// dropped any reference to PTR
+  lim->elim_epoch = atomic_fetch_add (&rps_epoch_global, 1) + 1;
+  int thix = rps_epoch_thread_index;
+  if (thix >= 0)
+    {
+      struct rps_epoch_thread_st *eth = rps_epoch_thrarr + thix;
+      lim->elim_next = eth->eth_limbo;
+      eth->eth_limbo = lim;
+      eth->eth_nblimbo++;
+    }
+  else
+    {
+      pthread_mutex_lock (&rps_epoch_orphan_mtx);
+      lim->elim_next = rps_epoch_orphan_limbo;
+      rps_epoch_orphan_limbo = lim;
+      pthread_mutex_unlock (&rps_epoch_orphan_mtx);
+    }
+}				/* end rps_epoch_retire */
+
+/* unregister the current thread, giving away its retired memory */
+void
+rps_epoch_unregister_thread (void)
+{
+  int thix = rps_epoch_thread_index;
+  if (thix < 0)
+    return;
+  struct rps_epoch_thread_st *eth = rps_epoch_thrarr + thix;
+  atomic_store (&eth->eth_seen, 0);
+  rps_epoch_reclaim ();
+  if (eth->eth_limbo)
+    {
+      pthread_mutex_lock (&rps_epoch_orphan_mtx);
+      struct rps_epoch_limbo_st *last = eth->eth_limbo;
+      while (last->elim_next)
+	last = last->elim_next;
+      last->elim_next = rps_epoch_orphan_limbo;
+      rps_epoch_orphan_limbo = eth->eth_limbo;
+      pthread_mutex_unlock (&rps_epoch_orphan_mtx);
+    };
+  eth->eth_limbo = NULL;
+  eth->eth_nblimbo = 0;
+  rps_epoch_thread_index = -1;
+  atomic_store (&eth->eth_used, false);
+}				/* end rps_epoch_unregister_thread */
+
+/****************************************************************
+ * Stress check, run by the --epoch-stress program option.  Reader
+ * threads repeatedly scan a table published through an atomic
+ * pointer, checking its checksum, while the calling thread keeps
+ * replacing that table and retiring the old one.  A retired table is
+ * poisoned before being freed, so a table reclaimed while some reader
+ * still scans it is caught by the checksum.
+ ****************************************************************/
+
+#define RPS_EPOCH_STRESS_MAGIC 0x1b7c5e93	/*461135507 */
+
+struct rps_epoch_stress_table_st
+{
+  unsigned est_magic;		/* RPS_EPOCH_STRESS_MAGIC */
+  unsigned est_nb;
+  unsigned long est_sum;
+  unsigned long est_vals[];
+};
+
+static struct rps_epoch_stress_table_st *_Atomic rps_epoch_stress_current;
+static atomic_bool rps_epoch_stress_running;
+static atomic_ulong rps_epoch_stress_nbscans;
+static atomic_ulong rps_epoch_stress_nbfreed;
+
+static void
+rps_epoch_stress_free (void *ptr)
+{
+  struct rps_epoch_stress_table_st *tbl = ptr;
+  RPS_ASSERT (tbl->est_magic == RPS_EPOCH_STRESS_MAGIC);
+  memset (tbl, 0xdb, sizeof (struct rps_epoch_stress_table_st)
+	  + tbl->est_nb * sizeof (unsigned long));
+  free (tbl);
+  atomic_fetch_add (&rps_epoch_stress_nbfreed, 1);
+}				/* end rps_epoch_stress_free */
+
+static void *
+rps_epoch_stress_reader (void *ptr)
+{
+  int rdix = (int) (intptr_t) ptr;
+  char thname[16];
+  memset (thname, 0, sizeof (thname));
+  snprintf (thname, sizeof (thname), "rpsepochrd#%d", rdix);
+  pthread_setname_np (pthread_self (), thname);
+  rps_epoch_register_thread ();
+  unsigned long count = 0;
+  while (atomic_load (&rps_epoch_stress_running))
+    {
+      const struct rps_epoch_stress_table_st *tbl =
+	atomic_load (&rps_epoch_stress_current);
+      if (tbl->est_magic != RPS_EPOCH_STRESS_MAGIC)
+	RPS_FATAL ("epoch stress reader#%d saw a freed table", rdix);
+      unsigned long sum = 0;
+      unsigned nb = tbl->est_nb;
+      for (unsigned ix = 0; ix < nb; ix++)
+	{
+	  sum += tbl->est_vals[ix];
+	  /// sometimes let the writer run in the middle of a scan
+	  if (ix == nb / 2 && (count & 7) == 0)
+	    sched_yield ();
+	};
+      if (sum != tbl->est_sum || tbl->est_magic != RPS_EPOCH_STRESS_MAGIC)
+	RPS_FATAL ("epoch stress reader#%d saw a table freed while scanned",
+		   rdix);
+      atomic_fetch_add (&rps_epoch_stress_nbscans, 1);
+      rps_epoch_quiescent ();
+      /// also exercise threads going offline
+      if (++count % 256 == 0)
+	{
+	  rps_epoch_go_offline ();
+	  sched_yield ();
+	  rps_epoch_go_online ();
+	}
+    };
+  rps_epoch_unregister_thread ();
+  return NULL;
+}				/* end rps_epoch_stress_reader */
+
+static struct rps_epoch_stress_table_st *
+rps_epoch_stress_make_table (unsigned long round)
+{
+  unsigned nb = 8 + (unsigned) ((round * 2654435761UL) % 250);
+  struct rps_epoch_stress_table_st *tbl =
+    RPS_ALLOC_ZEROED (sizeof (struct rps_epoch_stress_table_st)
+		      + nb * sizeof (unsigned long));
+  tbl->est_nb = nb;
+  for (unsigned ix = 0; ix < nb; ix++)
+    {
+      tbl->est_vals[ix] = round * 31 + ix * 7 + 1;
+      tbl->est_sum += tbl->est_vals[ix];
+    };
+  tbl->est_magic = RPS_EPOCH_STRESS_MAGIC;
+  return tbl;
+}				/* end rps_epoch_stress_make_table */
+
+/* Run the stress check with NBREADERS reader threads during NBROUNDS
+   replacements, in a registered thread; fatal on failure. */
+void
+rps_epoch_stress_test (int nbreaders, unsigned long nbrounds)
+{
+  if (nbreaders < 2)
+    nbreaders = 2;
+  else if (nbreaders > RPS_MAX_NB_THREADS)
+    nbreaders = RPS_MAX_NB_THREADS;
+  rps_epoch_register_thread ();
+  double startim = rps_clocktime (CLOCK_MONOTONIC);
+  unsigned long oldfreed = atomic_load (&rps_epoch_stress_nbfreed);
+  atomic_store (&rps_epoch_stress_nbscans, 0);
+  atomic_store (&rps_epoch_stress_current,
+		rps_epoch_stress_make_table (0));
+  atomic_store (&rps_epoch_stress_running, true);
+  pthread_t thrarr[RPS_MAX_NB_THREADS];
+  memset (thrarr, 0, sizeof (thrarr));
+  for (int rdix = 0; rdix < nbreaders; rdix++)
+    {
+      int err = pthread_create (&thrarr[rdix], NULL, rps_epoch_stress_reader,
+				(void *) (intptr_t) rdix);
+      if (err)
+	RPS_FATAL ("failed to create epoch stress reader#%d: %s", rdix,
+		   strerror (err));
+    };
+  for (unsigned long round = 1; round <= nbrounds; round++)
+    {
+      struct rps_epoch_stress_table_st *oldtbl =
+	atomic_exchange (&rps_epoch_stress_current,
+			 rps_epoch_stress_make_table (round));
+      rps_epoch_retire (oldtbl, rps_epoch_stress_free);
+      rps_epoch_quiescent ();
+      /// reclaim eagerly, to free tables as soon as allowed
+      rps_epoch_reclaim ();
+    };
+  atomic_store (&rps_epoch_stress_running, false);
+  for (int rdix = 0; rdix < nbreaders; rdix++)
+    pthread_join (thrarr[rdix], NULL);
+  rps_epoch_retire (atomic_exchange (&rps_epoch_stress_current, NULL),
+		    rps_epoch_stress_free);
+  /// no reader remains, so every retired table can be freed
+  rps_epoch_quiescent ();
+  rps_epoch_reclaim ();
+  unsigned long nbfreed = atomic_load (&rps_epoch_stress_nbfreed) - oldfreed;
+  if (nbfreed != nbrounds + 1)
+    RPS_FATAL ("epoch stress freed %lu tables out of %lu retired",
+	       nbfreed, nbrounds + 1);
+  printf ("epoch stress check passed: %d readers, %lu replaced tables,"
+	  " %lu scans in %.3f seconds\n",
+	  nbreaders, nbrounds, atomic_load (&rps_epoch_stress_nbscans),
+	  rps_clocktime (CLOCK_MONOTONIC) - startim);
+  fflush (stdout);
+}				/* end rps_epoch_stress_test */
+
+/************************ end of file epoch_rps.c ******************/
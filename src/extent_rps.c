@@ -0,0 +1,312 @@
+/****************************************************************
+ * file extent_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the class extents, that is the sets of instances
+ *      of every class, maintained when objects get their class.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "Refpersys.h"
+
+/* Class extents are optional: they are built by a single scan of all
+   objects by their dense index when first needed, then maintained by
+   rps_class_extent_change at every class assignment.  The extent of a
+   class is a bit set of its direct instances, under its own mutex,
+   which is taken with the object lock held but never the reverse.
+   Instances of subclasses are found by the union of the extents of
+   every subclass.  Extents are found in an insert only open-addressed
+   table read without locking, like selector numbers in selector_rps.c,
+   and are never freed; a replaced table is retired. */
+
+struct rps_classextent_st
+{
+  RpsObject_t *ce_class;
+  pthread_mutex_t ce_mtx;
+  RpsBitSet_t *ce_bits;		/* direct instances */
+};
+
+struct rps_extent_table_st
+{
+  unsigned ext_size;		/* a prime */
+  struct rps_classextent_st *_Atomic ext_arr[];
+};
+
+enum rps_extent_state_en
+{
+  RPS_EXTENT_OFF,
+  RPS_EXTENT_BUILDING,
+  RPS_EXTENT_READY,
+};
+
+static atomic_int rps_extent_state;
+/// serializes the initial build, and protects rps_extent_allarr
+static pthread_mutex_t rps_extent_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t rps_extent_enable_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct rps_extent_table_st *_Atomic rps_extent_table;
+static struct rps_classextent_st **rps_extent_allarr;
+static unsigned rps_extent_nball, rps_extent_sizeall;
+
+static struct rps_classextent_st *
+rps_extent_find (struct rps_extent_table_st *tbl, const RpsObject_t * obcla)
+{
+  if (!tbl)
+    return NULL;
+  unsigned tsiz = tbl->ext_size;
+  unsigned ix = obcla->zv_hash % tsiz;
+  for (unsigned cnt = 0; cnt < tsiz; cnt++)
+    {
+      struct rps_classextent_st *ext = atomic_load (&tbl->ext_arr[ix]);
+      if (!ext || ext->ce_class == obcla)
+	return ext;
+      if (++ix >= tsiz)
+	ix = 0;
+    };
+  return NULL;
+}				/* end rps_extent_find */
+
+/// find the extent of a class, without locking in threads registered
+/// for reclamation, see epoch_rps.c
+static struct rps_classextent_st *
+rps_extent_lookup (const RpsObject_t * obcla)
+{
+  if (rps_epoch_is_registered ())
+    return rps_extent_find (atomic_load (&rps_extent_table), obcla);
+  pthread_mutex_lock (&rps_extent_mtx);
+  struct rps_classextent_st *ext =
+    rps_extent_find (atomic_load (&rps_extent_table), obcla);
+  pthread_mutex_unlock (&rps_extent_mtx);
+  return ext;
+}				/* end rps_extent_lookup */
+
+static void
+rps_extent_insert (struct rps_extent_table_st *tbl,
+		   struct rps_classextent_st *ext)
+{
+  unsigned tsiz = tbl->ext_size;
+  unsigned ix = ext->ce_class->zv_hash % tsiz;
+  while (atomic_load (&tbl->ext_arr[ix]) != NULL)
+    if (++ix >= tsiz)
+      ix = 0;
+  atomic_store (&tbl->ext_arr[ix], ext);
+}				/* end rps_extent_insert */
+
+/// find or make the extent of a class; OBCLA is not locked by it
+static struct rps_classextent_st *
+rps_extent_of_class (RpsObject_t * obcla)
+{
+  struct rps_classextent_st *ext = rps_extent_lookup (obcla);
+  if (ext)
+    return ext;
+  pthread_mutex_lock (&rps_extent_mtx);
+  struct rps_extent_table_st *tbl = atomic_load (&rps_extent_table);
+  ext = rps_extent_find (tbl, obcla);
+  if (ext)
+    goto end;
+  if (!tbl || 3 * (rps_extent_nball + 1) > 2 * tbl->ext_size)
+    {
+      unsigned newsiz = (unsigned) rps_prime_above (2 * rps_extent_nball
+						    + 50);
+      struct rps_extent_table_st *newtbl =
+	RPS_ALLOC_ZEROED (sizeof (struct rps_extent_table_st)
+			  + newsiz * sizeof (struct rps_classextent_st *));
+      newtbl->ext_size = newsiz;
+      for (unsigned ix = 0; ix < rps_extent_nball; ix++)
+	rps_extent_insert (newtbl, rps_extent_allarr[ix]);
+      atomic_store (&rps_extent_table, newtbl);
+      rps_epoch_retire (tbl, NULL);
+      tbl = newtbl;
+    };
+  if (rps_extent_nball >= rps_extent_sizeall)
+    {
+      unsigned newsizeall =
+	(unsigned) rps_prime_above (rps_extent_nball + rps_extent_nball / 2
+				    + 20);
+      struct rps_classextent_st **newallarr =
+	RPS_ALLOC_ZEROED (newsizeall * sizeof (struct rps_classextent_st *));
+      if (rps_extent_nball > 0)
+	memcpy (newallarr, rps_extent_allarr,
+		rps_extent_nball * sizeof (struct rps_classextent_st *));
+      free (rps_extent_allarr);
+      rps_extent_allarr = newallarr;
+      rps_extent_sizeall = newsizeall;
+    };
+  ext = RPS_ALLOC_ZEROED (sizeof (struct rps_classextent_st));
+  ext->ce_class = obcla;
+  pthread_mutex_init (&ext->ce_mtx, NULL);
+  ext->ce_bits = rps_bitset_create (0);
+  rps_extent_allarr[rps_extent_nball++] = ext;
+  rps_extent_insert (tbl, ext);
+end:
+  pthread_mutex_unlock (&rps_extent_mtx);
+  return ext;
+}				/* end rps_extent_of_class */
+
+void
+rps_class_extent_change (RpsObject_t * ob, RpsObject_t * oldcla,
+			 RpsObject_t * newcla)
+{
+  if (oldcla == newcla || !ob)
+    return;
+  if (atomic_load (&rps_extent_state) == RPS_EXTENT_OFF)
+    return;
+  if (oldcla)
+    {
+      struct rps_classextent_st *oldext = rps_extent_lookup (oldcla);
+      if (oldext)
+	{
+	  pthread_mutex_lock (&oldext->ce_mtx);
+	  rps_bitset_remove_object (oldext->ce_bits, ob);
+	  pthread_mutex_unlock (&oldext->ce_mtx);
+	}
+    };
+  if (newcla)
+    {
+      struct rps_classextent_st *newext = rps_extent_of_class (newcla);
+      pthread_mutex_lock (&newext->ce_mtx);
+      rps_bitset_put_object (newext->ce_bits, ob);
+      pthread_mutex_unlock (&newext->ce_mtx);
+    }
+}				/* end rps_class_extent_change */
+
+bool
+rps_class_extents_enabled (void)
+{
+  return atomic_load (&rps_extent_state) == RPS_EXTENT_READY;
+}				/* end rps_class_extents_enabled */
+
+void
+rps_enable_class_extents (void)
+{
+  if (atomic_load (&rps_extent_state) == RPS_EXTENT_READY)
+    return;
+  pthread_mutex_lock (&rps_extent_enable_mtx);
+  if (atomic_load (&rps_extent_state) == RPS_EXTENT_OFF)
+    {
+      /* From now on every class change is recorded.  Each object is
+         scanned under its lock, so a concurrent change of its class is
+         seen either by this scan or by rps_class_extent_change. */
+      atomic_store (&rps_extent_state, RPS_EXTENT_BUILDING);
+      uint32_t bound = rps_object_index_bound ();
+      for (uint32_t ix = 1; ix < bound; ix++)
+	{
+	  RpsObject_t *ob = rps_object_of_index (ix);
+	  if (!ob)
+	    continue;
+	  pthread_mutex_lock (&ob->ob_mtx);
+	  if (ob->ob_class)
+	    {
+	      struct rps_classextent_st *ext =
+		rps_extent_of_class (ob->ob_class);
+	      pthread_mutex_lock (&ext->ce_mtx);
+	      rps_bitset_put_object (ext->ce_bits, ob);
+	      pthread_mutex_unlock (&ext->ce_mtx);
+	    };
+	  pthread_mutex_unlock (&ob->ob_mtx);
+	};
+      atomic_store (&rps_extent_state, RPS_EXTENT_READY);
+    };
+  pthread_mutex_unlock (&rps_extent_enable_mtx);
+}				/* end rps_enable_class_extents */
+
+/* Compute into a fresh bit set the instances of OBCLA, with those of
+   its subclasses if WITHSUB.  No object is locked meanwhile. */
+static RpsBitSet_t *
+rps_extent_instances_bitset (RpsObject_t * obcla, bool withsub)
+{
+  rps_enable_class_extents ();
+  RpsBitSet_t *bs = rps_bitset_create (0);
+  struct rps_classextent_st **extarr = NULL;
+  unsigned nbext = 0;
+  if (withsub)
+    {
+      pthread_mutex_lock (&rps_extent_mtx);
+      nbext = rps_extent_nball;
+      extarr =
+	RPS_ALLOC_ZEROED ((nbext + 1) * sizeof (struct rps_classextent_st *));
+      if (nbext > 0)
+	memcpy (extarr, rps_extent_allarr,
+		nbext * sizeof (struct rps_classextent_st *));
+      pthread_mutex_unlock (&rps_extent_mtx);
+    }
+  else
+    {
+      struct rps_classextent_st *ext = rps_extent_lookup (obcla);
+      if (!ext)
+	return bs;
+      extarr = RPS_ALLOC_ZEROED (2 * sizeof (struct rps_classextent_st *));
+      extarr[nbext++] = ext;
+    };
+  for (unsigned eix = 0; eix < nbext; eix++)
+    {
+      struct rps_classextent_st *ext = extarr[eix];
+      if (withsub && !rps_is_subclass (ext->ce_class, obcla))
+	continue;
+      pthread_mutex_lock (&ext->ce_mtx);
+      rps_bitset_union_with (bs, ext->ce_bits);
+      pthread_mutex_unlock (&ext->ce_mtx);
+    };
+  free (extarr);
+  return bs;
+}				/* end rps_extent_instances_bitset */
+
+unsigned long
+rps_obclass_count_instances (RpsObject_t * obcla, bool withsub)
+{
+  if (!obcla || !rps_is_valid_object (obcla))
+    return 0;
+  RpsBitSet_t *bs = rps_extent_instances_bitset (obcla, withsub);
+  unsigned long cnt = rps_bitset_popcount (bs);
+  rps_bitset_destroy (bs);
+  return cnt;
+}				/* end rps_obclass_count_instances */
+
+unsigned long
+rps_obclass_iterate_instances (RpsObject_t * obcla, bool withsub,
+			       rps_object_callback_sig_t * rout, void *data)
+{
+  if (!obcla || !rout || !rps_is_valid_object (obcla))
+    return 0;
+  RpsBitSet_t *bs = rps_extent_instances_bitset (obcla, withsub);
+  unsigned long cnt = rps_bitset_iterate_objects (bs, rout, data);
+  rps_bitset_destroy (bs);
+  return cnt;
+}				/* end rps_obclass_iterate_instances */
+
+const RpsSetOb_t *
+rps_obclass_set_of_instances (RpsObject_t * obcla, bool withsub)
+{
+  if (!obcla || !rps_is_valid_object (obcla))
+    return NULL;
+  RpsBitSet_t *bs = rps_extent_instances_bitset (obcla, withsub);
+  const RpsSetOb_t *set = rps_bitset_set_of_objects (bs);
+  rps_bitset_destroy (bs);
+  return set;
+}				/* end rps_obclass_set_of_instances */
+
+/****** end of file extent_rps.c ******/
@@ -85,11 +85,22 @@ rpsgui_finalize (void)
 {
 }				/* end rpsgui_finalize */
 
+/* The GTK main loop runs in the main thread, which is registered for
+   memory reclamation, so it should periodically be quiescent; see
+   epoch_rps.c */
+static gboolean
+rpsgui_epoch_quiescent_cb (gpointer data)
+{
+  rps_epoch_quiescent ();
+  return G_SOURCE_CONTINUE;
+}				/* end rpsgui_epoch_quiescent_cb */
+
 void
 rps_run_gui (int *pargc, char **argv)
 {
   gtk_init (pargc, &argv);
   rpsgui_initialize ();
+  g_timeout_add (100, rpsgui_epoch_quiescent_cb, NULL);
   gtk_main ();
   rpsgui_finalize ();
 }				/* end rps_run_gui */
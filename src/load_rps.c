@@ -193,19 +193,28 @@ rps_load_parse_manifest (RpsLoader_t * ld)
       ld->ld_nbglobroot = 0;
       ld->ld_globrootarr = RPS_ALLOC_ZEROED (nbgr * sizeof (RpsObject_t *));
       rps_initialize_objects_for_loading (ld, totnbob);
+      /// the global roots are created in bulk, each bucket being
+      /// locked once
+      RpsOid *rootoidarr = RPS_ALLOC_ZEROED (nbgr * sizeof (RpsOid));
       for (int gix = 0; gix < (int) nbgr; gix++)
 	{
-	  RpsObject_t *curoot = NULL;
 	  json_t *curjs = json_array_get (jsglobroot, gix);
-	  if (json_is_string (curjs))
-	    {
-	      curoot = rps_load_create_object_from_json_id (ld, curjs);
-	      ld->ld_globrootarr[ld->ld_nbglobroot++] = curoot;
-	    }
-	  else
+	  if (!json_is_string (curjs))
 	    RPS_FATAL ("bad JSON for global #%d", gix);
-	  RPS_ASSERT (curoot);
+	  rootoidarr[gix] = rps_cstr_to_oid (json_string_value (curjs), NULL);
+	  if (!rps_oid_is_valid (rootoidarr[gix]))
+	    RPS_FATAL ("bad oid %s for global #%d",
+		       json_string_value (curjs), gix);
 	};
+      /// their mtime is set when filling them
+      rps_mtime_index_suspend ();
+      rps_bulk_create_objects_by_oid (NULL, nbgr, rootoidarr,
+				      ld->ld_globrootarr);
+      rps_mtime_index_resume ();
+      free (rootoidarr);
+      for (int gix = 0; gix < (int) nbgr; gix++)
+	RPS_ASSERT (ld->ld_globrootarr[gix]);
+      ld->ld_nbglobroot = nbgr;
       /// now that the infant root objects are created, we can assign
       /// them to global C variables:
 #define RPS_INSTALL_ROOT_OB(Oid) do {                           \
@@ -232,8 +241,8 @@ rps_load_parse_manifest (RpsLoader_t * ld)
         if (!RPS_ROOT_OB(Oid))                                  \
             RPS_FATAL("failed to install root object %s",       \
                       #Oid);                                    \
-         RPS_ROOT_OB(Oid)->ob_class =                           \
-           RPS_ROOT_OB(_5yhJGgxLwLp00X0xEQ); /*object∈class*/   \
+         rps_locked_object_put_class (RPS_ROOT_OB(Oid),         \
+           RPS_ROOT_OB(_5yhJGgxLwLp00X0xEQ)); /*object∈class*/  \
             } while (0);
 #include "generated/rps-roots.h"
   ///
@@ -430,6 +439,10 @@ rps_load_first_pass (RpsLoader_t * ld, int spix, RpsOid spaceid)
    *  loop and search for start of objects JSON....
    *****************/
   long objcount = 0;
+  /// the oids of the objects, then of their classes, are collected to
+  /// create all of them in bulk at end, each bucket being locked once
+  RpsOid *oidarr = RPS_ALLOC_ZEROED ((2 * nbobjects + 1) * sizeof (RpsOid));
+  RpsOid *classoidarr = oidarr + nbobjects;
   while (objcount < nbobjects)
     {
 
@@ -509,28 +522,15 @@ rps_load_first_pass (RpsLoader_t * ld, int spix, RpsOid spaceid)
 		 objcount, spix, filepath, startlin,
 		 json_string_value (jsoid), obidbuf);
 	    json_t *jsclass = json_object_get (jsobject, "class");
-	    RpsObject_t *obclass = NULL;
+	    oidarr[objcount] = curobid;
+	    /// an invalid class oid gives no class object, so `object`
 	    if (json_is_string (jsclass))
-	      obclass = rps_load_create_object_from_json_id (ld, jsclass);
-	    if (!obclass)
-	      obclass = RPS_ROOT_OB (_5yhJGgxLwLp00X0xEQ);	//object∈class
+	      classoidarr[objcount] =
+		rps_cstr_to_oid (json_string_value (jsclass), NULL);
 	    objcount++;
-	    RpsObject_t *curob =
-	      rps_load_create_object_from_json_id (ld, jsoid);
-	    RPS_DEBUG_PRINTF (LOAD, "load-created object#%ld curob %s",
+	    RPS_DEBUG_PRINTF (LOAD, "load-scanned object#%ld %s",
 			      objcount, obidbuf);
-	    if (curob && obclass)
-	      curob->ob_class = obclass;
-	    // for object _9Gz1oNPCnkB00I6VRS; in commit 4fbdb7e1ca7d7bda it is losing its class...
-	    if (obidbuf[1] == '9' && obidbuf[2] == 'G' && obidbuf[3] == 'z')
-	      {
-		RPS_DEBUG_PRINTF (LOAD,
-				  "**bug in commit 4fbdb7e1c for obidbuf %s curob@%p id/hi=%lld,lo=%lld",
-				  obidbuf, curob,
-				  curob->ob_id.id_hi, curob->ob_id.id_lo);
-		usleep (1000);
-	      }
-	    /// the other fields of curob are set later... in the second pass
+	    /// the other fields of the object are set later... in the second pass
 	    json_decref (jsobject);
 	    fclose (obstream);
 	    free (bufjs), bufjs = NULL;
@@ -540,6 +540,24 @@ rps_load_first_pass (RpsLoader_t * ld, int spix, RpsOid spaceid)
 	  RPS_FATAL ("in %s:%d invalid oid %s", filepath, lincnt, obidbuf);
       }
     }
+  /// their mtime is set when filling them
+  RpsObject_t **obarr =
+    RPS_ALLOC_ZEROED ((2 * objcount + 1) * sizeof (RpsObject_t *));
+  memmove (oidarr + objcount, classoidarr, objcount * sizeof (RpsOid));
+  rps_mtime_index_suspend ();
+  rps_bulk_create_objects_by_oid (NULL, 2 * objcount, oidarr, obarr);
+  rps_mtime_index_resume ();
+  for (long oix = 0; oix < objcount; oix++)
+    {
+      RpsObject_t *curob = obarr[oix];
+      RpsObject_t *obclass = obarr[objcount + oix];
+      RPS_ASSERT (curob != NULL);
+      if (!obclass)
+	obclass = RPS_ROOT_OB (_5yhJGgxLwLp00X0xEQ);	//object∈class
+      rps_locked_object_put_class (curob, obclass);
+    };
+  free (obarr);
+  free (oidarr);
   printf ("rps_load_first_pass created %ld objects at %s:%d (%s:%d)\n",
 	  objcount, filepath, lincnt, __FILE__, __LINE__);
   fclose (spfil);
@@ -739,7 +757,10 @@ rps_loader_fill_object_second_pass (RpsLoader_t * ld, int spix,
   rps_oid_to_cbuf (obj->ob_id, obidbuf);
   RPS_DEBUG_NLPRINTF (LOAD, "start load&fill object %s @%p", obidbuf,
 		      (void *) obj);
+  double loadedmtime = 0.0;
   pthread_mutex_lock (&obj->ob_mtx);
+  /// only the dumped mtime goes into the modification time index
+  rps_mtime_index_suspend ();
   /// set the object class
   {
     json_t *jsclass = json_object_get (jsobj, "class");
@@ -747,7 +768,7 @@ rps_loader_fill_object_second_pass (RpsLoader_t * ld, int spix,
     RpsOid classoid = rps_cstr_to_oid (json_string_value (jsclass), NULL);
     RpsObject_t *classob = rps_find_object_by_oid (classoid);
     RPS_ASSERT (classob != NULL);
-    obj->ob_class = classob;
+    rps_locked_object_put_class (obj, classob);
   }
   /// set the object mtime and space
   {
@@ -755,6 +776,7 @@ rps_loader_fill_object_second_pass (RpsLoader_t * ld, int spix,
     RPS_ASSERT (json_is_real (jsmtime));
     double mtime = json_real_value (jsmtime);
     RPS_ASSERT (mtime > 0.0 && mtime < 1e12);
+    loadedmtime = mtime;
     obj->ob_mtime = mtime;
     obj->ob_space = obspac;
   }
@@ -764,8 +786,10 @@ rps_loader_fill_object_second_pass (RpsLoader_t * ld, int spix,
     if (json_is_array (jsattrarr))
       {
 	int nbattr = json_array_size (jsattrarr);
-	obj->ob_attrtable =
-	  rps_alloc_empty_attr_table (nbattr + nbattr / 4 + 1);
+	RpsObject_t **atobarr =
+	  RPS_ALLOC_ZEROED ((nbattr + 1) * sizeof (RpsObject_t *));
+	RpsValue_t *atvalarr =
+	  RPS_ALLOC_ZEROED ((nbattr + 1) * sizeof (RpsValue_t));
 	for (int aix = 0; aix < nbattr; aix++)
 	  {
 	    json_t *jscurattr = json_array_get (jsattrarr, aix);
@@ -780,9 +804,13 @@ rps_loader_fill_object_second_pass (RpsLoader_t * ld, int spix,
 	    RpsObject_t *atob = rps_find_object_by_oid (atoid);
 	    RPS_ASSERT (atob != NULL);
 	    RpsValue_t atval = rps_loader_json_to_value (ld, jsva);
-	    obj->ob_attrtable =
-	      rps_attr_table_put (obj->ob_attrtable, atob, atval);
+	    atobarr[aix] = atob;
+	    atvalarr[aix] = atval;
 	  }
+	/// the object is already locked, put all attributes at once
+	rps_locked_object_put_attributes (obj, nbattr, atobarr, atvalarr);
+	free (atobarr);
+	free (atvalarr);
       }
   }
   /// load the object components
@@ -811,18 +839,19 @@ rps_loader_fill_object_second_pass (RpsLoader_t * ld, int spix,
     json_t *jspayload = json_object_get (jsobj, "payload");
     if (json_is_string (jspayload))
       {
-	char paylroutname[80];
-	memset (paylroutname, 0, sizeof (paylroutname));
-	snprintf (paylroutname, sizeof (paylroutname),
-		  RPS_PAYLOADING_PREFIX "%s", json_string_value (jspayload));
-	void *routad = dlsym (rps_dlhandle, paylroutname);
-	if (!routad)
-	  RPS_FATAL ("failed dlsym %s: %s - for loading payload of object %s in space#%d\n... json %s", paylroutname, dlerror (), obidbuf, spix,	//
+	/// resolved once per payload name, not once per object
+	rpsldpysig_t *payloader =
+	  rps_payload_loader_of_name (json_string_value (jspayload));
+	if (!payloader)
+	  RPS_FATAL ("failed dlsym " RPS_PAYLOADING_PREFIX "%s: %s - for loading payload of object %s in space#%d\n... json %s", json_string_value (jspayload), dlerror (), obidbuf, spix,	//
 		     json_dumps (jsobj, JSON_INDENT (2) | JSON_SORT_KEYS));
-	rpsldpysig_t *payloader = (rpsldpysig_t *) routad;
 	(*payloader) (obj, ld, jsobj, spix);
       }
   }
+  /// filling the object touched it, so restore its dumped mtime
+  rps_mtime_index_resume ();
+  obj->ob_mtime = loadedmtime;
+  rps_mtime_index_note (obj, loadedmtime);
   pthread_mutex_unlock (&obj->ob_mtx);
   ld->ld_totalobjectnb++;
   RPS_DEBUG_PRINTF (LOAD, "done load&fill object#%ld %s space#%d\n",
@@ -42,6 +42,7 @@ bool rps_showing_version;
 bool rps_showing_types;
 bool rps_showing_debug_help;
 bool rps_with_gui;
+bool rps_building_trigram_index;
 
 /* The following terminal globals are declared in include/terminal_rps.h */
 bool rps_terminal_is_escaped;
@@ -60,6 +61,7 @@ const char *rps_shell_before_load;
 
 int rps_nb_threads;
 int rps_randomize_va_space = -99;
+int rps_epoch_stress_rounds;
 
 GOptionEntry rps_gopt_entries[] = {
   {"load-directory", 'L', 0, G_OPTION_ARG_FILENAME, &rps_load_directory,
@@ -84,6 +86,11 @@ GOptionEntry rps_gopt_entries[] = {
    "show possible debug levels", NULL},
   {"gui", 'G', 0, G_OPTION_ARG_NONE, &rps_with_gui,
    "start a graphical interface with GTK", NULL},
+  {"trigram-index", 0, 0, G_OPTION_ARG_NONE, &rps_building_trigram_index,
+   "build the trigram index of strings after load", NULL},
+  {"epoch-stress", 0, 0, G_OPTION_ARG_INT, &rps_epoch_stress_rounds,
+   "stress check memory reclamation with NBROUNDS replacements and exit",
+   "NBROUNDS"},
   {NULL}
 };
 
@@ -953,12 +960,8 @@ rps_verify_object_and_payload (RpsObject_t * ob)
   pthread_mutex_lock (&ob->ob_mtx);
   for (int ix = 0; ix < (int) ob->ob_nbcomp; ix++)
     rps_verify_value (ob->ob_comparr[ix], 1);
-  if (ob->ob_attrtable)
-    {
-      rps_attr_table_iterate (ob->ob_attrtable,
-			      rps_object_attribute_verifier,
-			      rps_object_value_verifier, ob);
-    }
+  rps_locked_object_iterate_attributes (ob, rps_object_attribute_verifier,
+					rps_object_value_verifier, ob);
   if (ob->ob_payload)
     {
       extern void		// in object_rps.c
@@ -1313,6 +1316,8 @@ main (int argc, char **argv)
       exit (EXIT_FAILURE);
     };
   rps_allocation_initialize ();
+  /// the main thread reads lock-free data, see epoch_rps.c
+  rps_epoch_register_thread ();
   curl_global_init (CURL_GLOBAL_ALL);
   GError *argperr = NULL;
   /* CAVEAT: we need a valid $DISPLAY, even when running in --batch
@@ -1346,6 +1351,12 @@ main (int argc, char **argv)
     {
       rps_show_types_info ();
     };
+  if (rps_epoch_stress_rounds > 0)
+    {
+      rps_epoch_stress_test (rps_nb_threads > 0 ? rps_nb_threads : 4,
+			     (unsigned long) rps_epoch_stress_rounds);
+      exit (EXIT_SUCCESS);
+    };
   if (rps_nb_threads > 0)
     {
       if (rps_nb_threads < RPS_MIN_NB_THREADS)
@@ -1363,6 +1374,8 @@ main (int argc, char **argv)
   rps_register_payload_dump_serializer (RpsPyt_ClassInfo,
 					rps_classinfo_payload_dump_serializer,
 					NULL);
+  rps_register_payload_loader (RpsPyt_ClassInfo, "classinfo",
+			       rpsldpy_classinfo);
 #warning missing registration of classinfo payload verifier (for rps_register_payload_verifier)
   /// support for symbol payload
   rps_register_payload_removal (RpsPyt_Symbol,
@@ -1372,6 +1385,7 @@ main (int argc, char **argv)
   rps_register_payload_dump_serializer (RpsPyt_Symbol,
 					rps_symbol_payload_dump_serializer,
 					NULL);
+  rps_register_payload_loader (RpsPyt_Symbol, "symbol", rpsldpy_symbol);
 #warning missing registration of symbol payload verifier (for rps_register_payload_verifier)
   /// support for agenda payload
   rps_register_payload_removal (RpsPyt_Agenda,
@@ -1381,6 +1395,7 @@ main (int argc, char **argv)
   rps_register_payload_dump_serializer (RpsPyt_Agenda,
 					rps_agenda_payload_dump_serializer,
 					NULL);
+  rps_register_payload_loader (RpsPyt_Agenda, "agenda", rpsldpy_agenda);
 #warning missing registration of agenda payload verifier (for rps_register_payload_verifier)
   /// support for mutable setob payload
   rps_register_payload_removal (RpsPyt_MutableSetOb,
@@ -1390,6 +1405,7 @@ main (int argc, char **argv)
   rps_register_payload_dump_serializer (RpsPyt_MutableSetOb,
 					rps_setob_payload_dump_serializer,
 					NULL);
+  rps_register_payload_loader (RpsPyt_MutableSetOb, "setob", rpsldpy_setob);
 #warning missing registration of mutable setob payload verifier (for rps_register_payload_verifier)
   /// support for string dictionary payload
   rps_register_payload_removal (RpsPyt_StringDict,
@@ -1400,9 +1416,14 @@ main (int argc, char **argv)
   rps_register_payload_dump_serializer (RpsPyt_StringDict,
 					rps_stringdict_payload_dump_serializer,
 					NULL);
+  rps_register_payload_loader (RpsPyt_StringDict, "string_dictionary",
+			       rpsldpy_string_dictionary);
+  /// support for space payload
+  rps_register_payload_loader (RpsPyt_Space, "space", rpsldpy_space);
 #warning missing registration of string payload verifier (for rps_register_payload_verifier)
   ////
 #warning other payload routines should be registered here, including verification routines
+  rps_freeze_payload_registry ();
   rps_check_all_objects_buckets_are_valid ();
   if (!rps_load_directory)
     rps_load_directory = rps_topdirectory;
@@ -1439,6 +1460,9 @@ main (int argc, char **argv)
       printf ("setting debug after load to %s\n", rps_debug_str_after);
       rps_set_debug (rps_debug_str_after);
     }
+  if (rps_building_trigram_index)
+    rps_build_trigram_index (rps_nb_threads);
+  rps_epoch_quiescent ();
   if (rps_nb_threads > 0) {
     printf("%s git %s running agenda with %d threads pid %d on %s\n",
 	   argv[0], _rps_git_short_id, rps_nb_threads,
@@ -1460,14 +1484,14 @@ main (int argc, char **argv)
 
 
 //// This function computes the closure to send a given method (by its
-//// selector SELOB) to some non-nil value VAL.  It is inefficient, and
-//// should be replaced by better generated C code.
+//// selector SELOB) to some non-nil value VAL.  The global method
+//// cache is looked up first, then the flattened method table of the
+//// class, see selector_rps.c.
 RpsClosure_t *
 rps_value_compute_method_closure (RpsValue_t val, const RpsObject_t * selob)
 {
   RpsClosure_t *closres = NULL;
   char smallbuf[32];
-  RpsOid clasid = { 0, 0 };
   RpsObject_t *clasob = NULL;
   const char *clidstr = NULL;
   if (val == RPS_NULL_VALUE)
@@ -1478,40 +1502,15 @@ rps_value_compute_method_closure (RpsValue_t val, const RpsObject_t * selob)
   switch (rps_value_type (val))
     {
     case RPS_TYPE_INT:
-      clasob = RPS_ROOT_OB (_2A2mrPpR3Qf03p6o5b);	//int∈class
-      clidstr = "_2A2mrPpR3Qf03p6o5b";
-      break;
     case RPS_TYPE_DOUBLE:
-      clasob = RPS_ROOT_OB (_98sc8kSOXV003i86w5);	//double∈class
-      clidstr = "_98sc8kSOXV003i86w5";
-      break;
     case RPS_TYPE_STRING:
-      clasob = RPS_ROOT_OB (_62LTwxwKpQ802SsmjE);	//string∈class
-      clidstr = "_62LTwxwKpQ802SsmjE";
-      break;
     case RPS_TYPE_JSON:
-      clasob = RPS_ROOT_OB (_3GHJQW0IIqS01QY8qD);	//json∈class
-      clidstr = "_3GHJQW0IIqS01QY8qD";
-      break;
     case RPS_TYPE_TUPLE:
-      clasob = RPS_ROOT_OB (_6NVM7sMcITg01ug5TC);	//tuple∈class
-      clidstr = "_6NVM7sMcITg01ug5TC";
-      break;
     case RPS_TYPE_SET:
-      clasob = RPS_ROOT_OB (_6JYterg6iAu00cV9Ye);	//set∈class
-      clidstr = "_6JYterg6iAu00cV9Ye";
-      break;
     case RPS_TYPE_CLOSURE:
-      clasob = RPS_ROOT_OB (_4jISxMJ4PYU0050nUl);	//closure∈class
-      clidstr = "_4jISxMJ4PYU0050nUl";
-      break;
     case RPS_TYPE_OBJECT:
-      {
-	RpsObject_t *curob = (RpsObject_t *) val;
-	pthread_mutex_lock (&curob->ob_mtx);
-	clasob = curob->ob_class;
-	pthread_mutex_unlock (&curob->ob_mtx);
-      }
+      /// see classdisplay_rps.c
+      clasob = rps_class_of_value (val);
       break;
     case RPS_TYPE_FILE:
       clidstr = "?*file*?";
@@ -1529,34 +1528,16 @@ rps_value_compute_method_closure (RpsValue_t val, const RpsObject_t * selob)
 	("rps_value_compute_method_closure unimplemented for val@%p %s",
 	 (void *) val, clidstr);
     }
-  if (!clasob && clidstr && clidstr[0] == '_')
-    {
-      const char *end = NULL;
-      clasid = rps_cstr_to_oid (clidstr, &end);
-      if (end && *end == (char) 0 && clasid.id_hi != 0)
-	clasob = rps_find_object_by_oid (clasid);
-    };
-  int cnt = 0;
-  // Even with buggy heap, we don't want to loop indefinitely.... It
-  // is likely that we will just loop less than a dozen of times.
-  while (clasob != NULL && cnt < 100 && !closres)
-    {
-      RpsClassInfo_t *clinf = NULL;
-      RpsObject_t *superob = NULL;
-      pthread_mutex_lock (&clasob->ob_mtx);
-      clinf = rps_get_object_payload_of_type (clasob, -RpsPyt_ClassInfo);
-      if (clinf && clinf->pclass_magic == RPS_CLASSINFO_MAGIC)
-	{
-	  closres = rps_classinfo_get_method (clinf, (RpsObject_t *) selob);
-	}
-      if (!closres)
-	{
-	  superob = clinf->pclass_super;
-	}
-      pthread_mutex_unlock (&clasob->ob_mtx);
-      clasob = superob;
-      cnt++;
-    }
+  /// the root classes are known before loading ends
+  if (!clasob)
+    return NULL;
+  unsigned long cachepoch = rps_method_cache_epoch ();
+  if (rps_method_cache_lookup (clasob, selob, &closres))
+    return closres;
+  /// on a cache miss, index the flattened method table of the class
+  closres = rps_obclass_flat_method (clasob, rps_selector_number (selob));
+  /// a missing method is cached too
+  rps_method_cache_store (clasob, selob, closres, cachepoch);
   return closres;
 }				/* end rps_value_compute_method_closure */
 
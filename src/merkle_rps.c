@@ -0,0 +1,347 @@
+/****************************************************************
+ * file merkle_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the structural hashing of object contents, and the
+ *      Merkle hashes of spaces combining them.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "Refpersys.h"
+
+/* The content hash of an object is a 64 bits hash of the compact JSON,
+   with sorted keys, of its class, space, components, attributes and
+   payload, as given by rps_locked_object_content_json.  Objects
+   referenced from that content are hashed by their oid, so the hash of
+   an object only changes when it is mutated.  It is cached, in a table
+   indexed by object index, with the ob_version for which it was
+   computed; payload mutators also bump ob_version, through
+   rps_locked_payload_touch.
+
+   The Merkle hash of a set of objects, e.g. of a space, is the sum,
+   modulo 2**64, of a mix of the oid and content hash of each of them.
+   Being a sum, it does not depend on the order of objects and can be
+   updated incrementally: removing the old contribution of a changed
+   object and adding its new one.  Space hashes are so maintained by
+   rps_refresh_merkle_hashes, for the objects changed since its last
+   call as told by the merge sequence of the modification time index. */
+
+struct rps_merkle_entry_st
+{
+  RpsObject_t *me_ob;
+  unsigned long me_version;	/* one more than the hashed ob_version */
+  uint64_t me_hash;
+  /// what this object contributes to the hash of some space
+  RpsObject_t *me_contribspace;
+  uint64_t me_contrib;
+};
+
+struct rps_merkle_space_st
+{
+  RpsObject_t *ms_space;
+  uint64_t ms_hash;
+  unsigned long ms_nbobjects;
+};
+
+/// a leaf mutex, taken after object locks
+static pthread_mutex_t rps_merkle_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct rps_merkle_entry_st *rps_merkle_entarr;
+static uint32_t rps_merkle_entsize;
+static struct rps_merkle_space_st *rps_merkle_spacearr;
+static unsigned rps_merkle_nbspaces, rps_merkle_sizespaces;
+
+/// serializes the refreshes of space hashes
+static pthread_mutex_t rps_merkle_refresh_mtx = PTHREAD_MUTEX_INITIALIZER;
+static bool rps_merkle_refreshed;
+static unsigned long rps_merkle_refresh_seq;
+
+static inline uint64_t
+rps_merkle_mix (uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}				/* end rps_merkle_mix */
+
+static uint64_t
+rps_merkle_string_hash (const char *str)
+{
+  /// FNV-1a, then mixed
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (const unsigned char *pc = (const unsigned char *) str; *pc; pc++)
+    {
+      h ^= *pc;
+      h *= 0x100000001b3ULL;
+    };
+  return rps_merkle_mix (h);
+}				/* end rps_merkle_string_hash */
+
+static inline uint64_t
+rps_merkle_contribution (const RpsObject_t * ob, uint64_t hash)
+{
+  return rps_merkle_mix (ob->ob_id.id_hi
+			 ^ rps_merkle_mix (ob->ob_id.id_lo ^ hash));
+}				/* end rps_merkle_contribution */
+
+/// with rps_merkle_mtx locked, the entry of object index IX
+static struct rps_merkle_entry_st *
+rps_merkle_entry (uint32_t ix)
+{
+  if (ix >= rps_merkle_entsize)
+    {
+      uint32_t newsize = rps_prime_above (ix + ix / 4 + 100);
+      struct rps_merkle_entry_st *newarr =
+	RPS_ALLOC_ZEROED (newsize * sizeof (struct rps_merkle_entry_st));
+      if (rps_merkle_entsize > 0)
+	memcpy (newarr, rps_merkle_entarr,
+		rps_merkle_entsize * sizeof (struct rps_merkle_entry_st));
+      free (rps_merkle_entarr);
+      rps_merkle_entarr = newarr;
+      rps_merkle_entsize = newsize;
+    };
+  return rps_merkle_entarr + ix;
+}				/* end rps_merkle_entry */
+
+/// with rps_merkle_mtx locked, the accumulated hash of a space
+static struct rps_merkle_space_st *
+rps_merkle_space (RpsObject_t * obspace)
+{
+  for (unsigned six = 0; six < rps_merkle_nbspaces; six++)
+    if (rps_merkle_spacearr[six].ms_space == obspace)
+      return rps_merkle_spacearr + six;
+  if (rps_merkle_nbspaces >= rps_merkle_sizespaces)
+    {
+      unsigned newsize = rps_merkle_sizespaces + rps_merkle_sizespaces / 2
+	+ 8;
+      struct rps_merkle_space_st *newarr =
+	RPS_ALLOC_ZEROED (newsize * sizeof (struct rps_merkle_space_st));
+      if (rps_merkle_nbspaces > 0)
+	memcpy (newarr, rps_merkle_spacearr,
+		rps_merkle_nbspaces * sizeof (struct rps_merkle_space_st));
+      free (rps_merkle_spacearr);
+      rps_merkle_spacearr = newarr;
+      rps_merkle_sizespaces = newsize;
+    };
+  struct rps_merkle_space_st *ms = rps_merkle_spacearr
+    + rps_merkle_nbspaces++;
+  ms->ms_space = obspace;
+  return ms;
+}				/* end rps_merkle_space */
+
+/* Compute, or get from the cache, the content hash of OB, also giving
+   its space and mtime when asked. */
+static uint64_t
+rps_merkle_object_hash (RpsObject_t * ob, RpsObject_t ** pspace,
+			double *pmtime)
+{
+  uint64_t hash = 0;
+  bool cached = false;
+  pthread_mutex_lock (&ob->ob_mtx);
+  unsigned long version = atomic_load (&ob->ob_version);
+  uint32_t ix = rps_object_index (ob);
+  if (pspace)
+    *pspace = ob->ob_space;
+  if (pmtime)
+    *pmtime = ob->ob_mtime;
+  if (ix > 0)
+    {
+      pthread_mutex_lock (&rps_merkle_mtx);
+      if (ix < rps_merkle_entsize)
+	{
+	  struct rps_merkle_entry_st *me = rps_merkle_entarr + ix;
+	  if (me->me_ob == ob && me->me_version == version + 1)
+	    {
+	      hash = me->me_hash;
+	      cached = true;
+	    }
+	};
+      pthread_mutex_unlock (&rps_merkle_mtx);
+    };
+  if (!cached)
+    {
+      json_t *jsob = rps_locked_object_content_json (ob);
+      char *str = json_dumps (jsob, JSON_COMPACT | JSON_SORT_KEYS);
+      hash = rps_merkle_string_hash (str ? str : "");
+      free (str);
+      json_decref (jsob);
+      if (ix > 0)
+	{
+	  pthread_mutex_lock (&rps_merkle_mtx);
+	  struct rps_merkle_entry_st *me = rps_merkle_entry (ix);
+	  if (me->me_ob != ob)
+	    {
+	      /// the index was reused, forget the old contribution
+	      if (me->me_contribspace)
+		rps_merkle_space (me->me_contribspace)->ms_hash -=
+		  me->me_contrib;
+	      memset (me, 0, sizeof (*me));
+	      me->me_ob = ob;
+	    };
+	  me->me_version = version + 1;
+	  me->me_hash = hash;
+	  pthread_mutex_unlock (&rps_merkle_mtx);
+	}
+    };
+  pthread_mutex_unlock (&ob->ob_mtx);
+  return hash;
+}				/* end rps_merkle_object_hash */
+
+uint64_t
+rps_object_content_hash (RpsObject_t * ob)
+{
+  if (!ob || !rps_is_valid_object (ob))
+    return 0;
+  return rps_merkle_object_hash (ob, NULL, NULL);
+}				/* end rps_object_content_hash */
+
+/* The Merkle hash of a set of objects.  With WITHMTIME, the dumped
+   modification times are also hashed, as the dumper needs. */
+uint64_t
+rps_set_merkle_hash (const RpsSetOb_t * set, bool withmtime)
+{
+  uint64_t sum = 0;
+  unsigned card = rps_set_cardinal (set);
+  for (unsigned eix = 0; eix < card; eix++)
+    {
+      RpsObject_t *ob = (RpsObject_t *) rps_set_nth_member (set, eix);
+      double mtime = 0.0;
+      uint64_t hash = rps_merkle_object_hash (ob, NULL, &mtime);
+      if (withmtime)
+	/// the dumper writes mtimes with two decimal digits
+	hash = rps_merkle_mix (hash ^ (uint64_t) llround (mtime * 100.0));
+      sum += rps_merkle_contribution (ob, hash);
+    };
+  return sum;
+}				/* end rps_set_merkle_hash */
+
+/// update the contribution of an object to its space hash
+static void
+rps_merkle_refresh_object (RpsObject_t * ob)
+{
+  uint32_t ix = rps_object_index (ob);
+  if (ix == 0)
+    return;
+  RpsObject_t *obspace = NULL;
+  uint64_t hash = rps_merkle_object_hash (ob, &obspace, NULL);
+  uint64_t contrib = rps_merkle_contribution (ob, hash);
+  pthread_mutex_lock (&rps_merkle_mtx);
+  struct rps_merkle_entry_st *me = rps_merkle_entry (ix);
+  if (me->me_ob == ob)
+    {
+      if (me->me_contribspace)
+	{
+	  struct rps_merkle_space_st *ms =
+	    rps_merkle_space (me->me_contribspace);
+	  ms->ms_hash -= me->me_contrib;
+	  ms->ms_nbobjects--;
+	};
+      me->me_contribspace = NULL;
+      me->me_contrib = 0;
+      if (obspace)
+	{
+	  struct rps_merkle_space_st *ms = rps_merkle_space (obspace);
+	  ms->ms_hash += contrib;
+	  ms->ms_nbobjects++;
+	  me->me_contribspace = obspace;
+	  me->me_contrib = contrib;
+	}
+    };
+  pthread_mutex_unlock (&rps_merkle_mtx);
+}				/* end rps_merkle_refresh_object */
+
+static rps_parallel_object_callback_sig_t rps_merkle_all_objects_cb;
+static bool
+rps_merkle_all_objects_cb (RpsObject_t * ob, int workix, void *data)
+{
+  rps_merkle_refresh_object (ob);
+  return true;
+}				/* end rps_merkle_all_objects_cb */
+
+static rps_parallel_index_callback_sig_t rps_merkle_changed_cb;
+static void
+rps_merkle_changed_cb (unsigned long ix, int workix, void *data)
+{
+  const RpsSetOb_t *changedset = data;
+  rps_merkle_refresh_object ((RpsObject_t *) changedset->set_elem[ix]);
+}				/* end rps_merkle_changed_cb */
+
+/* Bring the space hashes up to date in NBTHREADS threads (or
+   rps_nb_threads if not positive).  The first call hashes every
+   object, the next ones only the objects changed since the previous
+   call. */
+void
+rps_refresh_merkle_hashes (int nbthreads)
+{
+  pthread_mutex_lock (&rps_merkle_refresh_mtx);
+  /// changes merged after the sequence are seen by the next refresh
+  if (!rps_merkle_refreshed)
+    {
+      rps_merkle_refresh_seq = rps_mtime_index_sequence ();
+      rps_parallel_for_each_object (rps_merkle_all_objects_cb, NULL,
+				    nbthreads);
+    }
+  else
+    {
+      const RpsSetOb_t *changedset =
+	rps_objects_changed_after_sequence (rps_merkle_refresh_seq,
+					    &rps_merkle_refresh_seq);
+      rps_parallel_for_each_index (rps_set_cardinal (changedset),
+				   nbthreads, rps_merkle_changed_cb,
+				   (void *) changedset);
+    };
+  rps_merkle_refreshed = true;
+  pthread_mutex_unlock (&rps_merkle_refresh_mtx);
+}				/* end rps_refresh_merkle_hashes */
+
+/* The Merkle hash of the objects of a space, after a refresh, and
+   their number in *PNBOBJECTS if given.  Two heaps with equal hashes
+   for a space have, almost surely, the same content in that space. */
+uint64_t
+rps_space_merkle_hash (RpsObject_t * obspace, unsigned long *pnbobjects)
+{
+  uint64_t hash = 0;
+  unsigned long nbobjects = 0;
+  rps_refresh_merkle_hashes (0);
+  pthread_mutex_lock (&rps_merkle_mtx);
+  for (unsigned six = 0; six < rps_merkle_nbspaces; six++)
+    if (rps_merkle_spacearr[six].ms_space == obspace)
+      {
+	hash = rps_merkle_spacearr[six].ms_hash;
+	nbobjects = rps_merkle_spacearr[six].ms_nbobjects;
+	break;
+      };
+  pthread_mutex_unlock (&rps_merkle_mtx);
+  if (pnbobjects)
+    *pnbobjects = nbobjects;
+  return hash;
+}				/* end rps_space_merkle_hash */
+
+/****** end of file merkle_rps.c ******/
@@ -0,0 +1,153 @@
+/****************************************************************
+ * file methcache_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the global method cache, mapping a class and a
+ *      selector to the closure of the method, used when sending.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "Refpersys.h"
+
+/* The method cache is a big direct mapped table, two ways associative,
+   split into cache line sized entries.  Each entry is its own shard: it
+   has its sequence counter, odd while being written, so readers never
+   lock and retry on a concurrent update, and writers needing a busy
+   entry just skip caching.  Invalidation is global and cheap: every
+   entry records the epoch at which its lookup started, and only
+   entries of the current epoch are valid.  The epoch is bumped when a
+   method dictionary or a superclass changes, or when a classinfo
+   payload is put or removed.  A missing method is cached too, with a
+   NULL closure. */
+
+#define RPS_METHCACHE_SIZE 4096	/* a power of two */
+
+struct rps_methcache_entry_st
+{
+  alignas (64) atomic_uint mce_seq;
+  const RpsObject_t *_Atomic mce_class;
+  const RpsObject_t *_Atomic mce_selector;
+  RpsClosure_t *_Atomic mce_closure;
+  atomic_ulong mce_epoch;
+};
+
+static struct rps_methcache_entry_st rps_methcache_arr[RPS_METHCACHE_SIZE];
+/// epoch 0 is never current, so zeroed entries are invalid
+static atomic_ulong rps_methcache_global_epoch = 1;
+
+unsigned long
+rps_method_cache_epoch (void)
+{
+  return atomic_load (&rps_methcache_global_epoch);
+}				/* end rps_method_cache_epoch */
+
+void
+rps_method_cache_invalidate (void)
+{
+  atomic_fetch_add (&rps_methcache_global_epoch, 1);
+}				/* end rps_method_cache_invalidate */
+
+static inline unsigned
+rps_methcache_index (const RpsObject_t * clasob, const RpsObject_t * selob)
+{
+  RpsHash_t h = (clasob->zv_hash * 31) ^ (selob->zv_hash * 7);
+  /// the two ways are at even index and the next odd one
+  return (h << 1) & (RPS_METHCACHE_SIZE - 1);
+}				/* end rps_methcache_index */
+
+bool
+rps_method_cache_lookup (const RpsObject_t * clasob,
+			 const RpsObject_t * selob, RpsClosure_t ** pclos)
+{
+  if (!clasob || !selob || !pclos)
+    return false;
+  unsigned long curepoch = atomic_load (&rps_methcache_global_epoch);
+  unsigned ix = rps_methcache_index (clasob, selob);
+  for (int way = 0; way < 2; way++)
+    {
+      struct rps_methcache_entry_st *ent = rps_methcache_arr + ix + way;
+      for (int tries = 0; tries < 4; tries++)
+	{
+	  unsigned seq1 =
+	    atomic_load_explicit (&ent->mce_seq, memory_order_acquire);
+	  if (seq1 & 1)
+	    continue;
+	  const RpsObject_t *curclass =
+	    atomic_load_explicit (&ent->mce_class, memory_order_relaxed);
+	  const RpsObject_t *cursel =
+	    atomic_load_explicit (&ent->mce_selector, memory_order_relaxed);
+	  RpsClosure_t *curclos =
+	    atomic_load_explicit (&ent->mce_closure, memory_order_relaxed);
+	  unsigned long curentepoch =
+	    atomic_load_explicit (&ent->mce_epoch, memory_order_relaxed);
+	  atomic_thread_fence (memory_order_acquire);
+	  unsigned seq2 =
+	    atomic_load_explicit (&ent->mce_seq, memory_order_relaxed);
+	  if (seq1 != seq2)
+	    continue;
+	  if (curclass == clasob && cursel == selob
+	      && curentepoch == curepoch)
+	    {
+	      *pclos = curclos;
+	      return true;
+	    };
+	  break;
+	}
+    };
+  return false;
+}				/* end rps_method_cache_lookup */
+
+void
+rps_method_cache_store (const RpsObject_t * clasob,
+			const RpsObject_t * selob, RpsClosure_t * clos,
+			unsigned long epoch)
+{
+  if (!clasob || !selob)
+    return;
+  /// a stale result should not be cached
+  if (epoch != atomic_load (&rps_methcache_global_epoch))
+    return;
+  unsigned ix = rps_methcache_index (clasob, selob);
+  /// replace the way with the oldest epoch, or the second one
+  struct rps_methcache_entry_st *ent = rps_methcache_arr + ix;
+  if (atomic_load (&ent->mce_epoch) == epoch
+      && !(atomic_load (&ent->mce_class) == clasob
+	   && atomic_load (&ent->mce_selector) == selob))
+    ent++;
+  unsigned seq = atomic_load (&ent->mce_seq);
+  if ((seq & 1)
+      || !atomic_compare_exchange_strong (&ent->mce_seq, &seq, seq + 1))
+    return;			/* another thread is writing that entry */
+  atomic_thread_fence (memory_order_release);
+  atomic_store_explicit (&ent->mce_class, clasob, memory_order_relaxed);
+  atomic_store_explicit (&ent->mce_selector, selob, memory_order_relaxed);
+  atomic_store_explicit (&ent->mce_closure, clos, memory_order_relaxed);
+  atomic_store_explicit (&ent->mce_epoch, epoch, memory_order_relaxed);
+  atomic_store_explicit (&ent->mce_seq, seq + 2, memory_order_release);
+}				/* end rps_method_cache_store */
+
+/****** end of file methcache_rps.c ******/
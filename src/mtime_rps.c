@@ -0,0 +1,420 @@
+/****************************************************************
+ * file mtime_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the index of objects by modification time, for
+ *      queries about recently changed objects.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "Refpersys.h"
+
+/* Each thread appends the modification time and object of its
+   changes to its own log, under a mutex which is almost never
+   contended.  The logs are lazily merged, by queries or when some log
+   is full, into a global array sorted by time.  An object changed
+   several times has several entries; the older ones are still correct
+   answers for "changed since" queries, and are dropped when the
+   global array has doubled since its last compaction.  Merging never
+   locks any object, so a full log can be merged inside
+   rps_locked_object_touch.  The log of an exiting thread stays in the
+   list of logs, to be merged, and is reused by the next new thread
+   noting a change.
+
+   Each entry also gets, when merged, the next value of a merge
+   sequence counter.  Unlike times, that counter tells which entries
+   were merged after a previous query, even if their mtime is older, so
+   incremental consumers like the Merkle hashes of merkle_rps.c miss no
+   change. */
+
+#define RPS_MTIME_LOG_MAX 4096
+
+struct rps_mtime_entry_st
+{
+  double me_mtime;
+  RpsObject_t *me_ob;
+  unsigned long me_seq;		/* the merge sequence, zero in logs */
+};
+
+struct rps_mtime_log_st
+{
+  pthread_mutex_t mlog_mtx;
+  struct rps_mtime_log_st *mlog_next;	/* immutable once registered */
+  bool mlog_inuse;		/* owned by a live thread, under rps_mtime_mtx */
+  unsigned mlog_nb;
+  struct rps_mtime_entry_st mlog_arr[RPS_MTIME_LOG_MAX];
+};
+
+static _Thread_local struct rps_mtime_log_st *rps_mtime_thread_log;
+/// notes of this thread are ignored while positive, e.g. when loading
+static _Thread_local int rps_mtime_thread_suspended;
+static struct rps_mtime_log_st *_Atomic rps_mtime_first_log;
+/// its destructor releases the log of an exiting thread
+static pthread_key_t rps_mtime_log_key;
+static pthread_once_t rps_mtime_log_key_once = PTHREAD_ONCE_INIT;
+/// the merge mutex, protecting the global sorted array; it is taken
+/// before the mutex of any log
+static pthread_mutex_t rps_mtime_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct rps_mtime_entry_st *rps_mtime_arr;
+static unsigned long rps_mtime_nb, rps_mtime_size;
+static unsigned long rps_mtime_compacted_nb;
+static unsigned long rps_mtime_seq;
+
+static int
+rps_mtime_entry_qcmp (const void *p1, const void *p2)
+{
+  const struct rps_mtime_entry_st *e1 = p1;
+  const struct rps_mtime_entry_st *e2 = p2;
+  if (e1->me_mtime < e2->me_mtime)
+    return -1;
+  if (e1->me_mtime > e2->me_mtime)
+    return 1;
+  return rps_object_cmp (e1->me_ob, e2->me_ob);
+}				/* end rps_mtime_entry_qcmp */
+
+static int
+rps_mtime_entry_by_object_qcmp (const void *p1, const void *p2)
+{
+  const struct rps_mtime_entry_st *e1 = p1;
+  const struct rps_mtime_entry_st *e2 = p2;
+  int cmp = rps_object_cmp (e1->me_ob, e2->me_ob);
+  if (cmp)
+    return cmp;
+  return (e1->me_mtime < e2->me_mtime) ? -1 : (e1->me_mtime >
+					       e2->me_mtime) ? 1 : 0;
+}				/* end rps_mtime_entry_by_object_qcmp */
+
+static void
+rps_mtime_reserve (unsigned long nbextra)
+{
+  if (rps_mtime_nb + nbextra <= rps_mtime_size)
+    return;
+  unsigned long newsize = rps_mtime_nb + nbextra + rps_mtime_nb / 2 + 1024;
+  struct rps_mtime_entry_st *newarr =
+    RPS_ALLOC_ZEROED (newsize * sizeof (struct rps_mtime_entry_st));
+  if (rps_mtime_nb > 0)
+    memcpy (newarr, rps_mtime_arr,
+	    rps_mtime_nb * sizeof (struct rps_mtime_entry_st));
+  free (rps_mtime_arr);
+  rps_mtime_arr = newarr;
+  rps_mtime_size = newsize;
+}				/* end rps_mtime_reserve */
+
+/* Keep only the last entry of each object, with the latest merge
+   sequence of its entries, in an array sorted by object. */
+static unsigned long
+rps_mtime_unique_entries (struct rps_mtime_entry_st *entarr,
+			  unsigned long nbent)
+{
+  unsigned long nbuniq = 0;
+  for (unsigned long ix = 0; ix < nbent; ix++)
+    {
+      if (nbuniq > 0 && entarr[nbuniq - 1].me_ob == entarr[ix].me_ob)
+	{
+	  unsigned long seq = entarr[nbuniq - 1].me_seq;
+	  entarr[nbuniq - 1] = entarr[ix];
+	  if (seq > entarr[ix].me_seq)
+	    entarr[nbuniq - 1].me_seq = seq;
+	}
+      else
+	entarr[nbuniq++] = entarr[ix];
+    };
+  return nbuniq;
+}				/* end rps_mtime_unique_entries */
+
+/// keep only the last entry of each object, with rps_mtime_mtx locked
+static void
+rps_mtime_compact (void)
+{
+  qsort (rps_mtime_arr, rps_mtime_nb, sizeof (struct rps_mtime_entry_st),
+	 rps_mtime_entry_by_object_qcmp);
+  unsigned long nbuniq = rps_mtime_unique_entries (rps_mtime_arr,
+						   rps_mtime_nb);
+  rps_mtime_nb = nbuniq;
+  qsort (rps_mtime_arr, rps_mtime_nb, sizeof (struct rps_mtime_entry_st),
+	 rps_mtime_entry_qcmp);
+  rps_mtime_compacted_nb = rps_mtime_nb;
+}				/* end rps_mtime_compact */
+
+/// drain every thread log into the global array, with rps_mtime_mtx locked
+static void
+rps_mtime_merge_logs (void)
+{
+  unsigned long oldnb = rps_mtime_nb;
+  for (struct rps_mtime_log_st * mlog = atomic_load (&rps_mtime_first_log);
+       mlog; mlog = mlog->mlog_next)
+    {
+      pthread_mutex_lock (&mlog->mlog_mtx);
+      if (mlog->mlog_nb > 0)
+	{
+	  rps_mtime_reserve (mlog->mlog_nb);
+	  memcpy (rps_mtime_arr + rps_mtime_nb, mlog->mlog_arr,
+		  mlog->mlog_nb * sizeof (struct rps_mtime_entry_st));
+	  for (unsigned ix = 0; ix < mlog->mlog_nb; ix++)
+	    rps_mtime_arr[rps_mtime_nb + ix].me_seq = ++rps_mtime_seq;
+	  rps_mtime_nb += mlog->mlog_nb;
+	  mlog->mlog_nb = 0;
+	};
+      pthread_mutex_unlock (&mlog->mlog_mtx);
+    };
+  if (rps_mtime_nb == oldnb)
+    return;
+  if (rps_mtime_nb > 2 * rps_mtime_compacted_nb + RPS_MTIME_LOG_MAX)
+    {
+      rps_mtime_compact ();
+      return;
+    };
+  /// sort the new tail, then merge it with the sorted head
+  unsigned long nbnew = rps_mtime_nb - oldnb;
+  struct rps_mtime_entry_st *tail = rps_mtime_arr + oldnb;
+  qsort (tail, nbnew, sizeof (struct rps_mtime_entry_st),
+	 rps_mtime_entry_qcmp);
+  if (oldnb == 0 || rps_mtime_entry_qcmp (tail - 1, tail) <= 0)
+    return;
+  struct rps_mtime_entry_st *tmparr =
+    RPS_ALLOC_ZEROED (nbnew * sizeof (struct rps_mtime_entry_st));
+  memcpy (tmparr, tail, nbnew * sizeof (struct rps_mtime_entry_st));
+  /// merge backwards, from the end of the array
+  long i = (long) oldnb - 1, j = (long) nbnew - 1, k =
+    (long) rps_mtime_nb - 1;
+  while (j >= 0)
+    {
+      if (i >= 0 && rps_mtime_entry_qcmp (rps_mtime_arr + i, tmparr + j) > 0)
+	rps_mtime_arr[k--] = rps_mtime_arr[i--];
+      else
+	rps_mtime_arr[k--] = tmparr[j--];
+    };
+  free (tmparr);
+}				/* end rps_mtime_merge_logs */
+
+static void
+rps_mtime_release_log (void *ptr)
+{
+  struct rps_mtime_log_st *mlog = ptr;
+  pthread_mutex_lock (&rps_mtime_mtx);
+  mlog->mlog_inuse = false;
+  pthread_mutex_unlock (&rps_mtime_mtx);
+}				/* end rps_mtime_release_log */
+
+static void
+rps_mtime_create_log_key (void)
+{
+  if (pthread_key_create (&rps_mtime_log_key, rps_mtime_release_log))
+    RPS_FATAL ("failed to create the mtime log key");
+}				/* end rps_mtime_create_log_key */
+
+/// give the current thread a log, reusing one released by an exited thread
+static struct rps_mtime_log_st *
+rps_mtime_acquire_log (void)
+{
+  struct rps_mtime_log_st *mlog = NULL;
+  pthread_once (&rps_mtime_log_key_once, rps_mtime_create_log_key);
+  pthread_mutex_lock (&rps_mtime_mtx);
+  for (mlog = atomic_load (&rps_mtime_first_log); mlog;
+       mlog = mlog->mlog_next)
+    if (!mlog->mlog_inuse)
+      break;
+  if (!mlog)
+    {
+      mlog = RPS_ALLOC_ZEROED (sizeof (struct rps_mtime_log_st));
+      pthread_mutex_init (&mlog->mlog_mtx, NULL);
+      mlog->mlog_next = atomic_load (&rps_mtime_first_log);
+      atomic_store (&rps_mtime_first_log, mlog);
+    };
+  mlog->mlog_inuse = true;
+  pthread_mutex_unlock (&rps_mtime_mtx);
+  pthread_setspecific (rps_mtime_log_key, mlog);
+  rps_mtime_thread_log = mlog;
+  return mlog;
+}				/* end rps_mtime_acquire_log */
+
+void
+rps_mtime_index_note (RpsObject_t * ob, double mtime)
+{
+  if (!ob || rps_mtime_thread_suspended > 0)
+    return;
+  struct rps_mtime_log_st *mlog = rps_mtime_thread_log;
+  if (!mlog)
+    mlog = rps_mtime_acquire_log ();
+  pthread_mutex_lock (&mlog->mlog_mtx);
+  bool full = mlog->mlog_nb >= RPS_MTIME_LOG_MAX;
+  pthread_mutex_unlock (&mlog->mlog_mtx);
+  if (full)
+    {
+      pthread_mutex_lock (&rps_mtime_mtx);
+      rps_mtime_merge_logs ();
+      pthread_mutex_unlock (&rps_mtime_mtx);
+    };
+  pthread_mutex_lock (&mlog->mlog_mtx);
+  RPS_ASSERT (mlog->mlog_nb < RPS_MTIME_LOG_MAX);
+  mlog->mlog_arr[mlog->mlog_nb].me_mtime = mtime;
+  mlog->mlog_arr[mlog->mlog_nb].me_ob = ob;
+  mlog->mlog_arr[mlog->mlog_nb].me_seq = 0;
+  mlog->mlog_nb++;
+  pthread_mutex_unlock (&mlog->mlog_mtx);
+}				/* end rps_mtime_index_note */
+
+/* The loader fills an object, touching it many times at the current
+   time, and then notes its dumped mtime; the touches are not noted, so
+   a freshly loaded heap does not look changed. */
+void
+rps_mtime_index_suspend (void)
+{
+  rps_mtime_thread_suspended++;
+}				/* end rps_mtime_index_suspend */
+
+void
+rps_mtime_index_resume (void)
+{
+  RPS_ASSERT (rps_mtime_thread_suspended > 0);
+  rps_mtime_thread_suspended--;
+}				/* end rps_mtime_index_resume */
+
+/// the index of the first entry not before MTIME
+static unsigned long
+rps_mtime_lower_bound (double mtime)
+{
+  unsigned long lo = 0, hi = rps_mtime_nb;
+  while (lo < hi)
+    {
+      unsigned long md = lo + (hi - lo) / 2;
+      if (rps_mtime_arr[md].me_mtime < mtime)
+	lo = md + 1;
+      else
+	hi = md;
+    };
+  return lo;
+}				/* end rps_mtime_lower_bound */
+
+/* Copy the distinct objects changed between SINCE and UNTIL, both
+   included, into a malloc-ed array by increasing time of their last
+   such change; UNTIL is unlimited if not above SINCE. */
+static RpsObject_t **
+rps_mtime_changed_array (double since, double until, unsigned long *pnb)
+{
+  pthread_mutex_lock (&rps_mtime_mtx);
+  rps_mtime_merge_logs ();
+  unsigned long startix = rps_mtime_lower_bound (since);
+  unsigned long endix = (until > since)
+    ? rps_mtime_lower_bound (nextafter (until, INFINITY)) : rps_mtime_nb;
+  unsigned long nbent = endix - startix;
+  struct rps_mtime_entry_st *entarr =
+    RPS_ALLOC_ZEROED ((nbent + 1) * sizeof (struct rps_mtime_entry_st));
+  if (nbent > 0)
+    memcpy (entarr, rps_mtime_arr + startix,
+	    nbent * sizeof (struct rps_mtime_entry_st));
+  pthread_mutex_unlock (&rps_mtime_mtx);
+  /// keep the last entry of each object, then order them by time
+  qsort (entarr, nbent, sizeof (struct rps_mtime_entry_st),
+	 rps_mtime_entry_by_object_qcmp);
+  unsigned long nbuniq = rps_mtime_unique_entries (entarr, nbent);
+  qsort (entarr, nbuniq, sizeof (struct rps_mtime_entry_st),
+	 rps_mtime_entry_qcmp);
+  RpsObject_t **obarr = RPS_ALLOC_ZEROED ((nbuniq + 1) *
+					  sizeof (RpsObject_t *));
+  for (unsigned long ix = 0; ix < nbuniq; ix++)
+    obarr[ix] = entarr[ix].me_ob;
+  free (entarr);
+  *pnb = nbuniq;
+  return obarr;
+}				/* end rps_mtime_changed_array */
+
+const RpsSetOb_t *
+rps_objects_changed_between (double since, double until)
+{
+  unsigned long nbob = 0;
+  RpsObject_t **obarr = rps_mtime_changed_array (since, until, &nbob);
+  const RpsSetOb_t *set =
+    rps_alloc_set_sized ((unsigned) nbob, (const RpsObject_t **) obarr);
+  free (obarr);
+  return set;
+}				/* end rps_objects_changed_between */
+
+unsigned long
+rps_iterate_objects_changed_since (double since,
+				   rps_object_callback_sig_t * rout,
+				   void *data)
+{
+  unsigned long nbob = 0, cnt = 0;
+  if (!rout)
+    return 0;
+  RpsObject_t **obarr = rps_mtime_changed_array (since, 0.0, &nbob);
+  for (unsigned long ix = 0; ix < nbob; ix++)
+    {
+      if (!(*rout) (obarr[ix], data))
+	break;
+      cnt++;
+    };
+  free (obarr);
+  return cnt;
+}				/* end rps_iterate_objects_changed_since */
+
+unsigned long
+rps_mtime_index_sequence (void)
+{
+  pthread_mutex_lock (&rps_mtime_mtx);
+  rps_mtime_merge_logs ();
+  unsigned long seq = rps_mtime_seq;
+  pthread_mutex_unlock (&rps_mtime_mtx);
+  return seq;
+}				/* end rps_mtime_index_sequence */
+
+/* The set of objects with some entry merged after the sequence SEQ,
+   whatever their mtime; the current sequence goes in *PNEXTSEQ, for
+   the next such query.  The array is sorted by time, not sequence, so
+   it is scanned, but compaction keeps it near the number of changed
+   objects. */
+const RpsSetOb_t *
+rps_objects_changed_after_sequence (unsigned long seq,
+				    unsigned long *pnextseq)
+{
+  pthread_mutex_lock (&rps_mtime_mtx);
+  rps_mtime_merge_logs ();
+  unsigned long nbob = 0;
+  RpsObject_t **obarr = NULL;
+  if (seq < rps_mtime_seq)
+    {
+      unsigned long nbmax = rps_mtime_seq - seq;
+      if (nbmax > rps_mtime_nb)
+	nbmax = rps_mtime_nb;
+      obarr = RPS_ALLOC_ZEROED ((nbmax + 1) * sizeof (RpsObject_t *));
+      for (unsigned long ix = 0; ix < rps_mtime_nb && nbob < nbmax; ix++)
+	if (rps_mtime_arr[ix].me_seq > seq)
+	  obarr[nbob++] = rps_mtime_arr[ix].me_ob;
+    };
+  if (pnextseq)
+    *pnextseq = rps_mtime_seq;
+  pthread_mutex_unlock (&rps_mtime_mtx);
+  /// the set constructor sorts its elements and drops duplicates
+  const RpsSetOb_t *set =
+    rps_alloc_set_sized ((unsigned) nbob, (const RpsObject_t **) obarr);
+  free (obarr);
+  return set;
+}				/* end rps_objects_changed_after_sequence */
+
+/****** end of file mtime_rps.c ******/
@@ -61,6 +61,72 @@ rps_is_valid_object (RpsObject_t * obj)
   return true;
 }				/* end rps_is_valid_object */
 
+/* The class and space attributes are special, they are not in the
+   shape or attribute table but in fields of the locked object.
+   Return true if OBATTR is special, then getting or putting it. */
+static bool
+rps_locked_object_get_special_attribute (RpsObject_t * obj,
+					 const RpsObject_t * obattr,
+					 RpsValue_t * pres)
+{
+  if (obattr == RPS_ROOT_OB (_41OFI3r0S1t03qdB2E))	//class∈class
+    {
+      *pres = (RpsValue_t) (obj->ob_class);
+      return true;
+    }
+  if (obattr == RPS_ROOT_OB (_2i66FFjmS7n03HNNBx)	//space∈class
+      || obattr == RPS_ROOT_OB (_9uwZtDshW4401x6MsY)	//space∈symbol
+    )
+    {
+      *pres = (RpsValue_t) (obj->ob_space);
+      return true;
+    };
+  return false;
+}				/* end rps_locked_object_get_special_attribute */
+
+void
+rps_locked_object_put_class (RpsObject_t * obj, RpsObject_t * obclass)
+{
+  RPS_ASSERT (obj != NULL);
+  RpsObject_t *oldclass = obj->ob_class;
+  if (oldclass == obclass)
+    return;
+  rps_class_extent_change (obj, oldclass, obclass);
+  if (rps_attr_indexes_exist ())
+    rps_attr_index_class_change (obj, oldclass, obclass);
+  obj->ob_class = obclass;
+}				/* end rps_locked_object_put_class */
+
+static bool
+rps_locked_object_put_special_attribute (RpsObject_t * obj,
+					 const RpsObject_t * obattr,
+					 RpsValue_t val)
+{
+  if (obattr == RPS_ROOT_OB (_41OFI3r0S1t03qdB2E))	//class∈class
+    {
+      if (rps_value_type (val) == RPS_TYPE_OBJECT)
+	{
+	  /// need an test that the value has some payload...
+	  rps_locked_object_touch (obj);
+	  rps_locked_object_put_class (obj, (RpsObject_t *) val);
+	}
+      return true;
+    };
+  if (obattr == RPS_ROOT_OB (_2i66FFjmS7n03HNNBx)	//space∈class
+      || obattr == RPS_ROOT_OB (_9uwZtDshW4401x6MsY)	//space∈symbol
+    )
+    {
+      if (rps_value_type (val) == RPS_TYPE_OBJECT)
+	{
+	  /// need an test that the value has some payload...
+	  rps_locked_object_touch (obj);
+	  obj->ob_space = (RpsObject_t *) val;
+	}
+      return true;
+    }
+  return false;
+}				/* end rps_locked_object_put_special_attribute */
+
 RpsValue_t
 rps_get_object_attribute (RpsObject_t * obj, RpsObject_t * obattr)
 {
@@ -72,28 +138,57 @@ rps_get_object_attribute (RpsObject_t * obj, RpsObject_t * obattr)
   RPS_ASSERT (rps_is_valid_object (obattr));
   RpsValue_t res = RPS_NULL_VALUE;
   pthread_mutex_lock (&obj->ob_mtx);
-  if (obattr == RPS_ROOT_OB (_41OFI3r0S1t03qdB2E))	//class∈class
-    {
-      res = (RpsValue_t) (obj->ob_class);
-      goto end;
-    }
-  if (obattr == RPS_ROOT_OB (_2i66FFjmS7n03HNNBx)	//space∈class
-      || obattr == RPS_ROOT_OB (_9uwZtDshW4401x6MsY)	//space∈symbol
-    )
-    {
-      res = (RpsValue_t) (obj->ob_space);
-      goto end;
-    };
-  RpsAttrTable_t *atbl = obj->ob_attrtable;
-  if (!atbl)
-    goto end;
-  RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (atbl) == -RpsPyt_AttrTable);
-  res = rps_attr_table_find (atbl, obattr);
-end:
+  res = rps_locked_object_get_any_attribute (obj, obattr);
   pthread_mutex_unlock (&obj->ob_mtx);
   return res;
 }				/* end rps_get_object_attribute */
 
+RpsValue_t
+rps_locked_object_get_any_attribute (RpsObject_t * obj, RpsObject_t * obattr)
+{
+  RpsValue_t res = RPS_NULL_VALUE;
+  if (!obj || !obattr)
+    return RPS_NULL_VALUE;
+  if (!rps_locked_object_get_special_attribute (obj, obattr, &res))
+    res = rps_locked_object_get_attribute (obj, obattr);
+  return res;
+}				/* end rps_locked_object_get_any_attribute */
+
+void
+rps_locked_object_put_any_attribute (RpsObject_t * obj, RpsObject_t * obattr,
+				     RpsValue_t val)
+{
+  if (!obj || !obattr || val == RPS_NULL_VALUE)
+    return;
+  if (!rps_locked_object_put_special_attribute (obj, obattr, val))
+    rps_locked_object_put_attribute (obj, obattr, val);
+}				/* end rps_locked_object_put_any_attribute */
+
+unsigned
+rps_object_get_attributes (RpsObject_t * obj, unsigned nbattrs,
+			   RpsObject_t * const *attrarr, RpsValue_t * valarr)
+{
+  unsigned nbfound = 0;
+  if (!obj || nbattrs == 0)
+    return 0;
+  RPS_ASSERT (rps_is_valid_object (obj));
+  RPS_ASSERT (attrarr != NULL && valarr != NULL);
+  pthread_mutex_lock (&obj->ob_mtx);
+  for (unsigned ix = 0; ix < nbattrs; ix++)
+    {
+      RpsObject_t *obattr = attrarr[ix];
+      RpsValue_t res = RPS_NULL_VALUE;
+      if (obattr
+	  && !rps_locked_object_get_special_attribute (obj, obattr, &res))
+	res = rps_locked_object_get_attribute (obj, obattr);
+      valarr[ix] = res;
+      if (res != RPS_NULL_VALUE)
+	nbfound++;
+    };
+  pthread_mutex_unlock (&obj->ob_mtx);
+  return nbfound;
+}				/* end rps_object_get_attributes */
+
 RpsValue_t
 rps_get_object_component (RpsObject_t * obj, int ix)
 {
@@ -127,36 +222,65 @@ rps_put_object_attribute (RpsObject_t * obj, RpsObject_t * obattr,
   if (val == RPS_NULL_VALUE)
     return;
   pthread_mutex_lock (&obj->ob_mtx);
-  if (obattr == RPS_ROOT_OB (_41OFI3r0S1t03qdB2E))	//class∈class
+  rps_locked_object_put_any_attribute (obj, obattr, val);
+  pthread_mutex_unlock (&obj->ob_mtx);
+}				/* end rps_put_object_attribute */
+
+unsigned
+rps_object_put_attributes (RpsObject_t * obj, unsigned nbattrs,
+			   RpsObject_t * const *attrarr,
+			   const RpsValue_t * valarr)
+{
+  unsigned nbput = 0;
+  unsigned nbspecial = 0;
+  if (!obj || nbattrs == 0)
+    return 0;
+  RPS_ASSERT (rps_is_valid_object (obj));
+  RPS_ASSERT (attrarr != NULL && valarr != NULL);
+  if (nbattrs > RPS_MAX_NB_ATTRS)
+    RPS_FATAL ("too many attributes %u to put", nbattrs);
+  pthread_mutex_lock (&obj->ob_mtx);
+  for (unsigned ix = 0; ix < nbattrs; ix++)
+    if (attrarr[ix] && valarr[ix] != RPS_NULL_VALUE
+	&& rps_locked_object_put_special_attribute (obj, attrarr[ix],
+						    valarr[ix]))
+      nbspecial++;
+  if (nbspecial == 0)
+    nbput = rps_locked_object_put_attributes (obj, nbattrs, attrarr, valarr);
+  else if (nbspecial < nbattrs)
     {
-      if (rps_value_type (val) == RPS_TYPE_OBJECT)
-	{
-	  /// need an test that the value has some payload...
-	  obj->ob_class = (RpsObject_t *) val;
-	}
-      goto end;
+      /// rare case, filter out the special attributes
+      RpsObject_t **ordattrarr =
+	RPS_ALLOC_ZEROED ((nbattrs - nbspecial) * sizeof (RpsObject_t *));
+      RpsValue_t *ordvalarr =
+	RPS_ALLOC_ZEROED ((nbattrs - nbspecial) * sizeof (RpsValue_t));
+      unsigned nbord = 0;
+      RpsValue_t dummy = RPS_NULL_VALUE;
+      for (unsigned ix = 0; ix < nbattrs; ix++)
+	if (!attrarr[ix] || valarr[ix] == RPS_NULL_VALUE
+	    || !rps_locked_object_get_special_attribute (obj, attrarr[ix],
+							 &dummy))
+	  {
+	    RPS_ASSERT (nbord < nbattrs - nbspecial);
+	    ordattrarr[nbord] = attrarr[ix];
+	    ordvalarr[nbord] = valarr[ix];
+	    nbord++;
+	  };
+      nbput =
+	rps_locked_object_put_attributes (obj, nbord, ordattrarr, ordvalarr);
+      free (ordattrarr);
+      free (ordvalarr);
     };
-  if (obattr == RPS_ROOT_OB (_2i66FFjmS7n03HNNBx)	//space∈class
-      || obattr == RPS_ROOT_OB (_9uwZtDshW4401x6MsY)	//space∈symbol
-    )
-    {
-      if (rps_value_type (val) == RPS_TYPE_OBJECT)
-	{
-	  /// need an test that the value has some payload...
-	  obj->ob_space = (RpsObject_t *) val;
-	}
-      goto end;
-    }
-  obj->ob_attrtable = rps_attr_table_put (obj->ob_attrtable, obattr, val);
-end:
   pthread_mutex_unlock (&obj->ob_mtx);
-}				/* end rps_put_object_attribute */
+  return nbput + nbspecial;
+}				/* end rps_object_put_attributes */
 
-void
-rps_object_reserve_components (RpsObject_t * obj, unsigned nbcomp)
+/* Grow the component array of a locked object, if needed, to hold
+   NBCOMP components.  The growth is geometric, so appending one
+   component at a time is amortized constant time. */
+static void
+rps_locked_object_reserve_components (RpsObject_t * obj, unsigned nbcomp)
 {
-  if (!obj)
-    return;
   if (nbcomp > RPS_MAX_NB_OBJECT_COMPONENTS)
     {
       char obidbuf[32];
@@ -164,7 +288,6 @@ rps_object_reserve_components (RpsObject_t * obj, unsigned nbcomp)
       rps_oid_to_cbuf (obj->ob_id, obidbuf);
       RPS_FATAL ("too many components %u for object %s", nbcomp, obidbuf);
     };
-  pthread_mutex_lock (&obj->ob_mtx);
   unsigned oldnbcomp = obj->ob_nbcomp;
   unsigned oldcompsize = obj->ob_compsize;
   RPS_ASSERT (oldnbcomp <= oldcompsize);
@@ -180,16 +303,204 @@ rps_object_reserve_components (RpsObject_t * obj, unsigned nbcomp)
 			nbcomp, newcompsize, oldcompsize);
       RpsValue_t *newcomparr =
 	RPS_ALLOC_ZEROED (sizeof (RpsValue_t) * newcompsize);
-      for (unsigned ix = 0; ix < oldnbcomp; ix++)
-	newcomparr[ix] = obj->ob_comparr[ix];
+      if (oldnbcomp > 0)
+	memcpy (newcomparr, obj->ob_comparr, oldnbcomp * sizeof (RpsValue_t));
       free (obj->ob_comparr);
       obj->ob_comparr = newcomparr;
       obj->ob_compsize = newcompsize;
     }
-end:
+}				/* end rps_locked_object_reserve_components */
+
+void
+rps_object_reserve_components (RpsObject_t * obj, unsigned nbcomp)
+{
+  if (!obj)
+    return;
+  pthread_mutex_lock (&obj->ob_mtx);
+  rps_locked_object_reserve_components (obj, nbcomp);
   pthread_mutex_unlock (&obj->ob_mtx);
 }				/* end rps_object_reserve_components */
 
+void
+rps_locked_object_append_component (RpsObject_t * obj, RpsValue_t val)
+{
+  RPS_ASSERT (obj != NULL);
+  unsigned nbc = obj->ob_nbcomp;
+  if (nbc + 1 >= obj->ob_compsize)
+    rps_locked_object_reserve_components (obj, nbc + 1);
+  rps_locked_object_touch (obj);
+  rps_trigram_note_value (obj, val);
+  obj->ob_comparr[nbc] = val;
+  obj->ob_nbcomp = nbc + 1;
+}				/* end rps_locked_object_append_component */
+
+bool
+rps_locked_object_put_component (RpsObject_t * obj, int ix, RpsValue_t val)
+{
+  RPS_ASSERT (obj != NULL);
+  unsigned nbc = obj->ob_nbcomp;
+  if (ix < 0)
+    ix += (int) nbc;
+  if (ix < 0 || ix >= (int) nbc)
+    return false;
+  rps_locked_object_touch (obj);
+  rps_trigram_note_value (obj, val);
+  obj->ob_comparr[ix] = val;
+  return true;
+}				/* end rps_locked_object_put_component */
+
+void
+rps_object_append_component (RpsObject_t * obj, RpsValue_t val)
+{
+  if (!obj)
+    return;
+  RPS_ASSERT (rps_is_valid_object (obj));
+  pthread_mutex_lock (&obj->ob_mtx);
+  rps_locked_object_append_component (obj, val);
+  pthread_mutex_unlock (&obj->ob_mtx);
+}				/* end rps_object_append_component */
+
+unsigned
+rps_object_append_components (RpsObject_t * obj, unsigned nbval,
+			      const RpsValue_t * valarr)
+{
+  if (!obj)
+    return 0;
+  RPS_ASSERT (rps_is_valid_object (obj));
+  pthread_mutex_lock (&obj->ob_mtx);
+  unsigned nbc = obj->ob_nbcomp;
+  if (nbval > 0 && valarr)
+    {
+      if (nbval > RPS_MAX_NB_OBJECT_COMPONENTS)
+	RPS_FATAL ("too many %u components to append", nbval);
+      rps_locked_object_reserve_components (obj, nbc + nbval);
+      rps_locked_object_touch (obj);
+      for (unsigned ix = 0; ix < nbval; ix++)
+	rps_trigram_note_value (obj, valarr[ix]);
+      memcpy (obj->ob_comparr + nbc, valarr, nbval * sizeof (RpsValue_t));
+      nbc += nbval;
+      obj->ob_nbcomp = nbc;
+    };
+  pthread_mutex_unlock (&obj->ob_mtx);
+  return nbc;
+}				/* end rps_object_append_components */
+
+unsigned
+rps_object_append_tuple_components (RpsObject_t * obj,
+				    const RpsTupleOb_t * tup)
+{
+  if (!obj)
+    return 0;
+  RPS_ASSERT (rps_is_valid_object (obj));
+  unsigned arity = rps_vtuple_size (tup);
+  pthread_mutex_lock (&obj->ob_mtx);
+  unsigned nbc = obj->ob_nbcomp;
+  if (arity > 0)
+    {
+      rps_locked_object_reserve_components (obj, nbc + arity);
+      rps_locked_object_touch (obj);
+      /// object pointers are values, the tuple is immutable
+      for (unsigned ix = 0; ix < arity; ix++)
+	obj->ob_comparr[nbc + ix] = (RpsValue_t) tup->tuple_comp[ix];
+      nbc += arity;
+      obj->ob_nbcomp = nbc;
+    };
+  pthread_mutex_unlock (&obj->ob_mtx);
+  return nbc;
+}				/* end rps_object_append_tuple_components */
+
+const RpsTupleOb_t *
+rps_object_components_slice_to_tuple (RpsObject_t * obj, int lo, int hi)
+{
+  if (!obj)
+    return NULL;
+  RPS_ASSERT (rps_is_valid_object (obj));
+  pthread_mutex_lock (&obj->ob_mtx);
+  int nbc = (int) obj->ob_nbcomp;
+  if (lo < 0)
+    lo += nbc;
+  if (hi < 0)
+    hi += nbc;
+  if (lo < 0)
+    lo = 0;
+  if (hi > nbc)
+    hi = nbc;
+  unsigned arity = (hi > lo) ? (unsigned) (hi - lo) : 0;
+  RpsObject_t **obarr =
+    RPS_ALLOC_ZEROED ((arity + 1) * sizeof (RpsObject_t *));
+  for (unsigned ix = 0; ix < arity; ix++)
+    {
+      RpsValue_t curval = obj->ob_comparr[lo + ix];
+      if (rps_value_type (curval) == RPS_TYPE_OBJECT)
+	obarr[ix] = (RpsObject_t *) curval;
+    };
+  pthread_mutex_unlock (&obj->ob_mtx);
+  const RpsTupleOb_t *tup = rps_alloc_tuple_sized (arity, obarr);
+  free (obarr);
+  return tup;
+}				/* end rps_object_components_slice_to_tuple */
+
+bool
+rps_object_splice_components (RpsObject_t * obj, int pos, unsigned nbdel,
+			      unsigned nbins, const RpsValue_t * insarr)
+{
+  bool ok = false;
+  if (!obj)
+    return false;
+  RPS_ASSERT (rps_is_valid_object (obj));
+  if (nbins > RPS_MAX_NB_OBJECT_COMPONENTS)
+    return false;
+  if (nbins > 0 && !insarr)
+    return false;
+  pthread_mutex_lock (&obj->ob_mtx);
+  unsigned nbc = obj->ob_nbcomp;
+  if (pos < 0)
+    pos += (int) nbc;
+  if (pos < 0 || pos > (int) nbc)
+    goto end;
+  if (nbdel > nbc - (unsigned) pos)
+    nbdel = nbc - (unsigned) pos;
+  unsigned newnbc = nbc - nbdel + nbins;
+  if (newnbc > nbc)
+    rps_locked_object_reserve_components (obj, newnbc);
+  unsigned nbtail = nbc - (unsigned) pos - nbdel;
+  rps_locked_object_touch (obj);
+  if (nbtail > 0 && nbins != nbdel)
+    memmove (obj->ob_comparr + pos + nbins, obj->ob_comparr + pos + nbdel,
+	     nbtail * sizeof (RpsValue_t));
+  for (unsigned ix = 0; ix < nbins; ix++)
+    rps_trigram_note_value (obj, insarr[ix]);
+  if (nbins > 0)
+    memcpy (obj->ob_comparr + pos, insarr, nbins * sizeof (RpsValue_t));
+  if (newnbc < nbc)
+    memset (obj->ob_comparr + newnbc, 0,
+	    (nbc - newnbc) * sizeof (RpsValue_t));
+  obj->ob_nbcomp = newnbc;
+  ok = true;
+end:
+  pthread_mutex_unlock (&obj->ob_mtx);
+  return ok;
+}				/* end rps_object_splice_components */
+
+void
+rps_object_truncate_components (RpsObject_t * obj, unsigned nbcomp)
+{
+  if (!obj)
+    return;
+  RPS_ASSERT (rps_is_valid_object (obj));
+  pthread_mutex_lock (&obj->ob_mtx);
+  unsigned nbc = obj->ob_nbcomp;
+  if (nbcomp < nbc)
+    {
+      rps_locked_object_touch (obj);
+      /// clear the removed components, for the garbage collector
+      memset (obj->ob_comparr + nbcomp, 0,
+	      (nbc - nbcomp) * sizeof (RpsValue_t));
+      obj->ob_nbcomp = nbcomp;
+    };
+  pthread_mutex_unlock (&obj->ob_mtx);
+}				/* end rps_object_truncate_components */
+
 void *
 rps_get_object_payload_of_type (RpsObject_t * obj, int paylty)
 {
@@ -229,6 +540,32 @@ rps_object_less (RpsObject_t * ob1, RpsObject_t * ob2)
   return rps_oid_less_than (ob1->ob_id, ob2->ob_id);
 }
 
+/*****************************************************************
+ * Attribute tables have two representations, depending upon their
+ * allocated prime size.  Small tables, of size not above
+ * RPS_ATTR_TABLE_SMALL_SIZE, keep their entries unsorted and packed
+ * at the start of attr_entries, and are scanned by pointer equality.
+ * Larger tables are open-addressed hash tables on the zv_hash of
+ * attributes, with linear probing and backward shift deletion, so
+ * they never contain tombstones.  Both are searched without looking
+ * into the oid of attributes; sorted order is only computed when
+ * needed, e.g. for dumping, by rps_attr_table_set_of_attributes.
+ *****************************************************************/
+
+static inline unsigned
+rps_attr_table_capacity (const RpsAttrTable_t * tbl)
+{
+  return (unsigned) rps_prime_of_index (tbl->zm_xtra);
+}				/* end rps_attr_table_capacity */
+
+static inline bool
+rps_attr_table_is_small (const RpsAttrTable_t * tbl)
+{
+  return rps_attr_table_capacity (tbl) <= RPS_ATTR_TABLE_SMALL_SIZE;
+}				/* end rps_attr_table_is_small */
+
+/* Allocate an empty table able to hold SIZE attributes without being
+   reallocated. */
 RpsAttrTable_t *
 rps_alloc_empty_attr_table (unsigned size)
 {
@@ -237,7 +574,12 @@ rps_alloc_empty_attr_table (unsigned size)
   int primix = 0;
   if (size > RPS_MAX_NB_ATTRS)
     RPS_FATAL ("too big attribute table %u", size);
-  primsiz = rps_prime_above (size);
+  if (size < RPS_ATTR_TABLE_SMALL_SIZE)
+    /// the smallest prime not below size
+    primsiz = rps_prime_above ((size > 0) ? (size - 1) : 0);
+  else
+    /// an hashed table is kept less than three quarters full
+    primsiz = rps_prime_above (size + size / 2 + 1);
   RPS_ASSERT (primsiz > 0);
   primix = rps_index_of_prime (primsiz);
   RPS_ASSERT (primix >= 0 && primix < 256);
@@ -252,6 +594,36 @@ rps_alloc_empty_attr_table (unsigned size)
 }				/* end rps_alloc_empty_attr_table */
 
 
+/* Return the index of the entry for OBATTR, or -1 if absent. */
+static int
+rps_attr_table_index (const RpsAttrTable_t * tbl, const RpsObject_t * obattr)
+{
+  unsigned tbllen = tbl->zm_length;
+  if (tbllen == 0)
+    return -1;
+  if (rps_attr_table_is_small (tbl))
+    {
+      for (unsigned ix = 0; ix < tbllen; ix++)
+	if (tbl->attr_entries[ix].ent_attr == obattr)
+	  return (int) ix;
+      return -1;
+    };
+  unsigned tblsiz = rps_attr_table_capacity (tbl);
+  unsigned ix = obattr->zv_hash % tblsiz;
+  for (unsigned cnt = 0; cnt < tblsiz; cnt++)
+    {
+      const RpsObject_t *curattr = tbl->attr_entries[ix].ent_attr;
+      if (curattr == obattr)
+	return (int) ix;
+      if (curattr == NULL)
+	return -1;
+      if (++ix >= tblsiz)
+	ix = 0;
+    };
+  return -1;
+}				/* end rps_attr_table_index */
+
+
 RpsValue_t
 rps_attr_table_find (const RpsAttrTable_t * tbl, RpsObject_t * obattr)
 {
@@ -261,91 +633,89 @@ rps_attr_table_find (const RpsAttrTable_t * tbl, RpsObject_t * obattr)
     return RPS_NULL_VALUE;
   if (!rps_is_valid_object (obattr))
     return RPS_NULL_VALUE;
-  intptr_t tblsiz = rps_prime_of_index (tbl->zm_xtra);
-  unsigned tbllen = tbl->zm_length;
-  int lo = 0, hi = (int) tbllen - 1;
-  while (lo + 4 < hi)
-    {
-      int mi = (lo + hi) / 2;
-      RpsObject_t *curattr = tbl->attr_entries[mi].ent_attr;
-      RpsValue_t curval = tbl->attr_entries[mi].ent_val;
-      if (curattr == obattr)
-	return curval;
-      else if (rps_object_less (curattr, obattr))
-	lo = mi;
-      else
-	hi = mi;
-    };
-  for (int mi = lo; mi <= hi; mi++)
-    {
-      RpsObject_t *curattr = tbl->attr_entries[mi].ent_attr;
-      RpsValue_t curval = tbl->attr_entries[mi].ent_val;
-      if (curattr == obattr)
-	return curval;
-    }
-  return RPS_NULL_VALUE;
+  int ix = rps_attr_table_index (tbl, obattr);
+  if (ix < 0)
+    return RPS_NULL_VALUE;
+  return tbl->attr_entries[ix].ent_val;
 }				/* end rps_attr_table_find */
 
 
-/* internal routine to put or insert an entry ... Return true if successful */
+/* internal routine to put or insert an entry ... Return true if
+   successful, false if the table is too full and should be grown */
 static bool
 rps_attr_table_entry_put (RpsAttrTable_t * tbl, RpsObject_t * obattr,
 			  RpsValue_t val)
 {
   RPS_ASSERT (tbl != NULL);
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
-  intptr_t tblsiz = rps_prime_of_index (tbl->zm_xtra);
+  unsigned tblsiz = rps_attr_table_capacity (tbl);
   unsigned tbllen = tbl->zm_length;
   RPS_ASSERT (obattr != NULL);
   RPS_ASSERT (val != RPS_NULL_VALUE);
-  RPS_ASSERT (tbllen < tblsiz);
-  if (tbllen == 0)
+  RPS_ASSERT (tbllen <= tblsiz);
+  if (rps_attr_table_is_small (tbl))
     {
-      tbl->attr_entries[0].ent_attr = obattr;
-      tbl->attr_entries[0].ent_val = val;
-      tbl->zm_length = 1;
+      for (unsigned ix = 0; ix < tbllen; ix++)
+	if (tbl->attr_entries[ix].ent_attr == obattr)
+	  {
+	    tbl->attr_entries[ix].ent_val = val;
+	    return true;
+	  };
+      if (tbllen >= tblsiz)
+	return false;
+      tbl->attr_entries[tbllen].ent_attr = obattr;
+      tbl->attr_entries[tbllen].ent_val = val;
+      tbl->zm_length = tbllen + 1;
       return true;
     };
-  int lo = 0, hi = (int) tbllen - 1;
-  while (lo + 4 < hi)
-    {
-      int mi = (lo + hi) / 2;
-      RpsObject_t *curattr = tbl->attr_entries[mi].ent_attr;
-      if (curattr == obattr)
-	{
-	  tbl->attr_entries[mi].ent_val = val;
-	  return true;
-	}
-      else if (rps_object_less (curattr, obattr))
-	lo = mi;
-      else
-	hi = mi;
-    };
-  RPS_ASSERT (tbllen < tblsiz);
-  for (int ix = lo; ix <= hi; ix++)
+  unsigned ix = obattr->zv_hash % tblsiz;
+  for (unsigned cnt = 0; cnt < tblsiz; cnt++)
     {
       RpsObject_t *curattr = tbl->attr_entries[ix].ent_attr;
       if (curattr == obattr)
 	{
 	  tbl->attr_entries[ix].ent_val = val;
-	  RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
 	  return true;
-	}
-      else if (rps_object_less (curattr, obattr))
+	};
+      if (curattr == NULL)
 	{
-	  memmove (tbl->attr_entries + ix, tbl->attr_entries + ix + 1,
-		   (tbllen - ix) * sizeof (struct rps_attrentry_st));
+	  /// keep the hashed table less than three quarters full
+	  if (4 * (tbllen + 1) > 3 * tblsiz)
+	    return false;
 	  tbl->attr_entries[ix].ent_attr = obattr;
 	  tbl->attr_entries[ix].ent_val = val;
 	  tbl->zm_length = tbllen + 1;
-	  RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
 	  return true;
-	}
-    }
-  RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
+	};
+      if (++ix >= tblsiz)
+	ix = 0;
+    };
   return false;
 }				/* end rps_attr_table_entry_put */
 
+
+/* Allocate a new table for NEWSIZE attributes with all the entries
+   of OLD_TBL */
+static RpsAttrTable_t *
+rps_attr_table_copy_resized (const RpsAttrTable_t * old_tbl, unsigned newsize)
+{
+  RpsAttrTable_t *new_tbl = rps_alloc_empty_attr_table (newsize);
+  unsigned oldtblsiz = rps_attr_table_capacity (old_tbl);
+  RPS_ASSERT (newsize >= old_tbl->zm_length);
+  for (unsigned ix = 0; ix < oldtblsiz; ix++)
+    {
+      RpsObject_t *curattr = old_tbl->attr_entries[ix].ent_attr;
+      if (curattr == NULL)
+	continue;
+      if (!rps_attr_table_entry_put (new_tbl, curattr,
+				     old_tbl->attr_entries[ix].ent_val))
+	RPS_FATAL ("corrupted resized attribute table @%p", new_tbl);
+    };
+  RPS_ASSERT (new_tbl->zm_length == old_tbl->zm_length);
+  return new_tbl;
+}				/* end rps_attr_table_copy_resized */
+
+
 RpsAttrTable_t *
 rps_attr_table_put (RpsAttrTable_t * tbl, RpsObject_t * obattr,
 		    RpsValue_t val)
@@ -355,28 +725,41 @@ rps_attr_table_put (RpsAttrTable_t * tbl, RpsObject_t * obattr,
   if (!val)
     return tbl;
   if (!tbl)
-    tbl = rps_alloc_empty_attr_table (2);
+    tbl = rps_alloc_empty_attr_table (1);
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
   if (rps_attr_table_entry_put (tbl, obattr, val))
     return tbl;
-  RpsAttrTable_t *old_tbl = tbl;
-  intptr_t oldtblsiz = rps_prime_of_index (old_tbl->zm_xtra);
-  unsigned oldtbllen = old_tbl->zm_length;
+  unsigned oldtbllen = tbl->zm_length;
   RpsAttrTable_t *new_tbl =
-    rps_alloc_empty_attr_table (oldtbllen + 2 + oldtblsiz / 5);
-  RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (new_tbl) == -RpsPyt_AttrTable);
-  memcpy (new_tbl->attr_entries, old_tbl->attr_entries,
-	  oldtbllen * sizeof (struct rps_attrentry_st));
-  new_tbl->zm_length = oldtbllen;
+    rps_attr_table_copy_resized (tbl, oldtbllen + 2 + oldtbllen / 2);
   // the test below should always succeed!
   if (!rps_attr_table_entry_put (new_tbl, obattr, val))
     RPS_FATAL ("corruption in rps_attr_table_put for new_tbl @%p", new_tbl);
-  /// we don't free the old_tbl, it will be garbage collected...
+  /// we don't free the old table, it will be garbage collected...
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (new_tbl) == -RpsPyt_AttrTable);
   return new_tbl;
 }				/* end rps_attr_table_put */
 
 
+/* Return TBL if it has room for NBEXTRA more attributes, otherwise a
+   bigger copy of it */
+RpsAttrTable_t *
+rps_attr_table_reserve (RpsAttrTable_t * tbl, unsigned nbextra)
+{
+  if (!tbl)
+    return rps_alloc_empty_attr_table (nbextra);
+  RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
+  unsigned tblsiz = rps_attr_table_capacity (tbl);
+  unsigned wantlen = tbl->zm_length + nbextra;
+  if (wantlen > RPS_MAX_NB_ATTRS)
+    RPS_FATAL ("too big attribute table %u", wantlen);
+  if (rps_attr_table_is_small (tbl) ? (wantlen <= tblsiz)
+      : (4 * wantlen <= 3 * tblsiz))
+    return tbl;
+  return rps_attr_table_copy_resized (tbl, wantlen);
+}				/* end rps_attr_table_reserve */
+
+
 RpsAttrTable_t *
 rps_attr_table_remove (RpsAttrTable_t * tbl, RpsObject_t * obattr)
 {
@@ -385,74 +768,54 @@ rps_attr_table_remove (RpsAttrTable_t * tbl, RpsObject_t * obattr)
   if (!tbl)
     return NULL;
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
-  RpsAttrTable_t *old_tbl = tbl;
-  int oldprimix = old_tbl->zm_xtra;
-  intptr_t oldtblsiz = rps_prime_of_index (oldprimix);
-  unsigned oldtbllen = old_tbl->zm_length;
-  int pos = -1;
-  int lo = 0, hi = (int) oldtbllen - 1;
-  while (lo < hi + 4)
-    {
-      int mi = (lo + hi) / 2;
-      RpsObject_t *curattr = old_tbl->attr_entries[mi].ent_attr;
-      if (curattr == obattr)
-	{
-	  pos = mi;
-	  break;
-	}
-      else if (rps_object_less (curattr, obattr))
-	lo = mi;
-      else
-	hi = mi;
-    };
-  if (pos < 0)
-    for (int ix = lo; ix <= hi; ix++)
-      {
-	RpsObject_t *curattr = old_tbl->attr_entries[ix].ent_attr;
-	if (curattr == obattr)
-	  {
-	    pos = ix;
-	    break;
-	  }
-      };
+  int pos = rps_attr_table_index (tbl, obattr);
   if (pos < 0)			/* not found */
+    return tbl;
+  unsigned tblsiz = rps_attr_table_capacity (tbl);
+  unsigned tbllen = tbl->zm_length;
+  if (rps_attr_table_is_small (tbl))
     {
-      RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (old_tbl) == -RpsPyt_AttrTable);
-      return old_tbl;
-    }
-  if (oldtblsiz > 6 && oldtbllen < oldtblsiz / 2)
-    {
-      /* perhaps shrink the table */
-      int newprimsiz = rps_prime_above (oldtbllen - 1);
-      RPS_ASSERT (newprimsiz > 0);
-      int newprimix = rps_index_of_prime (newprimsiz);
-      RPS_ASSERT (newprimix >= 0 && newprimix < 256);
-      if (newprimix < oldprimix)
+      /* move the last entry into the hole */
+      tbl->attr_entries[pos] = tbl->attr_entries[tbllen - 1];
+      tbl->attr_entries[tbllen - 1].ent_attr = NULL;
+      tbl->attr_entries[tbllen - 1].ent_val = RPS_NULL_VALUE;
+      tbl->zm_length = tbllen - 1;
+      return tbl;
+    };
+  /* backward shift deletion: move back the following entries of the
+     same probe sequence into the hole */
+  unsigned hole = (unsigned) pos;
+  unsigned ix = hole;
+  for (;;)
+    {
+      if (++ix >= tblsiz)
+	ix = 0;
+      RpsObject_t *curattr = tbl->attr_entries[ix].ent_attr;
+      if (curattr == NULL)
+	break;
+      unsigned home = curattr->zv_hash % tblsiz;
+      /* can the entry at ix move to the hole, i.e. is its home slot
+         cyclically outside of ]hole, ix] ? */
+      bool movable = (hole <= ix) ? (home <= hole || home > ix)
+	: (home <= hole && home > ix);
+      if (movable)
 	{
-	  RpsAttrTable_t *new_tbl =
-	    RPS_ALLOC_ZONE (sizeof (RpsAttrTable_t) +
-			    (newprimsiz * sizeof (struct rps_attrentry_st)),
-			    -RpsPyt_AttrTable);
-	  new_tbl->zm_xtra = newprimix;
-	  new_tbl->zm_length = 0;
-	  for (int ix = 0; ix < pos; ix++)
-	    new_tbl->attr_entries[ix] = old_tbl->attr_entries[ix];
-	  for (int ix = pos + 1; ix < oldtbllen; ix++)
-	    new_tbl->attr_entries[ix] = old_tbl->attr_entries[ix - 1];
-	  new_tbl->zm_length = oldtbllen - 1;
-	  //// we don't free the old_tbl, it will be later garbage collected      
-	  RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (new_tbl) == -RpsPyt_AttrTable);
-	  return new_tbl;
+	  tbl->attr_entries[hole] = tbl->attr_entries[ix];
+	  hole = ix;
 	}
     };
-  /* don't shrink, but remove entry at pos and shift entries above it */
-  for (int ix = pos + 1; ix < oldtbllen; ix++)
-    old_tbl->attr_entries[ix] = old_tbl->attr_entries[ix - 1];
-  old_tbl->attr_entries[oldtbllen - 1].ent_attr = NULL;
-  old_tbl->attr_entries[oldtbllen - 1].ent_val = RPS_NULL_VALUE;
-  old_tbl->zm_length = oldtbllen - 1;
-  RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (old_tbl) == -RpsPyt_AttrTable);
-  return old_tbl;
+  tbl->attr_entries[hole].ent_attr = NULL;
+  tbl->attr_entries[hole].ent_val = RPS_NULL_VALUE;
+  tbl->zm_length = --tbllen;
+  /* shrink a quite empty hashed table */
+  if (4 * tbllen < tblsiz)
+    {
+      RpsAttrTable_t *new_tbl = rps_attr_table_copy_resized (tbl, tbllen);
+      //// we don't free the old table, it will be later garbage collected
+      RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (new_tbl) == -RpsPyt_AttrTable);
+      return new_tbl;
+    };
+  return tbl;
 }				/* end rps_attr_table_remove */
 
 
@@ -473,13 +836,11 @@ rps_attr_table_iterate (const RpsAttrTable_t * tbl,
   if (!tbl)
     return 0;
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
-  unsigned tsiz = rps_attr_table_size (tbl);
-  int cnt = 0;
+  unsigned tsiz = rps_attr_table_capacity (tbl);
   unsigned nbiter = 0;
   for (int eix = 0; eix < (int) tsiz; eix++)
     {
-      if (tbl->attr_entries[eix].ent_attr != (RpsObject_t *) NULL
-	  && tbl->attr_entries[eix].ent_attr != RPS_HTB_EMPTY_SLOT)
+      if (tbl->attr_entries[eix].ent_attr != (RpsObject_t *) NULL)
 	{
 	  if (routattr)
 	    if (!(*routattr) (tbl->attr_entries[eix].ent_attr, data))
@@ -504,13 +865,11 @@ rps_attr_table_dump_scan (RpsDumper_t * du, const RpsAttrTable_t * tbl,
   if (!tbl)
     return 0;
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
-  unsigned tsiz = rps_attr_table_size (tbl);
-  int cnt = 0;
+  unsigned tsiz = rps_attr_table_capacity (tbl);
   unsigned nbiter = 0;
   for (int eix = 0; eix < (int) tsiz; eix++)
     {
-      if (tbl->attr_entries[eix].ent_attr != (RpsObject_t *) NULL
-	  && tbl->attr_entries[eix].ent_attr != RPS_HTB_EMPTY_SLOT)
+      if (tbl->attr_entries[eix].ent_attr != (RpsObject_t *) NULL)
 	{
 	  rps_dumper_scan_object (du, tbl->attr_entries[eix].ent_attr);
 	  rps_dumper_scan_value (du, tbl->attr_entries[eix].ent_val,
@@ -522,23 +881,25 @@ rps_attr_table_dump_scan (RpsDumper_t * du, const RpsAttrTable_t * tbl,
   return nbiter;
 }				/* end rps_attr_table_dump_scan */
 
+/* The set of attributes is sorted by oid, so this is how the dumper
+   gets them in a reproducible order */
 const RpsSetOb_t *
 rps_attr_table_set_of_attributes (const RpsAttrTable_t * tbl)
 {
-  RpsSetOb_t *setv = NULL;
+  const RpsSetOb_t *setv = NULL;
   if (!tbl)
     return NULL;
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
-  unsigned tsiz = rps_attr_table_size (tbl);
+  unsigned tsiz = rps_attr_table_capacity (tbl);
   const RpsObject_t **obarr =
-    RPS_ALLOC_ZEROED ((tsiz + 1) * sizeof (RpsObject_t *));
+    RPS_ALLOC_ZEROED ((tbl->zm_length + 1) * sizeof (RpsObject_t *));
   int cnt = 0;
   for (int eix = 0; eix < (int) tsiz; eix++)
     {
-      if (tbl->attr_entries[eix].ent_attr != (RpsObject_t *) NULL
-	  && tbl->attr_entries[eix].ent_attr != RPS_HTB_EMPTY_SLOT)
+      if (tbl->attr_entries[eix].ent_attr != (RpsObject_t *) NULL)
 	obarr[cnt++] = tbl->attr_entries[eix].ent_attr;
     };
+  RPS_ASSERT (cnt == (int) tbl->zm_length);
   setv = rps_alloc_set_sized (cnt, obarr);
   free (obarr);
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (tbl) == -RpsPyt_AttrTable);
@@ -618,6 +979,10 @@ rps_initialize_objects_machinery (void)
 }				/* end rps_initialize_objects_machinery */
 
 
+/* This only checks the buckets themselves, not their objects, and is
+   called by rps_add_object_to_locked_bucket while holding a bucket
+   mutex; so it stays serial and does not use the pool of
+   rps_parallel_for_each_object, whose threads would block on it. */
 void
 rps_check_all_objects_buckets_are_valid (void)
 {
@@ -719,6 +1084,92 @@ rps_object_array_qsort (const RpsObject_t ** arr, int size)
 }				/* end rps_object_array_qsort */
 
 
+/*****************************************************************
+ * Locking several objects without deadlocks: objects are always
+ * locked by increasing oids.  When not compiled with NDEBUG, every
+ * thread remembers the objects it locked with rps_lock_objects, and
+ * checks that any further call locks only objects of bigger oids,
+ * and that unlocking is done in reverse order.
+ *****************************************************************/
+#ifndef NDEBUG
+#define RPS_LOCKORDER_MAX_HELD (4*RPS_MAX_LOCKED_OBJECTS)
+static _Thread_local RpsObject_t *rps_lockorder_held[RPS_LOCKORDER_MAX_HELD];
+static _Thread_local unsigned rps_lockorder_nbheld;
+#endif /*NDEBUG*/
+
+unsigned
+rps_lock_objects (unsigned nbob, RpsObject_t ** obarr)
+{
+  if (nbob == 0 || !obarr)
+    return 0;
+  if (nbob > RPS_MAX_LOCKED_OBJECTS)
+    RPS_FATAL ("too many %u objects to lock", nbob);
+  rps_object_array_qsort ((const RpsObject_t **) obarr, (int) nbob);
+  /// remove duplicates and null pointers, sorted first
+  unsigned nbuniq = 0;
+  for (unsigned ix = 0; ix < nbob; ix++)
+    {
+      RpsObject_t *curob = obarr[ix];
+      if (!curob || (nbuniq > 0 && obarr[nbuniq - 1] == curob))
+	continue;
+      RPS_ASSERT (rps_is_valid_object (curob));
+      obarr[nbuniq++] = curob;
+    };
+  for (unsigned ix = nbuniq; ix < nbob; ix++)
+    obarr[ix] = NULL;
+#ifndef NDEBUG
+  if (nbuniq > 0 && rps_lockorder_nbheld > 0)
+    {
+      RpsObject_t *lastheld = rps_lockorder_held[rps_lockorder_nbheld - 1];
+      if (rps_object_cmp (lastheld, obarr[0]) >= 0)
+	{
+	  char lastbuf[32], firstbuf[32];
+	  memset (lastbuf, 0, sizeof (lastbuf));
+	  memset (firstbuf, 0, sizeof (firstbuf));
+	  rps_oid_to_cbuf (lastheld->ob_id, lastbuf);
+	  rps_oid_to_cbuf (obarr[0]->ob_id, firstbuf);
+	  RPS_FATAL ("lock order violation: locking %s while holding %s",
+		     firstbuf, lastbuf);
+	}
+    };
+  if (rps_lockorder_nbheld + nbuniq > RPS_LOCKORDER_MAX_HELD)
+    RPS_FATAL ("too many %u objects locked by thread",
+	       rps_lockorder_nbheld + nbuniq);
+#endif /*NDEBUG*/
+  for (unsigned ix = 0; ix < nbuniq; ix++)
+    {
+      int err = pthread_mutex_lock (&obarr[ix]->ob_mtx);
+      if (err)
+	RPS_FATAL ("failed to lock object #%u of %u: %s", ix, nbuniq,
+		   strerror (err));
+#ifndef NDEBUG
+      rps_lockorder_held[rps_lockorder_nbheld++] = obarr[ix];
+#endif /*NDEBUG*/
+    };
+  return nbuniq;
+}				/* end rps_lock_objects */
+
+void
+rps_unlock_objects (unsigned nbob, RpsObject_t ** obarr)
+{
+  if (nbob == 0 || !obarr)
+    return;
+  for (int ix = (int) nbob - 1; ix >= 0; ix--)
+    {
+      RpsObject_t *curob = obarr[ix];
+      if (!curob)
+	continue;
+#ifndef NDEBUG
+      if (rps_lockorder_nbheld == 0
+	  || rps_lockorder_held[rps_lockorder_nbheld - 1] != curob)
+	RPS_FATAL ("objects unlocked out of order, #%d of %u", ix, nbob);
+      rps_lockorder_held[--rps_lockorder_nbheld] = NULL;
+#endif /*NDEBUG*/
+      pthread_mutex_unlock (&curob->ob_mtx);
+    };
+}				/* end rps_unlock_objects */
+
+
 RpsObject_t *
 rps_find_object_by_oid (const RpsOid oid)
 {
@@ -894,82 +1345,721 @@ rps_add_object_to_locked_bucket (struct rps_object_bucket_st *buck,
   unsigned stix = (obj->ob_id.id_hi ^ obj->ob_id.id_lo) % cbucksiz;
   for (int ix = stix; ix < (int) cbucksiz; ix++)
     {
-      RpsObject_t *curob = buck->obuck_arr[ix];
-      if (NULL == curob)
+      RpsObject_t *curob = buck->obuck_arr[ix];
+      if (NULL == curob)
+	{
+	  buck->obuck_arr[ix] = obj;
+	  buck->obuck_card++;
+	  RPS_ASSERTPRINTF (!rps_object_bucket_is_nearly_full (buck),
+			    "wrongly full bucket#%d of card %u capacity %u",
+			    buckix, buck->obuck_card, buck->obuck_capacity);
+	  return;
+	}
+      RPS_ASSERT (curob->ob_magic == RPS_OBJ_MAGIC);
+      if (curob == obj)
+	return;
+    };
+  for (int ix = 0; ix < (int) stix; ix++)
+    {
+      RpsObject_t *curob = buck->obuck_arr[ix];
+      if (NULL == curob)
+	{
+	  buck->obuck_arr[ix] = obj;
+	  buck->obuck_card++;
+	  RPS_ASSERTPRINTF (!rps_object_bucket_is_nearly_full (buck),
+			    "wrongly full bucket#%d of card %u size %u",
+			    buckix, buck->obuck_card, buck->obuck_capacity);
+	  return;
+	}
+      RPS_ASSERT (curob->ob_magic == RPS_OBJ_MAGIC);
+      if (curob == obj)
+	return;
+    };
+}				/* end rps_add_object_to_locked_bucket */
+
+
+/*****************************************************************
+ * Dense object indexes.  Every object gets at creation a small
+ * index, unique among live objects, so that sets of objects can be
+ * bit sets (see bitset_rps.c) instead of hash tables.  The index to
+ * object table is made of chunks which are never moved once
+ * allocated, so it is read without locking.  Indexes of freed
+ * objects are recycled, most recently released first.
+ *****************************************************************/
+#define RPS_OBJINDEX_CHUNK_SHIFT 16
+#define RPS_OBJINDEX_CHUNK_SIZE (1U << RPS_OBJINDEX_CHUNK_SHIFT)
+#define RPS_OBJINDEX_MAX_CHUNKS 4096
+struct rps_objindex_chunk_st
+{
+  RpsObject_t *_Atomic oic_objarr[RPS_OBJINDEX_CHUNK_SIZE];
+};
+static struct rps_objindex_chunk_st *_Atomic
+  rps_objindex_chunkarr[RPS_OBJINDEX_MAX_CHUNKS];
+static pthread_mutex_t rps_objindex_mtx = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint rps_objindex_bound = 1;	/* index 0 is unused */
+static uint32_t *rps_objindex_freearr;	/* stack of released indexes */
+static unsigned rps_objindex_freecount;
+static unsigned rps_objindex_freesize;
+
+static void
+rps_object_assign_index (RpsObject_t * obj)
+{
+  uint32_t ix = 0;
+  RPS_ASSERT (obj != NULL && obj->ob_index == 0);
+  pthread_mutex_lock (&rps_objindex_mtx);
+  if (rps_objindex_freecount > 0)
+    ix = rps_objindex_freearr[--rps_objindex_freecount];
+  else
+    {
+      ix = atomic_load (&rps_objindex_bound);
+      if (ix >= RPS_OBJINDEX_MAX_CHUNKS * RPS_OBJINDEX_CHUNK_SIZE)
+	RPS_FATAL ("too many objects, no more object index above %u", ix);
+      unsigned chix = ix >> RPS_OBJINDEX_CHUNK_SHIFT;
+      if (!atomic_load (&rps_objindex_chunkarr[chix]))
+	atomic_store (&rps_objindex_chunkarr[chix],
+		      RPS_ALLOC_ZEROED (sizeof
+					(struct rps_objindex_chunk_st)));
+      atomic_store (&rps_objindex_bound, ix + 1);
+    };
+  struct rps_objindex_chunk_st *chunk =
+    atomic_load (&rps_objindex_chunkarr[ix >> RPS_OBJINDEX_CHUNK_SHIFT]);
+  atomic_store (&chunk->oic_objarr[ix & (RPS_OBJINDEX_CHUNK_SIZE - 1)], obj);
+  obj->ob_index = ix;
+  pthread_mutex_unlock (&rps_objindex_mtx);
+}				/* end rps_object_assign_index */
+
+void
+rps_object_release_index (RpsObject_t * obj)
+{
+  if (!obj || obj->ob_index == 0)
+    return;
+  uint32_t ix = obj->ob_index;
+  rps_class_extent_change (obj, obj->ob_class, NULL);
+  pthread_mutex_lock (&rps_objindex_mtx);
+  struct rps_objindex_chunk_st *chunk =
+    atomic_load (&rps_objindex_chunkarr[ix >> RPS_OBJINDEX_CHUNK_SHIFT]);
+  RPS_ASSERT (chunk != NULL);
+  RPS_ASSERT (atomic_load
+	      (&chunk->oic_objarr[ix & (RPS_OBJINDEX_CHUNK_SIZE - 1)]) ==
+	      obj);
+  atomic_store (&chunk->oic_objarr[ix & (RPS_OBJINDEX_CHUNK_SIZE - 1)],
+		NULL);
+  if (rps_objindex_freecount >= rps_objindex_freesize)
+    {
+      unsigned newsiz = rps_prime_above (rps_objindex_freesize + 100
+					 + rps_objindex_freesize / 3);
+      uint32_t *newarr = RPS_ALLOC_ZEROED (newsiz * sizeof (uint32_t));
+      if (rps_objindex_freecount > 0)
+	memcpy (newarr, rps_objindex_freearr,
+		rps_objindex_freecount * sizeof (uint32_t));
+      free (rps_objindex_freearr);
+      rps_objindex_freearr = newarr;
+      rps_objindex_freesize = newsiz;
+    };
+  rps_objindex_freearr[rps_objindex_freecount++] = ix;
+  obj->ob_index = 0;
+  pthread_mutex_unlock (&rps_objindex_mtx);
+}				/* end rps_object_release_index */
+
+uint32_t
+rps_object_index (const RpsObject_t * ob)
+{
+  if (!ob || ob->ob_magic != RPS_OBJ_MAGIC)
+    return 0;
+  return ob->ob_index;
+}				/* end rps_object_index */
+
+RpsObject_t *
+rps_object_of_index (uint32_t ix)
+{
+  if (ix == 0 || ix >= atomic_load (&rps_objindex_bound))
+    return NULL;
+  struct rps_objindex_chunk_st *chunk =
+    atomic_load (&rps_objindex_chunkarr[ix >> RPS_OBJINDEX_CHUNK_SHIFT]);
+  if (!chunk)
+    return NULL;
+  return atomic_load (&chunk->oic_objarr[ix & (RPS_OBJINDEX_CHUNK_SIZE - 1)]);
+}				/* end rps_object_of_index */
+
+uint32_t
+rps_object_index_bound (void)
+{
+  return atomic_load (&rps_objindex_bound);
+}				/* end rps_object_index_bound */
+
+
+RpsObject_t *
+rps_get_loaded_object_by_oid (RpsLoader_t * ld, const RpsOid oid)
+{
+  struct rps_object_bucket_st *curbuck = NULL;
+  RPS_ASSERT (rps_is_valid_loader (ld));
+  if (rps_is_valid_creating_loader (ld))
+    {
+      /* we should allocate a new object, since it should not exist */
+      unsigned bix = rps_oid_bucket_num (oid);
+      RpsObject_t *obinfant =
+	RPS_ALLOC_ZONE (sizeof (RpsObject_t), RPS_TYPE_OBJECT);
+      obinfant->ob_magic = RPS_OBJ_MAGIC;
+      pthread_mutex_init (&obinfant->ob_mtx, &rps_objmutexattr);
+      obinfant->ob_id = oid;
+      obinfant->zv_hash = rps_oid_hash (oid);
+      // the infant object temporary class is the object class, which
+      // might not exist yet ...
+      rps_object_assign_index (obinfant);
+      rps_locked_object_put_class (obinfant,
+				   RPS_ROOT_OB (_5yhJGgxLwLp00X0xEQ));	//object∈class
+      // see also routine rps_load_initialize_root_objects
+      pthread_mutex_lock (&rps_object_bucket_array[bix].obuck_mtx);
+      curbuck = &rps_object_bucket_array[bix];
+      if (!curbuck->obuck_arr)
+	{
+	  unsigned inibucksiz =
+	    rps_prime_above (4 + ((rps_loader_nb_globals (ld) +
+				   rps_loader_nb_constants (ld))
+				  / RPS_OID_MAXBUCKETS));
+	  curbuck->obuck_arr =
+	    RPS_ALLOC_ZEROED (sizeof (RpsObject_t *) * inibucksiz);
+	  curbuck->obuck_capacity = inibucksiz;
+	  curbuck->obuck_card = 0;
+	};
+      RPS_ASSERT (!rps_object_bucket_is_nearly_full (curbuck));
+      rps_add_object_to_locked_bucket (curbuck, obinfant, RPS_BUCKET_GROWING);
+      pthread_mutex_unlock (&curbuck->obuck_mtx);
+      return obinfant;
+    }
+  else if (rps_is_valid_filling_loader (ld))
+    {
+      /* we need to find an existing object */
+      return rps_find_object_by_oid (oid);
+    }
+}				/* end rps_get_loaded_object_by_oid */
+
+
+/*****************************************************************
+ * Bulk creation of objects, for loaders and importers.  The given
+ * oids are first grouped by bucket, then each affected bucket is
+ * locked once, grown at most once to fit all its new objects, and
+ * filled.  A bucket is only touched while holding its own mutex, so
+ * several threads can create objects in parallel when each of them
+ * owns a disjoint range of bucket indexes.
+ *****************************************************************/
+
+/* In a locked bucket, find the object of given oid; if it is absent,
+   return NULL and set *PSLOT to the empty slot where it should go. */
+static RpsObject_t *
+rps_locked_bucket_find_or_slot (struct rps_object_bucket_st *buck,
+				const RpsOid oid, RpsObject_t *** pslot)
+{
+  RPS_ASSERT (buck != NULL && pslot != NULL);
+  unsigned cbucksiz = buck->obuck_capacity;
+  RPS_ASSERT (cbucksiz > 0 && buck->obuck_arr != NULL);
+  unsigned ix = (oid.id_hi ^ oid.id_lo) % cbucksiz;
+  *pslot = NULL;
+  for (unsigned cnt = 0; cnt < cbucksiz; cnt++)
+    {
+      RpsObject_t *curob = buck->obuck_arr[ix];
+      if (NULL == curob)
+	{
+	  *pslot = buck->obuck_arr + ix;
+	  return NULL;
+	};
+      RPS_ASSERT (curob->ob_magic == RPS_OBJ_MAGIC);
+      if (rps_oid_equal (curob->ob_id, oid))
+	return curob;
+      if (++ix >= cbucksiz)
+	ix = 0;
+    };
+  return NULL;
+}				/* end rps_locked_bucket_find_or_slot */
+
+
+/* Grow a locked bucket, if needed, so that NBEXTRA more objects can
+   be added without making it nearly full.  Uses the same thresholds
+   as rps_object_bucket_perhaps_increased_capacity above. */
+static void
+rps_locked_bucket_reserve (struct rps_object_bucket_st *buck,
+			   unsigned nbextra)
+{
+  RPS_ASSERT (buck != NULL);
+  int buckix = buck - rps_object_bucket_array;
+  unsigned oldsiz = buck->obuck_capacity;
+  unsigned wantcard = buck->obuck_card + nbextra;
+  if (buck->obuck_arr != NULL && wantcard + 2 <= oldsiz
+      && 3 * (oldsiz - wantcard) > oldsiz + 2)
+    return;
+  unsigned newsiz = rps_prime_above (3 * wantcard / 2 + oldsiz / 8 + 6);
+  RpsObject_t **oldarr = buck->obuck_arr;
+  buck->obuck_arr = RPS_ALLOC_ZEROED (sizeof (RpsObject_t *) * newsiz);
+  buck->obuck_capacity = newsiz;
+  if (oldarr)
+    {
+      for (unsigned ix = 0; ix < oldsiz; ix++)
+	{
+	  RpsObject_t *oldob = oldarr[ix];
+	  RpsObject_t **slot = NULL;
+	  if (!oldob)
+	    continue;
+	  if (rps_locked_bucket_find_or_slot (buck, oldob->ob_id, &slot)
+	      || !slot)
+	    RPS_FATAL ("corrupted bucket#%d capacity %u card %u", buckix,
+		       oldsiz, buck->obuck_card);
+	  *slot = oldob;
+	};
+      free (oldarr);
+    }
+  else
+    RPS_ASSERT (buck->obuck_card == 0);
+}				/* end rps_locked_bucket_reserve */
+
+
+/* The common worker for bulk creation.  Only oids in buckets of index
+   in [BIXLO,BIXHI) are handled, other entries of OBARR are left
+   untouched.  When FRESH is true, an oid of some already existing
+   object gives a NULL entry in OBARR, otherwise that existing object.
+   Return the number of newly created objects. */
+static unsigned
+rps_bulk_create_objects_worker (const RpsObject_t * obclass, unsigned nbob,
+				const RpsOid * oidarr, RpsObject_t ** obarr,
+				unsigned bixlo, unsigned bixhi, bool fresh)
+{
+  unsigned nbcreated = 0;
+  unsigned nbsel = 0;
+  if (nbob == 0 || !oidarr || !obarr)
+    return 0;
+  if (bixhi > RPS_OID_MAXBUCKETS)
+    bixhi = RPS_OID_MAXBUCKETS;
+  if (bixlo >= bixhi)
+    return 0;
+  if (!obclass)
+    obclass = RPS_ROOT_OB (_5yhJGgxLwLp00X0xEQ);	//object∈class
+  /// counting sort of the selected oid indexes by bucket number
+  unsigned *buckstart =
+    RPS_ALLOC_ZEROED ((RPS_OID_MAXBUCKETS + 1) * sizeof (unsigned));
+  for (unsigned ix = 0; ix < nbob; ix++)
+    {
+      if (!rps_oid_is_valid (oidarr[ix]))
+	continue;
+      unsigned bix = rps_oid_bucket_num (oidarr[ix]);
+      if (bix < bixlo || bix >= bixhi)
+	continue;
+      buckstart[bix + 1]++;
+      nbsel++;
+    };
+  if (nbsel == 0)
+    goto end;
+  for (unsigned bix = 0; bix < RPS_OID_MAXBUCKETS; bix++)
+    buckstart[bix + 1] += buckstart[bix];
+  unsigned *ordarr = RPS_ALLOC_ZEROED ((nbsel + 1) * sizeof (unsigned));
+  {
+    unsigned *fillarr =
+      RPS_ALLOC_ZEROED ((RPS_OID_MAXBUCKETS + 1) * sizeof (unsigned));
+    for (unsigned ix = 0; ix < nbob; ix++)
+      {
+	if (!rps_oid_is_valid (oidarr[ix]))
+	  continue;
+	unsigned bix = rps_oid_bucket_num (oidarr[ix]);
+	if (bix < bixlo || bix >= bixhi)
+	  continue;
+	ordarr[buckstart[bix] + fillarr[bix]++] = ix;
+      };
+    free (fillarr);
+  }
+  /// like rps_create_object_of_class, new objects are modified now
+  double nowmtime = rps_clocktime (CLOCK_REALTIME);
+  for (unsigned bix = bixlo; bix < bixhi; bix++)
+    {
+      unsigned nbinbuck = buckstart[bix + 1] - buckstart[bix];
+      if (nbinbuck == 0)
+	continue;
+      struct rps_object_bucket_st *curbuck = rps_object_bucket_array + bix;
+      pthread_mutex_lock (&curbuck->obuck_mtx);
+      rps_locked_bucket_reserve (curbuck, nbinbuck);
+      for (unsigned k = buckstart[bix]; k < buckstart[bix + 1]; k++)
+	{
+	  unsigned ix = ordarr[k];
+	  RpsObject_t **slot = NULL;
+	  RpsObject_t *oldob =
+	    rps_locked_bucket_find_or_slot (curbuck, oidarr[ix], &slot);
+	  if (oldob)
+	    {
+	      obarr[ix] = fresh ? NULL : oldob;
+	      continue;
+	    };
+	  RPS_ASSERTPRINTF (slot != NULL,
+			    "full bucket#%u capacity %u card %u", bix,
+			    curbuck->obuck_capacity, curbuck->obuck_card);
+	  RpsObject_t *newob =
+	    RPS_ALLOC_ZONE (sizeof (RpsObject_t), RPS_TYPE_OBJECT);
+	  newob->ob_magic = RPS_OBJ_MAGIC;
+	  pthread_mutex_init (&newob->ob_mtx, &rps_objmutexattr);
+	  newob->ob_id = oidarr[ix];
+	  newob->zv_hash = rps_oid_hash (oidarr[ix]);
+	  newob->ob_mtime = nowmtime;
+	  rps_object_assign_index (newob);
+	  rps_locked_object_put_class (newob, (RpsObject_t *) obclass);
+	  rps_mtime_index_note (newob, nowmtime);
+	  *slot = newob;
+	  curbuck->obuck_card++;
+	  obarr[ix] = newob;
+	  nbcreated++;
+	};
+      RPS_ASSERTPRINTF (!rps_object_bucket_is_nearly_full (curbuck),
+			"nearly full bucket#%u capacity %u card %u", bix,
+			curbuck->obuck_capacity, curbuck->obuck_card);
+      pthread_mutex_unlock (&curbuck->obuck_mtx);
+    };
+  free (ordarr);
+end:
+  free (buckstart);
+  return nbcreated;
+}				/* end rps_bulk_create_objects_worker */
+
+
+/* Create, or find when they exist, the NBOB objects of oids in OIDARR
+   and store them in OBARR.  New objects get the class OBCLASS, or
+   `object` when it is NULL.  Return the number of created objects. */
+unsigned
+rps_bulk_create_objects_by_oid (const RpsObject_t * obclass, unsigned nbob,
+				const RpsOid * oidarr, RpsObject_t ** obarr)
+{
+  return rps_bulk_create_objects_worker (obclass, nbob, oidarr, obarr,
+					 0, RPS_OID_MAXBUCKETS, false);
+}				/* end rps_bulk_create_objects_by_oid */
+
+
+/* Likewise, but only for those oids whose bucket number is in
+   [BIXLO,BIXHI); useful for threads sharing the same oid array. */
+unsigned
+rps_bulk_create_objects_in_bucket_range (const RpsObject_t * obclass,
+					 unsigned nbob,
+					 const RpsOid * oidarr,
+					 RpsObject_t ** obarr,
+					 unsigned bixlo, unsigned bixhi)
+{
+  return rps_bulk_create_objects_worker (obclass, nbob, oidarr, obarr,
+					 bixlo, bixhi, false);
+}				/* end rps_bulk_create_objects_in_bucket_range */
+
+
+/* Create NBOB new objects of random fresh oids in OBARR, of class
+   OBCLASS or `object` when it is NULL.  Return NBOB on success. */
+unsigned
+rps_bulk_create_fresh_objects (const RpsObject_t * obclass, unsigned nbob,
+			       RpsObject_t ** obarr)
+{
+  unsigned nbcreated = 0;
+  if (nbob == 0 || !obarr)
+    return 0;
+  if (obclass && !rps_is_valid_object ((RpsObject_t *) obclass))
+    return 0;
+  unsigned nbleft = nbob;
+  unsigned *leftarr = RPS_ALLOC_ZEROED (nbob * sizeof (unsigned));
+  RpsOid *oidarr = RPS_ALLOC_ZEROED (nbob * sizeof (RpsOid));
+  RpsObject_t **tmparr = RPS_ALLOC_ZEROED (nbob * sizeof (RpsObject_t *));
+  for (unsigned ix = 0; ix < nbob; ix++)
+    leftarr[ix] = ix;
+  /// in the very unlikely case of oid collisions, retry with other
+  /// random oids for the colliding ones
+  while (nbleft > 0)
+    {
+      unsigned nbagain = 0;
+      for (unsigned k = 0; k < nbleft; k++)
 	{
-	  buck->obuck_arr[ix] = obj;
-	  buck->obuck_card++;
-	  RPS_ASSERTPRINTF (!rps_object_bucket_is_nearly_full (buck),
-			    "wrongly full bucket#%d of card %u capacity %u",
-			    buckix, buck->obuck_card, buck->obuck_capacity);
-	  return;
-	}
-      RPS_ASSERT (curob->ob_magic == RPS_OBJ_MAGIC);
-      if (curob == obj)
-	return;
-    };
-  for (int ix = 0; ix < (int) stix; ix++)
-    {
-      RpsObject_t *curob = buck->obuck_arr[ix];
-      if (NULL == curob)
+	  oidarr[k] = rps_oid_random ();
+	  tmparr[k] = NULL;
+	};
+      nbcreated += rps_bulk_create_objects_worker (obclass, nbleft, oidarr,
+						   tmparr, 0,
+						   RPS_OID_MAXBUCKETS, true);
+      for (unsigned k = 0; k < nbleft; k++)
 	{
-	  buck->obuck_arr[ix] = obj;
-	  buck->obuck_card++;
-	  RPS_ASSERTPRINTF (!rps_object_bucket_is_nearly_full (buck),
-			    "wrongly full bucket#%d of card %u size %u",
-			    buckix, buck->obuck_card, buck->obuck_capacity);
-	  return;
-	}
-      RPS_ASSERT (curob->ob_magic == RPS_OBJ_MAGIC);
-      if (curob == obj)
-	return;
+	  if (tmparr[k])
+	    obarr[leftarr[k]] = tmparr[k];
+	  else
+	    leftarr[nbagain++] = leftarr[k];
+	};
+      nbleft = nbagain;
     };
-}				/* end rps_add_object_to_locked_bucket */
+  free (tmparr);
+  free (oidarr);
+  free (leftarr);
+  RPS_ASSERT (nbcreated == nbob);
+  return nbcreated;
+}				/* end rps_bulk_create_fresh_objects */
 
 
-RpsObject_t *
-rps_get_loaded_object_by_oid (RpsLoader_t * ld, const RpsOid oid)
+/*****************************************************************
+ * Parallel iteration on every object in rps_object_bucket_array.
+ * The buckets are handed out dynamically to a few workers: the
+ * calling thread and some threads of a pool, created on demand and
+ * then reused by later iterations.  Each worker copies the objects
+ * of one bucket while holding its mutex, and applies the callback
+ * after releasing it, so the callback may lock objects or create
+ * new ones.  A callback returning false stops every worker.  The
+ * same pool runs the chunked loops of rps_parallel_for_each_index.
+ *****************************************************************/
+struct rps_parindex_loop_st;
+
+struct rps_objiter_job_st
 {
-  struct rps_object_bucket_st *curbuck = NULL;
-  RPS_ASSERT (rps_is_valid_loader (ld));
-  if (rps_is_valid_creating_loader (ld))
+  rps_parallel_object_callback_sig_t *oij_rout;
+  void *oij_data;
+  atomic_uint oij_nextbucket;
+  atomic_bool oij_stop;
+  atomic_ulong oij_count;
+  /// when set, the job is that index loop instead of a bucket scan
+  struct rps_parindex_loop_st *oij_indexloop;
+};
+
+struct rps_objiter_pool_st
+{
+  pthread_mutex_t oip_mtx;
+  pthread_cond_t oip_startcond;	/* broadcast when a job starts */
+  pthread_cond_t oip_donecond;	/* broadcast when a worker finished */
+  int oip_nbthreads;		/* number of pooled threads */
+  pthread_t oip_threadarr[RPS_MAX_NB_THREADS];
+  unsigned long oip_generation;	/* incremented for every job */
+  /* the generation before the job for which each pooled thread was
+     created, so a thread started late still sees that job */
+  unsigned long oip_startgen[RPS_MAX_NB_THREADS + 1];
+  int oip_nbwanted;		/* pooled workers needed by current job */
+  int oip_nbdone;		/* pooled workers which did finish it */
+  struct rps_objiter_job_st *oip_job;
+};
+
+static struct rps_objiter_pool_st rps_objiter_pool = {
+  .oip_mtx = PTHREAD_MUTEX_INITIALIZER,
+  .oip_startcond = PTHREAD_COND_INITIALIZER,
+  .oip_donecond = PTHREAD_COND_INITIALIZER,
+};
+
+/* only one parallel iteration uses the pool at any time */
+static pthread_mutex_t rps_objiter_job_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* the worker index of the current thread inside an iteration, or -1 */
+static _Thread_local int rps_objiter_worker_index = -1;
+
+static void rps_parindex_loop_work (struct rps_parindex_loop_st *pl,
+				    int workix);
+
+static void
+rps_objiter_scan_buckets (struct rps_objiter_job_st *job, int workix)
+{
+  RPS_ASSERT (job != NULL && job->oij_rout != NULL);
+  unsigned bufsiz = 64;
+  unsigned long count = 0;
+  RpsObject_t **bufarr = RPS_ALLOC_ZEROED (bufsiz * sizeof (RpsObject_t *));
+  while (!atomic_load (&job->oij_stop))
     {
-      /* we should allocate a new object, since it should not exist */
-      unsigned bix = rps_oid_bucket_num (oid);
-      RpsObject_t *obinfant =
-	RPS_ALLOC_ZONE (sizeof (RpsObject_t), RPS_TYPE_OBJECT);
-      obinfant->ob_magic = RPS_OBJ_MAGIC;
-      pthread_mutex_init (&obinfant->ob_mtx, &rps_objmutexattr);
-      obinfant->ob_id = oid;
-      obinfant->zv_hash = rps_oid_hash (oid);
-      // the infant object temporary class is the object class, which
-      // might not exist yet ...
-      obinfant->ob_class = RPS_ROOT_OB (_5yhJGgxLwLp00X0xEQ);	//object∈class
-      // see also routine rps_load_initialize_root_objects
-      pthread_mutex_lock (&rps_object_bucket_array[bix].obuck_mtx);
-      curbuck = &rps_object_bucket_array[bix];
-      if (!curbuck->obuck_arr)
+      unsigned bix = atomic_fetch_add (&job->oij_nextbucket, 1);
+      if (bix >= RPS_OID_MAXBUCKETS)
+	break;
+      struct rps_object_bucket_st *curbuck = rps_object_bucket_array + bix;
+      unsigned nbob = 0;
+      pthread_mutex_lock (&curbuck->obuck_mtx);
+      if (curbuck->obuck_card >= bufsiz)
 	{
-	  unsigned inibucksiz =
-	    rps_prime_above (4 + ((rps_loader_nb_globals (ld) +
-				   rps_loader_nb_constants (ld))
-				  / RPS_OID_MAXBUCKETS));
-	  curbuck->obuck_arr =
-	    RPS_ALLOC_ZEROED (sizeof (RpsObject_t *) * inibucksiz);
-	  curbuck->obuck_capacity = inibucksiz;
-	  curbuck->obuck_card = 0;
+	  free (bufarr);
+	  bufsiz = rps_prime_above (curbuck->obuck_card + 16);
+	  bufarr = RPS_ALLOC_ZEROED (bufsiz * sizeof (RpsObject_t *));
 	};
-      RPS_ASSERT (!rps_object_bucket_is_nearly_full (curbuck));
-      rps_add_object_to_locked_bucket (curbuck, obinfant, RPS_BUCKET_GROWING);
+      if (curbuck->obuck_arr)
+	for (unsigned ix = 0; ix < curbuck->obuck_capacity; ix++)
+	  if (curbuck->obuck_arr[ix])
+	    bufarr[nbob++] = curbuck->obuck_arr[ix];
       pthread_mutex_unlock (&curbuck->obuck_mtx);
-      return obinfant;
+      for (unsigned k = 0; k < nbob; k++)
+	{
+	  if (atomic_load (&job->oij_stop))
+	    break;
+	  count++;
+	  if (!(*job->oij_rout) (bufarr[k], workix, job->oij_data))
+	    {
+	      atomic_store (&job->oij_stop, true);
+	      break;
+	    }
+	}
+    };
+  free (bufarr);
+  atomic_fetch_add (&job->oij_count, count);
+}				/* end rps_objiter_scan_buckets */
+
+static void *
+rps_objiter_thread_routine (void *ptr)
+{
+  struct rps_objiter_pool_st *pool = &rps_objiter_pool;
+  int workix = (int) (intptr_t) ptr;
+  char thname[16];
+  unsigned long seengen = 0;
+  RPS_ASSERT (workix > 0 && workix <= RPS_MAX_NB_THREADS);
+  memset (thname, 0, sizeof (thname));
+  snprintf (thname, sizeof (thname), "rpsobiter#%d", workix);
+  pthread_setname_np (pthread_self (), thname);
+  rps_objiter_worker_index = workix;
+  /// routines run by this thread may read lock-free data, see
+  /// epoch_rps.c; it is offline between jobs
+  rps_epoch_register_thread ();
+  rps_epoch_go_offline ();
+  pthread_mutex_lock (&pool->oip_mtx);
+  seengen = pool->oip_startgen[workix];
+  for (;;)
+    {
+      while (pool->oip_generation == seengen)
+	pthread_cond_wait (&pool->oip_startcond, &pool->oip_mtx);
+      seengen = pool->oip_generation;
+      struct rps_objiter_job_st *job = pool->oip_job;
+      if (!job || workix > pool->oip_nbwanted)
+	continue;
+      pthread_mutex_unlock (&pool->oip_mtx);
+      rps_epoch_go_online ();
+      if (job->oij_indexloop)
+	rps_parindex_loop_work (job->oij_indexloop, workix);
+      else
+	rps_objiter_scan_buckets (job, workix);
+      rps_epoch_go_offline ();
+      pthread_mutex_lock (&pool->oip_mtx);
+      pool->oip_nbdone++;
+      pthread_cond_broadcast (&pool->oip_donecond);
     }
-  else if (rps_is_valid_filling_loader (ld))
+  return NULL;
+}				/* end rps_objiter_thread_routine */
+
+
+/* Run JOB in the pool with NBTHREADS workers, the calling one being
+   the worker of index 0, creating the missing pooled threads. */
+static void
+rps_objiter_run_job (struct rps_objiter_job_st *job, int nbthreads)
+{
+  struct rps_objiter_pool_st *pool = &rps_objiter_pool;
+  RPS_ASSERT (job != NULL);
+  RPS_ASSERT (nbthreads > 1 && nbthreads <= RPS_MAX_NB_THREADS);
+  pthread_mutex_lock (&rps_objiter_job_mtx);
+  pthread_mutex_lock (&pool->oip_mtx);
+  while (pool->oip_nbthreads < nbthreads - 1)
     {
-      /* we need to find an existing object */
-      return rps_find_object_by_oid (oid);
+      int thix = pool->oip_nbthreads + 1;
+      pool->oip_startgen[thix] = pool->oip_generation;
+      int err = pthread_create (&pool->oip_threadarr[thix - 1], NULL,
+				rps_objiter_thread_routine,
+				(void *) (intptr_t) thix);
+      if (err)
+	RPS_FATAL ("failed to create object iteration thread#%d: %s", thix,
+		   strerror (err));
+      pool->oip_nbthreads = thix;
+    };
+  pool->oip_job = job;
+  pool->oip_nbwanted = nbthreads - 1;
+  pool->oip_nbdone = 0;
+  pool->oip_generation++;
+  pthread_cond_broadcast (&pool->oip_startcond);
+  pthread_mutex_unlock (&pool->oip_mtx);
+  rps_objiter_worker_index = 0;
+  if (job->oij_indexloop)
+    rps_parindex_loop_work (job->oij_indexloop, 0);
+  else
+    rps_objiter_scan_buckets (job, 0);
+  rps_objiter_worker_index = -1;
+  pthread_mutex_lock (&pool->oip_mtx);
+  while (pool->oip_nbdone < pool->oip_nbwanted)
+    pthread_cond_wait (&pool->oip_donecond, &pool->oip_mtx);
+  pool->oip_job = NULL;
+  pool->oip_nbwanted = 0;
+  pthread_mutex_unlock (&pool->oip_mtx);
+  pthread_mutex_unlock (&rps_objiter_job_mtx);
+}				/* end rps_objiter_run_job */
+
+/* Apply ROUT to every object, in NBTHREADS threads (the number of
+   agenda threads when it is not positive).  ROUT gets the index of
+   its worker, between 0 and NBTHREADS-1, which can be used to keep
+   some per-worker reduction state in DATA.  Return the number of
+   objects on which ROUT was applied.  A nested call, from inside ROUT,
+   is done serially in the current thread. */
+unsigned long
+rps_parallel_for_each_object (rps_parallel_object_callback_sig_t * rout,
+			      void *data, int nbthreads)
+{
+  struct rps_objiter_job_st job = {.oij_rout = rout,.oij_data = data };
+  if (!rout)
+    return 0;
+  if (nbthreads <= 0)
+    nbthreads = rps_nb_threads;
+  if (nbthreads <= 0)
+    nbthreads = 1;
+  else if (nbthreads > RPS_MAX_NB_THREADS)
+    nbthreads = RPS_MAX_NB_THREADS;
+  atomic_init (&job.oij_nextbucket, 0);
+  atomic_init (&job.oij_stop, false);
+  atomic_init (&job.oij_count, 0);
+  if (nbthreads == 1 || rps_objiter_worker_index >= 0)
+    {
+      rps_objiter_scan_buckets (&job, 0);
+      return atomic_load (&job.oij_count);
+    };
+  rps_objiter_run_job (&job, nbthreads);
+  return atomic_load (&job.oij_count);
+}				/* end rps_parallel_for_each_object */
+
+#define RPS_PARALLEL_INDEX_CHUNK 512
+
+struct rps_parindex_loop_st
+{
+  rps_parallel_index_callback_sig_t *pxl_rout;
+  void *pxl_data;
+  unsigned long pxl_nb;
+  atomic_ulong pxl_nextchunk;
+};
+
+static void
+rps_parindex_loop_work (struct rps_parindex_loop_st *pl, int workix)
+{
+  for (;;)
+    {
+      unsigned long chk = atomic_fetch_add (&pl->pxl_nextchunk, 1);
+      unsigned long start = chk * RPS_PARALLEL_INDEX_CHUNK;
+      if (start >= pl->pxl_nb)
+	return;
+      unsigned long end = start + RPS_PARALLEL_INDEX_CHUNK;
+      if (end > pl->pxl_nb)
+	end = pl->pxl_nb;
+      for (unsigned long ix = start; ix < end; ix++)
+	(*pl->pxl_rout) (ix, workix, pl->pxl_data);
     }
-}				/* end rps_get_loaded_object_by_oid */
+}				/* end rps_parindex_loop_work */
+
+/* Apply ROUT to every index below NB, in at most NBTHREADS threads
+   (the number of agenda threads when it is not positive) taking chunks
+   of consecutive indexes; the worker index passed to ROUT is below
+   NBTHREADS.  The threads are those of the pool of
+   rps_parallel_for_each_object, and a nested call is done serially in
+   the current thread. */
+void
+rps_parallel_for_each_index (unsigned long nb, int nbthreads,
+			     rps_parallel_index_callback_sig_t * rout,
+			     void *data)
+{
+  struct rps_parindex_loop_st pl = {.pxl_rout = rout,.pxl_data = data,
+    .pxl_nb = nb
+  };
+  atomic_init (&pl.pxl_nextchunk, 0);
+  if (nbthreads <= 0)
+    nbthreads = rps_nb_threads;
+  if (nbthreads > RPS_MAX_NB_THREADS)
+    nbthreads = RPS_MAX_NB_THREADS;
+  unsigned long nbchunks =
+    (nb + RPS_PARALLEL_INDEX_CHUNK - 1) / RPS_PARALLEL_INDEX_CHUNK;
+  if ((unsigned long) nbthreads > nbchunks)
+    nbthreads = (int) nbchunks;
+  if (nbthreads <= 1 || rps_objiter_worker_index >= 0)
+    {
+      rps_parindex_loop_work (&pl, 0);
+      return;
+    };
+  struct rps_objiter_job_st job = {.oij_indexloop = &pl };
+  atomic_init (&job.oij_nextbucket, 0);
+  atomic_init (&job.oij_stop, false);
+  atomic_init (&job.oij_count, 0);
+  rps_objiter_run_job (&job, nbthreads);
+}				/* end rps_parallel_for_each_index */
 
 
 /// function to dump object attributes, has a signature compatible with rps_apply_dumpj_sigt
@@ -984,10 +2074,9 @@ rpscloj_dump_object_attributes (rps_callframe_t * callerframe,
   RPS_ASSERT (rps_value_type (dumpedobv) == RPS_TYPE_OBJECT);
   RpsObject_t *obdump = (RpsObject_t *) dumpedobv;
   RPS_ASSERT (json_is_object (js));
-  if (!obdump->ob_attrtable)
+  if (rps_locked_object_nb_attributes (obdump) == 0)
     return (RpsValue_t) obdump;
-  const RpsSetOb_t *setattrs =
-    rps_attr_table_set_of_attributes (obdump->ob_attrtable);
+  const RpsSetOb_t *setattrs = rps_locked_object_set_of_attributes (obdump);
   json_t *jsarr = json_array ();
   unsigned nbattrs = rps_set_cardinal (setattrs);
   if (nbattrs == 0)
@@ -997,7 +2086,7 @@ rpscloj_dump_object_attributes (rps_callframe_t * callerframe,
       const RpsObject_t *obattr = rps_set_nth_member (setattrs, aix);
       if (!rps_is_dumpable_object (du, (RpsObject_t *) obattr))
 	continue;
-      RpsValue_t curval = rps_attr_table_find (obdump->ob_attrtable, obattr);
+      RpsValue_t curval = rps_locked_object_get_attribute (obdump, obattr);
       if (!rps_is_dumpable_value (du, curval))
 	continue;
       json_t *jent = json_object ();
@@ -1040,47 +2129,64 @@ rpscloj_dump_object_components (rps_callframe_t * callerframe,
 }				/* end of rpscloj_dump_object_attributes */
 
 
+/* The payload type registry is a table of virtual tables, indexed by
+   payload types.  It is filled at startup, in main, while there is
+   only one thread, then frozen by rps_freeze_payload_registry; so it
+   is read without locking.  The rps_payload_mtx only serializes
+   registrations, and insertions in the map of payload loaders. */
+struct rps_payload_vtable_st
+{
+  rps_payload_remover_t *pvt_remover;
+  void *pvt_remover_data;
+  rps_payload_dump_scanner_t *pvt_dump_scanner;
+  void *pvt_dump_scanner_data;
+  rps_payload_dump_serializer_t *pvt_dump_serializer;
+  void *pvt_dump_serializer_data;
+  rps_payload_verifier_t *pvt_verifier;
+  void *pvt_verifier_data;
+  rpsldpysig_t *pvt_loader;
+};
+
 static pthread_mutex_t rps_payload_mtx =
   PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static rps_payload_remover_t
-  * rps_payload_removing_rout_arr[RPS_MAX_PAYLOAD_TYPE_INDEX];
-static void *rps_payload_removing_data_arr[RPS_MAX_PAYLOAD_TYPE_INDEX];
-static rps_payload_dump_scanner_t
-  * rps_payload_dump_scanning_rout_arr[RPS_MAX_PAYLOAD_TYPE_INDEX];
-static void *rps_payload_dump_scanning_data_arr[RPS_MAX_PAYLOAD_TYPE_INDEX];
-static rps_payload_dump_serializer_t
-  * rps_payload_dump_serializing_rout_arr[RPS_MAX_PAYLOAD_TYPE_INDEX];
-static void
-  *rps_payload_dump_serializing_data_arr[RPS_MAX_PAYLOAD_TYPE_INDEX];
-static rps_payload_verifier_t
-  * rps_payload_verifying_rout_arr[RPS_MAX_PAYLOAD_TYPE_INDEX];
-static void *rps_payload_verifying_data_arr[RPS_MAX_PAYLOAD_TYPE_INDEX];
+static struct rps_payload_vtable_st
+  rps_payload_vtable_arr[RPS_MAX_PAYLOAD_TYPE_INDEX];
+static atomic_bool rps_payload_registry_frozen;
 
-void
-rps_register_payload_removal (int paylty, rps_payload_remover_t * rout,
-			      void *data)
+/* check a registration, called with rps_payload_mtx locked */
+static void
+rps_check_payload_registration (int paylty, void *rout, void *data,
+				 const char *what)
 {
-  pthread_mutex_lock (&rps_payload_mtx);
   if (paylty == 0 || paylty >= RPS_MAX_PAYLOAD_TYPE_INDEX)
     {
       Dl_info routinfo = { };
-      dladdr ((void *) rout, &routinfo);
+      dladdr (rout, &routinfo);
       const char *routname = routinfo.dli_sname;
       if (!routname)
 	routname = "???";
       RPS_FATAL
-	("payload type#%d invalid for payload removal routine %p / %s",
-	 paylty, (void *) rout, routname);
+	("payload type#%d invalid for payload %s routine %p / %s",
+	 paylty, what, rout, routname);
     };
-  if ((void *) rout == NULL && data != NULL)
+  if (rout == NULL && data != NULL)
     {
       RPS_FATAL
-	("payload type#%d without removal routine, but with some removal data @%p",
-	 paylty, data);
+	("payload type#%d without %s routine, but with some %s data @%p",
+	 paylty, what, what, data);
     }
-  rps_payload_removing_rout_arr[paylty] = rout;
-  rps_payload_removing_data_arr[paylty] = data;
-end:
+  if (atomic_load (&rps_payload_registry_frozen))
+    RPS_FATAL ("payload type#%d %s registered after startup", paylty, what);
+}				/* end rps_check_payload_registration */
+
+void
+rps_register_payload_removal (int paylty, rps_payload_remover_t * rout,
+			      void *data)
+{
+  pthread_mutex_lock (&rps_payload_mtx);
+  rps_check_payload_registration (paylty, (void *) rout, data, "removal");
+  rps_payload_vtable_arr[paylty].pvt_remover = rout;
+  rps_payload_vtable_arr[paylty].pvt_remover_data = data;
   pthread_mutex_unlock (&rps_payload_mtx);
 }				/* end rps_register_payload_removal */
 
@@ -1089,26 +2195,9 @@ rps_register_payload_verifier (int paylty, rps_payload_verifier_t * rout,
 			       void *data)
 {
   pthread_mutex_lock (&rps_payload_mtx);
-  if (paylty == 0 || paylty >= RPS_MAX_PAYLOAD_TYPE_INDEX)
-    {
-      Dl_info routinfo = { };
-      dladdr ((void *) rout, &routinfo);
-      const char *routname = routinfo.dli_sname;
-      if (!routname)
-	routname = "???";
-      RPS_FATAL
-	("payload type#%d invalid for payload verifying routine %p / %s",
-	 paylty, (void *) rout, routname);
-    };
-  if ((void *) rout == NULL && data != NULL)
-    {
-      RPS_FATAL
-	("payload type#%d without verifying routine, but with some verifying data @%p",
-	 paylty, data);
-    }
-  rps_payload_verifying_rout_arr[paylty] = rout;
-  rps_payload_verifying_data_arr[paylty] = data;
-end:
+  rps_check_payload_registration (paylty, (void *) rout, data, "verifying");
+  rps_payload_vtable_arr[paylty].pvt_verifier = rout;
+  rps_payload_vtable_arr[paylty].pvt_verifier_data = data;
   pthread_mutex_unlock (&rps_payload_mtx);
 }				/* end rps_register_payload_verifier */
 
@@ -1117,28 +2206,108 @@ rps_register_payload_dump_scanner (int paylty, rps_payload_dump_scanner_t * rout
 				   void *data)
 {
   pthread_mutex_lock (&rps_payload_mtx);
-  if (paylty == 0 || paylty >= RPS_MAX_PAYLOAD_TYPE_INDEX)
+  rps_check_payload_registration (paylty, (void *) rout, data,
+				  "dump scanner");
+  rps_payload_vtable_arr[paylty].pvt_dump_scanner = rout;
+  rps_payload_vtable_arr[paylty].pvt_dump_scanner_data = data;
+  pthread_mutex_unlock (&rps_payload_mtx);
+}				/* end rps_register_payload_dump_scanner */
+
+
+/* The payload loaders are found by their name, the string of the
+   "payload" JSON of objects, in an insert only open-addressed map read
+   without locking.  Registered loaders are inserted at startup; any
+   other name is resolved by dlsym once, then remembered. */
+#define RPS_PAYLOAD_LOADER_MAP_SIZE 307	/* a prime */
+struct rps_payload_loader_entry_st
+{
+  const char *_Atomic ple_name;	/* stored after ple_loader */
+  rpsldpysig_t *ple_loader;
+};
+static struct rps_payload_loader_entry_st
+  rps_payload_loader_map[RPS_PAYLOAD_LOADER_MAP_SIZE];
+static unsigned rps_payload_loader_count;
+
+static rpsldpysig_t *
+rps_payload_loader_map_find (const char *name)
+{
+  unsigned ix = rps_hash_cstr (name) % RPS_PAYLOAD_LOADER_MAP_SIZE;
+  for (unsigned cnt = 0; cnt < RPS_PAYLOAD_LOADER_MAP_SIZE; cnt++)
     {
-      Dl_info routinfo = { };
-      dladdr ((void *) rout, &routinfo);
-      const char *routname = routinfo.dli_sname;
-      if (!routname)
-	routname = "???";
-      RPS_FATAL
-	("payload type#%d invalid for payload dump scanner routine %p / %s",
-	 paylty, (void *) rout, routname);
+      struct rps_payload_loader_entry_st *ent = rps_payload_loader_map + ix;
+      const char *curname = atomic_load (&ent->ple_name);
+      if (!curname)
+	return NULL;
+      if (!strcmp (curname, name))
+	return ent->ple_loader;
+      if (++ix >= RPS_PAYLOAD_LOADER_MAP_SIZE)
+	ix = 0;
     };
-  if ((void *) rout == NULL && data != NULL)
+  return NULL;
+}				/* end rps_payload_loader_map_find */
+
+/* called with rps_payload_mtx locked */
+static void
+rps_payload_loader_map_insert (const char *name, rpsldpysig_t * rout)
+{
+  if (3 * (rps_payload_loader_count + 1) > 2 * RPS_PAYLOAD_LOADER_MAP_SIZE)
+    RPS_FATAL ("too many payload loaders, cannot add %s", name);
+  unsigned ix = rps_hash_cstr (name) % RPS_PAYLOAD_LOADER_MAP_SIZE;
+  while (atomic_load (&rps_payload_loader_map[ix].ple_name) != NULL)
+    if (++ix >= RPS_PAYLOAD_LOADER_MAP_SIZE)
+      ix = 0;
+  rps_payload_loader_map[ix].ple_loader = rout;
+  atomic_store (&rps_payload_loader_map[ix].ple_name, strdup (name));
+  rps_payload_loader_count++;
+}				/* end rps_payload_loader_map_insert */
+
+void
+rps_register_payload_loader (int paylty, const char *name,
+			     rpsldpysig_t * rout)
+{
+  pthread_mutex_lock (&rps_payload_mtx);
+  rps_check_payload_registration (paylty, (void *) rout, NULL, "loader");
+  if (!name || !name[0] || !rout)
+    RPS_FATAL ("payload type#%d with bad loader %s", paylty,
+	       name ? name : "*nil*");
+  if (rps_payload_loader_map_find (name))
+    RPS_FATAL ("payload type#%d with duplicate loader %s", paylty, name);
+  rps_payload_vtable_arr[paylty].pvt_loader = rout;
+  rps_payload_loader_map_insert (name, rout);
+  pthread_mutex_unlock (&rps_payload_mtx);
+}				/* end rps_register_payload_loader */
+
+rpsldpysig_t *
+rps_payload_loader_of_name (const char *name)
+{
+  if (!name || !name[0])
+    return NULL;
+  rpsldpysig_t *rout = rps_payload_loader_map_find (name);
+  if (rout)
+    return rout;
+  pthread_mutex_lock (&rps_payload_mtx);
+  rout = rps_payload_loader_map_find (name);
+  if (!rout)
     {
-      RPS_FATAL
-	("payload type#%d without dump scanner routine, but with some removal data @%p",
-	 paylty, data);
-    }
-  rps_payload_dump_scanning_rout_arr[paylty] = rout;
-  rps_payload_dump_scanning_data_arr[paylty] = data;
-end:
+      char paylroutname[80];
+      memset (paylroutname, 0, sizeof (paylroutname));
+      snprintf (paylroutname, sizeof (paylroutname),
+		RPS_PAYLOADING_PREFIX "%s", name);
+      rout = (rpsldpysig_t *) dlsym (rps_dlhandle, paylroutname);
+      if (rout)
+	rps_payload_loader_map_insert (name, rout);
+    };
   pthread_mutex_unlock (&rps_payload_mtx);
-}				/* end rps_register_payload_dump_scanner */
+  return rout;
+}				/* end rps_payload_loader_of_name */
+
+void
+rps_freeze_payload_registry (void)
+{
+  pthread_mutex_lock (&rps_payload_mtx);
+  atomic_store (&rps_payload_registry_frozen, true);
+  pthread_mutex_unlock (&rps_payload_mtx);
+}				/* end rps_freeze_payload_registry */
 
 
 /* this function is called with the object locked */
@@ -1153,14 +2322,9 @@ rps_dump_scan_object_payload (RpsDumper_t * du, RpsObject_t * ob)
   RPS_ASSERT (payl->payl_owner == ob);
   int8_t paylty = atomic_load (&payl->zm_atype);
   RPS_ASSERT (paylty < 0 && paylty > -RpsPyt__LAST);
-  rps_payload_dump_scanner_t *scanrout = NULL;
-  void *scandata = NULL;
-  {
-    pthread_mutex_lock (&rps_payload_mtx);
-    scanrout = rps_payload_dump_scanning_rout_arr[-paylty];
-    scandata = rps_payload_dump_scanning_data_arr[-paylty];
-    pthread_mutex_unlock (&rps_payload_mtx);
-  }
+  rps_payload_dump_scanner_t *scanrout =
+    rps_payload_vtable_arr[-paylty].pvt_dump_scanner;
+  void *scandata = rps_payload_vtable_arr[-paylty].pvt_dump_scanner_data;
   if (scanrout)
     (*scanrout) (du, payl, scandata);
   else
@@ -1174,26 +2338,10 @@ rps_register_payload_dump_serializer (int paylty, rps_payload_dump_serializer_t
 				      void *data)
 {
   pthread_mutex_lock (&rps_payload_mtx);
-  if (paylty == 0 || paylty >= RPS_MAX_PAYLOAD_TYPE_INDEX)
-    {
-      Dl_info routinfo = { };
-      dladdr ((void *) rout, &routinfo);
-      const char *routname = routinfo.dli_sname;
-      if (!routname)
-	routname = "???";
-      RPS_FATAL
-	("payload type#%d invalid for payload dump scanner routine %p / %s",
-	 paylty, (void *) rout, routname);
-    };
-  if ((void *) rout == NULL && data != NULL)
-    {
-      RPS_FATAL
-	("payload type#%d without dump scanner routine, but with some removal data @%p",
-	 paylty, data);
-    }
-  rps_payload_dump_serializing_rout_arr[paylty] = rout;
-  rps_payload_dump_serializing_data_arr[paylty] = data;
-end:
+  rps_check_payload_registration (paylty, (void *) rout, data,
+				  "dump serializer");
+  rps_payload_vtable_arr[paylty].pvt_dump_serializer = rout;
+  rps_payload_vtable_arr[paylty].pvt_dump_serializer_data = data;
   pthread_mutex_unlock (&rps_payload_mtx);
 }				/* end rps_register_payload_dump_serializer */
 
@@ -1215,16 +2363,8 @@ rps_verify_locked_object_payload (RpsObject_t * ob, int paylty, void *payl)
     RPS_FATAL
       ("payload type#%d invalid for object %O payl@%p", paylty, ob, payl);
   RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (payl) == paylty);
-  pthread_mutex_lock (&rps_payload_mtx);
-  verifrout = rps_payload_verifying_rout_arr[-paylty];
-  verifdata = rps_payload_verifying_data_arr[-paylty];
-  if ((void *) verifrout == NULL && verifdata != NULL)
-    {
-      RPS_FATAL
-	("payload type#%d without verifying routine, but with some verifying data @%p",
-	 paylty, verifdata);
-    }
-  pthread_mutex_unlock (&rps_payload_mtx);
+  verifrout = rps_payload_vtable_arr[-paylty].pvt_verifier;
+  verifdata = rps_payload_vtable_arr[-paylty].pvt_verifier_data;
   if (verifrout)
     {
       (*verifrout) (ob, ob->ob_payload, verifdata);
@@ -1247,14 +2387,9 @@ rps_dump_serialize_object_payload (RpsDumper_t * du, RpsObject_t * ob,
   RPS_ASSERT (payl->payl_owner == ob);
   int8_t paylty = atomic_load (&payl->zm_atype);
   RPS_ASSERT (paylty < 0 && paylty > -RpsPyt__LAST);
-  rps_payload_dump_serializer_t *serirout = NULL;
-  void *seridata = NULL;
-  {
-    pthread_mutex_lock (&rps_payload_mtx);
-    serirout = rps_payload_dump_serializing_rout_arr[-paylty];
-    seridata = rps_payload_dump_serializing_data_arr[-paylty];
-    pthread_mutex_unlock (&rps_payload_mtx);
-  }
+  rps_payload_dump_serializer_t *serirout =
+    rps_payload_vtable_arr[-paylty].pvt_dump_serializer;
+  void *seridata = rps_payload_vtable_arr[-paylty].pvt_dump_serializer_data;
   if (serirout)
     (*serirout) (du, payl, jsob, seridata);
 }				/* end rps_dump_serialize_object_payload */
@@ -1281,16 +2416,21 @@ rps_object_put_payload (RpsObject_t * obj, void *payl)
       int oldptype = RPS_ZONED_MEMORY_TYPE (oldpayl);
       if (oldptype < 0 && oldptype > -RPS_MAX_PAYLOAD_TYPE_INDEX)
 	{
-	  pthread_mutex_lock (&rps_payload_mtx);
-	  oldremover = rps_payload_removing_rout_arr[-oldptype];
-	  oldremdata = rps_payload_removing_data_arr[-oldptype];
-	  pthread_mutex_unlock (&rps_payload_mtx);
+	  oldremover = rps_payload_vtable_arr[-oldptype].pvt_remover;
+	  oldremdata = rps_payload_vtable_arr[-oldptype].pvt_remover_data;
 	}
       if (oldremover)
 	(*oldremover) (obj, oldpayl, oldremdata);
     }
   obj->ob_payload = newpayl;
   newpayl->payl_owner = obj;
+  rps_locked_object_touch (obj);
+  rps_trigram_note_payload (obj);
+  if (newptype == RpsPyt_ClassInfo)
+    {
+      rps_method_cache_invalidate ();
+      rps_class_hierarchy_changed ();
+    };
 end:
   pthread_mutex_unlock (&obj->ob_mtx);
 }				/* end of rps_object_put_payload */
@@ -1401,6 +2541,17 @@ rps_classinfo_get_method (const RpsClassInfo_t * clinf, RpsObject_t * selob)
   return (RpsClosure_t *) valmeth;
 }				/* end rps_classinfo_get_method */
 
+/* Return the classinfo payload of an already locked object, or NULL.
+   Calling rps_get_object_payload_of_type would lock it again. */
+RpsClassInfo_t *
+rps_locked_object_classinfo (RpsObject_t * obcla)
+{
+  struct rps_owned_payload_st *payl = obcla->ob_payload;
+  if (!payl || rps_zoned_memory_type (payl) != -RpsPyt_ClassInfo)
+    return NULL;
+  return (RpsClassInfo_t *) payl;
+}				/* end rps_locked_object_classinfo */
+
 RpsObject_t *
 rps_obclass_super (RpsObject_t * obcla)
 {
@@ -1408,8 +2559,7 @@ rps_obclass_super (RpsObject_t * obcla)
   if (!obcla || !rps_is_valid_object (obcla))
     return NULL;
   pthread_mutex_lock (&obcla->ob_mtx);
-  RpsClassInfo_t *clinf =
-    rps_get_object_payload_of_type (obcla, -RpsPyt_ClassInfo);
+  RpsClassInfo_t *clinf = rps_locked_object_classinfo (obcla);
   if (!clinf)
     goto end;
   obres = rps_classinfo_super (clinf);
@@ -1425,8 +2575,7 @@ rps_obclass_symbol (RpsObject_t * obcla)
   if (!obcla || !rps_is_valid_object (obcla))
     return NULL;
   pthread_mutex_lock (&obcla->ob_mtx);
-  RpsClassInfo_t *clinf =
-    rps_get_object_payload_of_type (obcla, -RpsPyt_ClassInfo);
+  RpsClassInfo_t *clinf = rps_locked_object_classinfo (obcla);
   if (!clinf)
     goto end;
   obres = rps_classinfo_symbol (clinf);
@@ -1442,8 +2591,7 @@ rps_obclass_methdict (RpsObject_t * obcla)
   if (!obcla || !rps_is_valid_object (obcla))
     return NULL;
   pthread_mutex_lock (&obcla->ob_mtx);
-  RpsClassInfo_t *clinf =
-    rps_get_object_payload_of_type (obcla, -RpsPyt_ClassInfo);
+  RpsClassInfo_t *clinf = rps_locked_object_classinfo (obcla);
   if (!clinf)
     goto end;
   atbl = rps_classinfo_methdict (clinf);
@@ -1461,8 +2609,7 @@ rps_obclass_get_method (RpsObject_t * obcla, RpsObject_t * selob)
   if (!selob || !rps_is_valid_object (selob))
     return NULL;
   pthread_mutex_lock (&obcla->ob_mtx);
-  RpsClassInfo_t *clinf =
-    rps_get_object_payload_of_type (obcla, -RpsPyt_ClassInfo);
+  RpsClassInfo_t *clinf = rps_locked_object_classinfo (obcla);
   if (!clinf)
     goto end;
   clores = rps_classinfo_get_method (clinf, selob);
@@ -1471,6 +2618,100 @@ end:
   return clores;
 }				/* end rps_obclass_get_method */
 
+bool
+rps_obclass_put_method (RpsObject_t * obcla, RpsObject_t * selob,
+			RpsClosure_t * clos)
+{
+  bool ok = false;
+  if (!obcla || !rps_is_valid_object (obcla))
+    return false;
+  if (!selob || !rps_is_valid_object (selob))
+    return false;
+  if (!clos || rps_value_type ((RpsValue_t) clos) != RPS_TYPE_CLOSURE)
+    return false;
+  pthread_mutex_lock (&obcla->ob_mtx);
+  RpsClassInfo_t *clinf = rps_locked_object_classinfo (obcla);
+  if (!clinf || clinf->pclass_magic != RPS_CLASSINFO_MAGIC)
+    goto end;
+  clinf->pclass_methdict =
+    rps_attr_table_put (clinf->pclass_methdict, selob, (RpsValue_t) clos);
+  rps_method_cache_invalidate ();
+  rps_locked_object_touch (obcla);
+  ok = true;
+end:
+  pthread_mutex_unlock (&obcla->ob_mtx);
+  return ok;
+}				/* end rps_obclass_put_method */
+
+bool
+rps_obclass_remove_method (RpsObject_t * obcla, RpsObject_t * selob)
+{
+  bool ok = false;
+  if (!obcla || !rps_is_valid_object (obcla))
+    return false;
+  if (!selob || !rps_is_valid_object (selob))
+    return false;
+  pthread_mutex_lock (&obcla->ob_mtx);
+  RpsClassInfo_t *clinf = rps_locked_object_classinfo (obcla);
+  if (!clinf || clinf->pclass_magic != RPS_CLASSINFO_MAGIC)
+    goto end;
+  clinf->pclass_methdict =
+    rps_attr_table_remove (clinf->pclass_methdict, selob);
+  rps_method_cache_invalidate ();
+  rps_locked_object_touch (obcla);
+  ok = true;
+end:
+  pthread_mutex_unlock (&obcla->ob_mtx);
+  return ok;
+}				/* end rps_obclass_remove_method */
+
+/// serializes superclass changes, so that two concurrent ones cannot
+/// make a cycle together; taken before any object lock
+static pthread_mutex_t rps_obclass_super_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+bool
+rps_obclass_put_super (RpsObject_t * obcla, RpsObject_t * obsuper)
+{
+  bool ok = false;
+  if (!obcla || !rps_is_valid_object (obcla))
+    return false;
+  if (obsuper && !rps_is_valid_object (obsuper))
+    return false;
+  pthread_mutex_lock (&rps_obclass_super_mtx);
+  /// reject a cycle, walking the superclasses one lock at a time; the
+  /// new depth of OBCLA should also stay below the display limit, but
+  /// its subclasses are not walked, so rps_build_class_display still
+  /// fails softly for them
+  RpsObject_t *curcla = obsuper;
+  int depth = 0;
+  while (curcla)
+    {
+      if (curcla == obcla || ++depth >= RPS_CLASSDISPLAY_MAX_DEPTH)
+	goto end;
+      RpsObject_t *nextcla = NULL;
+      pthread_mutex_lock (&curcla->ob_mtx);
+      RpsClassInfo_t *curinf = rps_locked_object_classinfo (curcla);
+      if (curinf && curinf->pclass_magic == RPS_CLASSINFO_MAGIC)
+	nextcla = curinf->pclass_super;
+      pthread_mutex_unlock (&curcla->ob_mtx);
+      curcla = nextcla;
+    };
+  pthread_mutex_lock (&obcla->ob_mtx);
+  RpsClassInfo_t *clinf = rps_locked_object_classinfo (obcla);
+  if (clinf && clinf->pclass_magic == RPS_CLASSINFO_MAGIC)
+    {
+      rps_locked_object_touch (obcla);
+      clinf->pclass_super = obsuper;
+      rps_method_cache_invalidate ();
+      rps_class_hierarchy_changed ();
+      ok = true;
+    };
+  pthread_mutex_unlock (&obcla->ob_mtx);
+end:
+  pthread_mutex_unlock (&rps_obclass_super_mtx);
+  return ok;
+}				/* end rps_obclass_put_super */
+
 
 /// rps_classinfo_payload_remover is a rps_payload_remover_t for classinfo
 /// it has been registered (in main) by rps_register_payload_removal
@@ -1491,6 +2732,10 @@ rps_classinfo_payload_remover (RpsObject_t * ob,
   clinf->pclass_super = NULL;	// will be garbage collected.
   clinf->pclass_methdict = NULL;	// will be garbage collected
   clinf->pclass_symbol = NULL;
+  rps_classinfo_free_flat_methods (clinf);
+  rps_classinfo_free_display (clinf);
+  rps_method_cache_invalidate ();
+  rps_class_hierarchy_changed ();
 #warning rps_classinfo_payload_remover need a code review
   /// TODO: should we also clear the zm_length, zm_xtra fields?
 }				/* end rps_classinfo_payload_remover */
@@ -1672,36 +2917,52 @@ rps_symbol_payload_dump_serializer (RpsDumper_t * du,
 }				/* end rps_symbol_payload_dump_serializer  */
 
 
-static pthread_mutex_t rps_obcreate_mtx = PTHREAD_MUTEX_INITIALIZER;
+/* Create a new object of a given class.  There is no global lock:
+   the oid is drawn from the per-thread generator, and the object is
+   inserted into its bucket only if no object of that oid is already
+   there, while holding that bucket mutex.  So threads creating
+   objects only contend when their oids fall in the same bucket. */
 RpsObject_t *
 rps_create_object_of_class (const RpsObject_t * obclass)
 {
   RpsObject_t *obres = NULL;
-  if (!rps_is_valid_object (obclass))
+  if (!rps_is_valid_object ((RpsObject_t *) obclass))
     return NULL;
   bool goodclass = false;
-  pthread_mutex_lock (&obclass->ob_mtx);
+  pthread_mutex_lock (&((RpsObject_t *) obclass)->ob_mtx);
   if (obclass->ob_payload
       && rps_is_valid_classinfo ((RpsClassInfo_t *) obclass->ob_payload))
     goodclass = true;
-  pthread_mutex_unlock (&obclass->ob_mtx);
+  pthread_mutex_unlock (&((RpsObject_t *) obclass)->ob_mtx);
   if (!goodclass)
     return NULL;
-  pthread_mutex_lock (&rps_obcreate_mtx);
   obres = RPS_ALLOC_ZONE (sizeof (RpsObject_t), RPS_TYPE_OBJECT);
   pthread_mutex_init (&obres->ob_mtx, &rps_objmutexattr);
-  RpsOid oid = RPS_OID_NULL;
+  obres->ob_magic = RPS_OBJ_MAGIC;
+  obres->ob_mtime = rps_clocktime (CLOCK_REALTIME);
+  rps_object_assign_index (obres);
+  rps_locked_object_put_class (obres, (RpsObject_t *) obclass);
+  rps_mtime_index_note (obres, obres->ob_mtime);
+  bool inserted = false;
   do
     {
-      oid = rps_oid_random ();
+      RpsOid oid = rps_oid_random ();
+      struct rps_object_bucket_st *curbuck =
+	rps_object_bucket_array + rps_oid_bucket_num (oid);
+      RpsObject_t **slot = NULL;
+      pthread_mutex_lock (&curbuck->obuck_mtx);
+      rps_locked_bucket_reserve (curbuck, 1);
+      if (!rps_locked_bucket_find_or_slot (curbuck, oid, &slot) && slot)
+	{
+	  obres->ob_id = oid;
+	  obres->zv_hash = rps_oid_hash (oid);
+	  *slot = obres;
+	  curbuck->obuck_card++;
+	  inserted = true;
+	};
+      pthread_mutex_unlock (&curbuck->obuck_mtx);
     }
-  while (rps_find_object_by_oid (oid) != NULL);
-  obres->ob_magic = RPS_OBJ_MAGIC;
-  obres->ob_id = oid;
-  obres->ob_class = obclass;
-  obres->zv_hash = rps_oid_hash (oid);
-end:
-  pthread_mutex_unlock (&rps_obcreate_mtx);
+  while (!inserted);
   return obres;
 }				/* end rps_create_object_of_class */
 
@@ -62,6 +62,96 @@ rps_oid_hash (const RpsOid oid)
   return h;
 }				/* end rps_oid_hash */
 
+/* Oids are converted by chunks of 5 base 62 digits, each fitting in
+   32 bits, so every division is of a 32 or 64 bits number by a
+   constant, which the compiler does by a reciprocal multiplication,
+   and pairs of digits are read from a table.  A textual oid is "_", 11
+   digits of id_hi and 7 digits of id_lo. */
+#define RPS_B62_POW5 916132832U	/* 62**5 */
+#define RPS_OID_CSTR_LEN 19
+
+/// the 62 pairs of base 62 digits starting with the digit string x
+#define RPS_B62PAIRS_ROW(x) \
+ x "0" x "1" x "2" x "3" x "4" x "5" x "6" x "7" x "8" x "9" x "a" \
+ x "b" x "c" x "d" x "e" x "f" x "g" x "h" x "i" x "j" x "k" x "l" \
+ x "m" x "n" x "o" x "p" x "q" x "r" x "s" x "t" x "u" x "v" x "w" \
+ x "x" x "y" x "z" x "A" x "B" x "C" x "D" x "E" x "F" x "G" x "H" \
+ x "I" x "J" x "K" x "L" x "M" x "N" x "O" x "P" x "Q" x "R" x "S" \
+ x "T" x "U" x "V" x "W" x "X" x "Y" x "Z"
+
+/* The 3844 pairs of digits, so rps_b62_pairs + 2*n are the two digits
+   of n, for n below 62*62. */
+static const char rps_b62_pairs[2 * 62 * 62 + 1] =
+  RPS_B62PAIRS_ROW ("0") RPS_B62PAIRS_ROW ("1") RPS_B62PAIRS_ROW ("2")
+  RPS_B62PAIRS_ROW ("3") RPS_B62PAIRS_ROW ("4") RPS_B62PAIRS_ROW ("5")
+  RPS_B62PAIRS_ROW ("6") RPS_B62PAIRS_ROW ("7") RPS_B62PAIRS_ROW ("8")
+  RPS_B62PAIRS_ROW ("9") RPS_B62PAIRS_ROW ("a") RPS_B62PAIRS_ROW ("b")
+  RPS_B62PAIRS_ROW ("c") RPS_B62PAIRS_ROW ("d") RPS_B62PAIRS_ROW ("e")
+  RPS_B62PAIRS_ROW ("f") RPS_B62PAIRS_ROW ("g") RPS_B62PAIRS_ROW ("h")
+  RPS_B62PAIRS_ROW ("i") RPS_B62PAIRS_ROW ("j") RPS_B62PAIRS_ROW ("k")
+  RPS_B62PAIRS_ROW ("l") RPS_B62PAIRS_ROW ("m") RPS_B62PAIRS_ROW ("n")
+  RPS_B62PAIRS_ROW ("o") RPS_B62PAIRS_ROW ("p") RPS_B62PAIRS_ROW ("q")
+  RPS_B62PAIRS_ROW ("r") RPS_B62PAIRS_ROW ("s") RPS_B62PAIRS_ROW ("t")
+  RPS_B62PAIRS_ROW ("u") RPS_B62PAIRS_ROW ("v") RPS_B62PAIRS_ROW ("w")
+  RPS_B62PAIRS_ROW ("x") RPS_B62PAIRS_ROW ("y") RPS_B62PAIRS_ROW ("z")
+  RPS_B62PAIRS_ROW ("A") RPS_B62PAIRS_ROW ("B") RPS_B62PAIRS_ROW ("C")
+  RPS_B62PAIRS_ROW ("D") RPS_B62PAIRS_ROW ("E") RPS_B62PAIRS_ROW ("F")
+  RPS_B62PAIRS_ROW ("G") RPS_B62PAIRS_ROW ("H") RPS_B62PAIRS_ROW ("I")
+  RPS_B62PAIRS_ROW ("J") RPS_B62PAIRS_ROW ("K") RPS_B62PAIRS_ROW ("L")
+  RPS_B62PAIRS_ROW ("M") RPS_B62PAIRS_ROW ("N") RPS_B62PAIRS_ROW ("O")
+  RPS_B62PAIRS_ROW ("P") RPS_B62PAIRS_ROW ("Q") RPS_B62PAIRS_ROW ("R")
+  RPS_B62PAIRS_ROW ("S") RPS_B62PAIRS_ROW ("T") RPS_B62PAIRS_ROW ("U")
+  RPS_B62PAIRS_ROW ("V") RPS_B62PAIRS_ROW ("W") RPS_B62PAIRS_ROW ("X")
+  RPS_B62PAIRS_ROW ("Y") RPS_B62PAIRS_ROW ("Z");
+
+/* The value of each byte as a base 62 digit, or 255 if it is not a
+   digit; a non-digit sets the high bit of an or-ed accumulator. */
+static const uint8_t rps_b62_digit_value[256] = {
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    0,   1,   2,   3,   4,   5,   6,   7,   8,   9, 255, 255, 255, 255, 255, 255,
+  255,  36,  37,  38,  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,  49,  50,
+   51,  52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255, 255, 255,
+  255,  10,  11,  12,  13,  14,  15,  16,  17,  18,  19,  20,  21,  22,  23,  24,
+   25,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255
+};
+
+/// put at DST the 5 digits of V, which is below 62**5
+static inline void
+rps_b62_put5 (char *dst, uint32_t v)
+{
+  uint32_t q = v / (62 * 62);
+  uint32_t r = v - q * (62 * 62);
+  uint32_t qq = q / (62 * 62);
+  uint32_t rq = q - qq * (62 * 62);
+  dst[0] = rps_sb62digits[qq];
+  memcpy (dst + 1, rps_b62_pairs + 2 * rq, 2);
+  memcpy (dst + 3, rps_b62_pairs + 2 * r, 2);
+}				/* end rps_b62_put5 */
+
+/// get the value of the 5 digits at SRC, or-ing their table values
+/// into *PBAD
+static inline uint32_t
+rps_b62_get5 (const unsigned char *src, unsigned *pbad)
+{
+  unsigned d0 = rps_b62_digit_value[src[0]];
+  unsigned d1 = rps_b62_digit_value[src[1]];
+  unsigned d2 = rps_b62_digit_value[src[2]];
+  unsigned d3 = rps_b62_digit_value[src[3]];
+  unsigned d4 = rps_b62_digit_value[src[4]];
+  *pbad |= d0 | d1 | d2 | d3 | d4;
+  return (((d0 * 62 + d1) * 62 + d2) * 62 + d3) * 62 + d4;
+}				/* end rps_b62_get5 */
+
 void
 rps_oid_to_cbuf (const RpsOid oid, char cbuf[RPS_OID_BUFLEN])
 {
@@ -74,35 +164,23 @@ rps_oid_to_cbuf (const RpsOid oid, char cbuf[RPS_OID_BUFLEN])
     };
   /// example cbuf = "_0abcdefghijABCDEFG"
   ///                  |0         |11    |19
-  memset (cbuf, 0, RPS_OID_BUFLEN);
-  char *last = cbuf + RPS_OID_HI_NBDIGITS;
-  char *pc = last;
-  cbuf[0] = '_';
-  uint64_t n = oid.id_hi;
-  do
-    {
-      unsigned d = n % RPS_OID_BASE;
-      n = n / RPS_OID_BASE;
-      *pc = rps_sb62digits[d];
-      pc--;
-    }
-  while (pc > cbuf);
-  char *start = cbuf + RPS_OID_HI_NBDIGITS;
-  last = start + RPS_NBDIGITS_OID_LO - 1;
-  pc = last;
-  n = oid.id_lo;
-  do
-    {
-      unsigned d = n % RPS_OID_BASE;
-      n = n / RPS_OID_BASE;
-      *pc = rps_sb62digits[d];
-      pc--;
-    }
-  while (pc > start);
-  if (rps_oid_is_valid (oid))
-    cbuf[0] = '_';
-  else
-    cbuf[0] = '!';
+  uint64_t hi = oid.id_hi;
+  uint64_t hihigh = hi / RPS_B62_POW5;
+  uint32_t hilow = (uint32_t) (hi - hihigh * RPS_B62_POW5);
+  /// below 22, since id_hi is below 2**64
+  uint32_t hitop = (uint32_t) (hihigh / RPS_B62_POW5);
+  uint32_t himid = (uint32_t) (hihigh - (uint64_t) hitop * RPS_B62_POW5);
+  /// like before, the digits of an invalid id_lo beyond 7 are dropped
+  uint64_t lo = oid.id_lo % RPS_MAX_OID_LO;
+  uint32_t lotop = (uint32_t) (lo / RPS_B62_POW5);
+  uint32_t lolow = (uint32_t) (lo - (uint64_t) lotop * RPS_B62_POW5);
+  cbuf[0] = rps_oid_is_valid (oid) ? '_' : '!';
+  cbuf[1] = rps_sb62digits[hitop];
+  rps_b62_put5 (cbuf + 2, himid);
+  rps_b62_put5 (cbuf + 7, hilow);
+  memcpy (cbuf + 12, rps_b62_pairs + 2 * lotop, 2);
+  rps_b62_put5 (cbuf + 14, lolow);
+  memset (cbuf + RPS_OID_CSTR_LEN, 0, RPS_OID_BUFLEN - RPS_OID_CSTR_LEN);
 }				/* end rps_oid_to_cbuf */
 
 int
@@ -131,33 +209,31 @@ RpsOid
 rps_cstr_to_oid (const char *cstr, const char **pend)
 {
   RPS_ASSERT (cstr != NULL);
-  if (cstr[0] != '_')
+  const unsigned char *ucs = (const unsigned char *) cstr;
+  /// the digits are read without stopping at a non-digit, so the
+  /// string should not be shorter
+  if (ucs[0] != '_' || strnlen (cstr, RPS_OID_CSTR_LEN) < RPS_OID_CSTR_LEN)
     goto fail;
-  if (!isdigit (cstr[1]))
+  unsigned bad = 0;
+  unsigned hitop = rps_b62_digit_value[ucs[1]];
+  /// the first digit of id_hi is a decimal one
+  bad |= hitop | ((unsigned) (hitop > 9) << 7);
+  uint64_t hi = ((uint64_t) hitop * RPS_B62_POW5
+		 + rps_b62_get5 (ucs + 2, &bad)) * RPS_B62_POW5
+    + rps_b62_get5 (ucs + 7, &bad);
+  unsigned lod0 = rps_b62_digit_value[ucs[12]];
+  unsigned lod1 = rps_b62_digit_value[ucs[13]];
+  bad |= lod0 | lod1;
+  uint64_t lo = (uint64_t) (lod0 * 62 + lod1) * RPS_B62_POW5
+    + rps_b62_get5 (ucs + 14, &bad);
+  if (bad & 0x80)
     goto fail;
-  uint64_t hi = 0, lo = 0;
-  const char *lasthi = cstr + RPS_OID_HI_NBDIGITS + 1;
-  const char *lastlo = lasthi + RPS_NBDIGITS_OID_LO - 1;
-  for (const char *pcb = cstr + 1; *pcb && pcb < lasthi; pcb++)
-    {
-      const char *pcs = strchr (rps_sb62digits, *pcb);
-      if (!pcs)
-	goto fail;
-      hi = hi * 62 + (pcs - rps_sb62digits);
-    }
   if ((hi > 0 && hi < RPS_OID_HI_MIN) || hi >= RPS_OID_HI_MAX)
     goto fail;
-  for (const char *pcb = lasthi; *pcb && pcb < lastlo; pcb++)
-    {
-      const char *pcs = strchr (rps_sb62digits, *pcb);
-      if (!pcs)
-	goto fail;
-      lo = lo * 62 + (pcs - rps_sb62digits);
-    };
   if ((lo > 0 && lo < RPS_MIN_OID_LO) || lo >= RPS_MAX_OID_LO)
     goto fail;
   if (pend)
-    *pend = lastlo;
+    *pend = cstr + RPS_OID_CSTR_LEN;
   RpsOid oid = {.id_hi = hi,.id_lo = lo };
   return oid;
 fail:
@@ -166,6 +242,36 @@ fail:
   return RPS_OID_NULL;
 }				/* end rps_cstr_to_oid */
 
+/* Batched conversions, for arrays of oids like the elements of sets
+   and tuples.  These are plain convenience loops calling the single
+   conversions above, which are table driven; they are not vectorized
+   kernels. */
+void
+rps_oids_to_cbufs (const RpsOid * oidarr, char (*cbufarr)[RPS_OID_BUFLEN],
+		   unsigned nb)
+{
+  if (!oidarr || !cbufarr)
+    return;
+  for (unsigned ix = 0; ix < nb; ix++)
+    rps_oid_to_cbuf (oidarr[ix], cbufarr[ix]);
+}				/* end rps_oids_to_cbufs */
+
+/// gives the number of valid oids, the invalid ones are null
+unsigned
+rps_cstrs_to_oids (const char *const *cstrarr, RpsOid * oidarr, unsigned nb)
+{
+  unsigned nbvalid = 0;
+  if (!cstrarr || !oidarr)
+    return 0;
+  for (unsigned ix = 0; ix < nb; ix++)
+    {
+      oidarr[ix] = cstrarr[ix] ? rps_cstr_to_oid (cstrarr[ix], NULL)
+	: RPS_OID_NULL;
+      nbvalid += !rps_oid_is_null (oidarr[ix]);
+    };
+  return nbvalid;
+}				/* end rps_cstrs_to_oids */
+
 
 
 /* The following functions are defined in oid_rps.h, and are wrappers around
@@ -203,18 +309,65 @@ rps_oid_bucket_num (const RpsOid oid)
   return b;
 }				/* end rps_oid_bucket_num */
 
+/* Each thread has its own xoshiro256** pseudo-random generator,
+   seeded once from glib's global one, so creating objects in many
+   threads does not contend on the glib PRNG lock. */
+static _Thread_local uint64_t rps_thread_random_state[4];
+static _Thread_local bool rps_thread_random_seeded;
+
+static inline uint64_t
+rps_rotl64 (const uint64_t x, int k)
+{
+  return (x << k) | (x >> (64 - k));
+}				/* end rps_rotl64 */
+
+static void
+rps_seed_thread_random (void)
+{
+  /// splitmix64 expansion of a seed mixing glib randomness, the
+  /// thread identity and the time
+  uint64_t sm = (((uint64_t) g_random_int ()) << 32)
+    ^ (uint64_t) g_random_int ()
+    ^ (uint64_t) pthread_self ()
+    ^ (uint64_t) (1.0e9 * rps_clocktime (CLOCK_MONOTONIC));
+  for (int ix = 0; ix < 4; ix++)
+    {
+      uint64_t z = (sm += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      rps_thread_random_state[ix] = z ^ (z >> 31);
+    };
+  rps_thread_random_seeded = true;
+}				/* end rps_seed_thread_random */
+
+uint64_t
+rps_random_uint64 (void)
+{
+  if (!rps_thread_random_seeded)
+    rps_seed_thread_random ();
+  uint64_t *st = rps_thread_random_state;
+  const uint64_t res = rps_rotl64 (st[1] * 5, 7) * 9;
+  const uint64_t t = st[1] << 17;
+  st[2] ^= st[0];
+  st[3] ^= st[1];
+  st[1] ^= st[2];
+  st[0] ^= st[3];
+  st[2] ^= t;
+  st[3] = rps_rotl64 (st[3], 45);
+  return res;
+}				/* end rps_random_uint64 */
+
 RpsOid
 rps_oid_random (void)
 {
   RpsOid roid = { 0, 0 };
-  do
-    {
-      roid.id_hi =
-	(((uint64_t) g_random_int ()) << 32) | ((uint32_t) g_random_int ());
-      roid.id_lo =
-	(((uint64_t) g_random_int ()) << 32) | ((uint32_t) g_random_int ());
-    }
-  while (!rps_oid_is_valid (roid));
+  /// draw directly inside the valid ranges; the modulo bias is
+  /// negligible for 64 bits random numbers
+  roid.id_hi = RPS_OID_HI_MIN
+    + rps_random_uint64 () % (RPS_OID_HI_MAX - RPS_OID_HI_MIN);
+  roid.id_lo = RPS_MIN_OID_LO
+    + rps_random_uint64 () % (RPS_MAX_OID_LO - RPS_MIN_OID_LO);
+  RPS_ASSERT (rps_oid_is_valid (roid));
   return roid;
 }				/* end rps_oid_random */
 
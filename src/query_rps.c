@@ -0,0 +1,603 @@
+/****************************************************************
+ * file query_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains a small query engine over the object graph, running
+ *      pipelines of filtering, following, joining and grouping
+ *      operators in parallel.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "Refpersys.h"
+
+/* A query is a source of objects followed by a sequence of stages.
+   Running it computes, stage after stage, a sorted array of distinct
+   objects, the same representation as the elements of a set.  Every
+   stage is applied by rps_parallel_for_each_index to the current
+   array, each worker appending into its own buffer; the buffers are
+   then merged, sorted and deduplicated.  When the source is all
+   objects, the leading filters are applied while iterating on the
+   object buckets with rps_parallel_for_each_object. */
+
+#define RPS_QUERY_MAGIC 0x1a7b3c5f	/*444316767 */
+
+enum rps_query_source_en
+{
+  RPSQSRC_NONE,
+  RPSQSRC_ALL_OBJECTS,
+  RPSQSRC_CLASS,
+  RPSQSRC_SET,
+};
+
+enum rps_query_stage_en
+{
+  RPSQSTAGE_NONE,
+  RPSQSTAGE_FILTER_CLOSURE,
+  RPSQSTAGE_FILTER_C,
+  RPSQSTAGE_FOLLOW_ATTRIBUTE,
+  RPSQSTAGE_FOLLOW_COMPONENT,
+  RPSQSTAGE_JOIN,
+};
+
+struct rps_query_stage_st
+{
+  enum rps_query_stage_en qs_kind;
+  const RpsClosure_t *qs_clos;
+  rps_object_callback_sig_t *qs_crout;
+  void *qs_cdata;
+  RpsObject_t *qs_obattr;
+  int qs_rank;
+  /// for joins, the sorted array of the other query result
+  RpsObject_t **qs_joinarr;
+  unsigned long qs_joinnb;
+};
+
+struct rps_query_st
+{
+  unsigned qu_magic;		/* RPS_QUERY_MAGIC */
+  enum rps_query_source_en qu_source;
+  RpsObject_t *qu_obclass;
+  bool qu_withsub;
+  const RpsSetOb_t *qu_set;
+  unsigned qu_nbstages, qu_sizestages;
+  struct rps_query_stage_st *qu_stages;
+};
+
+struct rps_query_buf_st
+{
+  RpsObject_t **qb_arr;
+  unsigned long qb_nb, qb_size;
+};
+
+static void
+rps_query_buf_add (struct rps_query_buf_st *qb, RpsObject_t * ob)
+{
+  if (qb->qb_nb >= qb->qb_size)
+    {
+      unsigned long newsize = rps_prime_above (qb->qb_size + qb->qb_size / 2
+					       + 30);
+      RpsObject_t **newarr =
+	RPS_ALLOC_ZEROED (newsize * sizeof (RpsObject_t *));
+      if (qb->qb_nb > 0)
+	memcpy (newarr, qb->qb_arr, qb->qb_nb * sizeof (RpsObject_t *));
+      free (qb->qb_arr);
+      qb->qb_arr = newarr;
+      qb->qb_size = newsize;
+    };
+  qb->qb_arr[qb->qb_nb++] = ob;
+}				/* end rps_query_buf_add */
+
+/// add the objects of an object, set or tuple value
+static void
+rps_query_buf_add_value (struct rps_query_buf_st *qb, RpsValue_t val)
+{
+  switch (rps_value_type (val))
+    {
+    case RPS_TYPE_OBJECT:
+      rps_query_buf_add (qb, (RpsObject_t *) val);
+      return;
+    case RPS_TYPE_SET:
+      {
+	const RpsSetOb_t *set = (const RpsSetOb_t *) val;
+	for (unsigned ix = 0; ix < set->zm_length; ix++)
+	  rps_query_buf_add (qb, (RpsObject_t *) set->set_elem[ix]);
+	return;
+      }
+    case RPS_TYPE_TUPLE:
+      {
+	const RpsTupleOb_t *tup = (const RpsTupleOb_t *) val;
+	for (unsigned ix = 0; ix < tup->zm_length; ix++)
+	  if (tup->tuple_comp[ix])
+	    rps_query_buf_add (qb, tup->tuple_comp[ix]);
+	return;
+      }
+    default:
+      return;
+    }
+}				/* end rps_query_buf_add_value */
+
+/* Concatenate NBBUF buffers, freeing them, into a sorted array of
+   distinct objects */
+static RpsObject_t **
+rps_query_merge_buffers (struct rps_query_buf_st *bufarr, int nbbuf,
+			 unsigned long *pnb)
+{
+  unsigned long total = 0;
+  for (int bix = 0; bix < nbbuf; bix++)
+    total += bufarr[bix].qb_nb;
+  RpsObject_t **arr = RPS_ALLOC_ZEROED ((total + 1) * sizeof (RpsObject_t *));
+  unsigned long nb = 0;
+  for (int bix = 0; bix < nbbuf; bix++)
+    {
+      if (bufarr[bix].qb_nb > 0)
+	memcpy (arr + nb, bufarr[bix].qb_arr,
+		bufarr[bix].qb_nb * sizeof (RpsObject_t *));
+      nb += bufarr[bix].qb_nb;
+      free (bufarr[bix].qb_arr);
+      memset (bufarr + bix, 0, sizeof (struct rps_query_buf_st));
+    };
+  rps_object_array_qsort ((const RpsObject_t **) arr, (int) nb);
+  unsigned long nbuniq = 0;
+  for (unsigned long ix = 0; ix < nb; ix++)
+    if (nbuniq == 0 || arr[nbuniq - 1] != arr[ix])
+      arr[nbuniq++] = arr[ix];
+  *pnb = nbuniq;
+  return arr;
+}				/* end rps_query_merge_buffers */
+
+static bool
+rps_query_array_contains (RpsObject_t ** arr, unsigned long nb,
+			  RpsObject_t * ob)
+{
+  unsigned long lo = 0, hi = nb;
+  while (lo < hi)
+    {
+      unsigned long md = lo + (hi - lo) / 2;
+      int cmp = rps_object_cmp (arr[md], ob);
+      if (cmp == 0)
+	return true;
+      if (cmp < 0)
+	lo = md + 1;
+      else
+	hi = md;
+    };
+  return false;
+}				/* end rps_query_array_contains */
+
+/// apply a stage to one object, appending its results into QB
+static void
+rps_query_stage_object (const struct rps_query_stage_st *st,
+			RpsObject_t * ob, struct rps_query_buf_st *qb)
+{
+  switch (st->qs_kind)
+    {
+    case RPSQSTAGE_FILTER_CLOSURE:
+      if (rps_closure_apply_v (NULL, st->qs_clos, (RpsValue_t) ob,
+			       RPS_NULL_VALUE, RPS_NULL_VALUE,
+			       RPS_NULL_VALUE) != RPS_NULL_VALUE)
+	rps_query_buf_add (qb, ob);
+      return;
+    case RPSQSTAGE_FILTER_C:
+      if ((*st->qs_crout) (ob, st->qs_cdata))
+	rps_query_buf_add (qb, ob);
+      return;
+    case RPSQSTAGE_FOLLOW_ATTRIBUTE:
+      {
+	pthread_mutex_lock (&ob->ob_mtx);
+	RpsValue_t val = rps_locked_object_get_any_attribute (ob,
+							      st->qs_obattr);
+	pthread_mutex_unlock (&ob->ob_mtx);
+	rps_query_buf_add_value (qb, val);
+	return;
+      }
+    case RPSQSTAGE_FOLLOW_COMPONENT:
+      {
+	RpsValue_t val = RPS_NULL_VALUE;
+	pthread_mutex_lock (&ob->ob_mtx);
+	int rank = st->qs_rank;
+	if (rank < 0)
+	  rank += (int) ob->ob_nbcomp;
+	if (rank >= 0 && rank < (int) ob->ob_nbcomp)
+	  val = ob->ob_comparr[rank];
+	pthread_mutex_unlock (&ob->ob_mtx);
+	rps_query_buf_add_value (qb, val);
+	return;
+      }
+    case RPSQSTAGE_JOIN:
+      {
+	RpsObject_t *obkey = ob;
+	if (st->qs_obattr)
+	  {
+	    pthread_mutex_lock (&ob->ob_mtx);
+	    RpsValue_t val = rps_locked_object_get_any_attribute (ob,
+								  st->qs_obattr);
+	    pthread_mutex_unlock (&ob->ob_mtx);
+	    obkey = (rps_value_type (val) == RPS_TYPE_OBJECT)
+	      ? (RpsObject_t *) val : NULL;
+	  };
+	if (obkey
+	    && rps_query_array_contains (st->qs_joinarr, st->qs_joinnb,
+					 obkey))
+	  rps_query_buf_add (qb, ob);
+	return;
+      }
+    default:
+      RPS_FATAL ("corrupted query stage kind#%d", (int) st->qs_kind);
+    }
+}				/* end rps_query_stage_object */
+
+/************************ running queries ************************/
+
+struct rps_query_run_st
+{
+  const struct rps_query_stage_st *qr_stages;
+  unsigned qr_nbstages;
+  RpsObject_t **qr_arr;
+  struct rps_query_buf_st qr_bufarr[RPS_MAX_NB_THREADS];
+};
+
+static rps_parallel_object_callback_sig_t rps_query_all_objects_cb;
+static bool
+rps_query_all_objects_cb (RpsObject_t * ob, int workix, void *data)
+{
+  struct rps_query_run_st *qr = data;
+  for (unsigned six = 0; six < qr->qr_nbstages; six++)
+    {
+      const struct rps_query_stage_st *st = qr->qr_stages + six;
+      bool keep = (st->qs_kind == RPSQSTAGE_FILTER_CLOSURE)
+	? (rps_closure_apply_v (NULL, st->qs_clos, (RpsValue_t) ob,
+				RPS_NULL_VALUE, RPS_NULL_VALUE,
+				RPS_NULL_VALUE) != RPS_NULL_VALUE)
+	: (*st->qs_crout) (ob, st->qs_cdata);
+      if (!keep)
+	return true;
+    };
+  rps_query_buf_add (qr->qr_bufarr + workix, ob);
+  return true;
+}				/* end rps_query_all_objects_cb */
+
+static rps_parallel_index_callback_sig_t rps_query_stage_cb;
+static void
+rps_query_stage_cb (unsigned long ix, int workix, void *data)
+{
+  struct rps_query_run_st *qr = data;
+  rps_query_stage_object (qr->qr_stages, qr->qr_arr[ix],
+			  qr->qr_bufarr + workix);
+}				/* end rps_query_stage_cb */
+
+static int
+rps_query_nb_threads (int nbthreads)
+{
+  if (nbthreads <= 0)
+    nbthreads = rps_nb_threads;
+  if (nbthreads <= 0)
+    nbthreads = 1;
+  else if (nbthreads > RPS_MAX_NB_THREADS)
+    nbthreads = RPS_MAX_NB_THREADS;
+  return nbthreads;
+}				/* end rps_query_nb_threads */
+
+/// run a query, giving a malloc-ed sorted array of distinct objects
+static RpsObject_t **
+rps_query_run_array (RpsQuery_t * q, int nbthreads, unsigned long *pnb)
+{
+  RPS_ASSERT (q && q->qu_magic == RPS_QUERY_MAGIC);
+  nbthreads = rps_query_nb_threads (nbthreads);
+  struct rps_query_run_st *qr =
+    RPS_ALLOC_ZEROED (sizeof (struct rps_query_run_st));
+  RpsObject_t **arr = NULL;
+  unsigned long nb = 0;
+  unsigned six = 0;
+  switch (q->qu_source)
+    {
+    case RPSQSRC_ALL_OBJECTS:
+      {
+	while (six < q->qu_nbstages
+	       && (q->qu_stages[six].qs_kind == RPSQSTAGE_FILTER_CLOSURE
+		   || q->qu_stages[six].qs_kind == RPSQSTAGE_FILTER_C))
+	  six++;
+	qr->qr_stages = q->qu_stages;
+	qr->qr_nbstages = six;
+	rps_parallel_for_each_object (rps_query_all_objects_cb, qr,
+				      nbthreads);
+	arr = rps_query_merge_buffers (qr->qr_bufarr, nbthreads, &nb);
+	break;
+      }
+    case RPSQSRC_CLASS:
+    case RPSQSRC_SET:
+      {
+	const RpsSetOb_t *set = (q->qu_source == RPSQSRC_CLASS)
+	  ? rps_obclass_set_of_instances (q->qu_obclass, q->qu_withsub)
+	  : q->qu_set;
+	nb = set ? set->zm_length : 0;
+	arr = RPS_ALLOC_ZEROED ((nb + 1) * sizeof (RpsObject_t *));
+	if (nb > 0)
+	  memcpy (arr, set->set_elem, nb * sizeof (RpsObject_t *));
+	break;
+      }
+    default:
+      RPS_FATAL ("corrupted query source#%d", (int) q->qu_source);
+    };
+  for (; six < q->qu_nbstages && nb > 0; six++)
+    {
+      qr->qr_stages = q->qu_stages + six;
+      qr->qr_nbstages = 1;
+      qr->qr_arr = arr;
+      rps_parallel_for_each_index (nb, nbthreads, rps_query_stage_cb, qr);
+      free (arr);
+      qr->qr_arr = NULL;
+      arr = rps_query_merge_buffers (qr->qr_bufarr, nbthreads, &nb);
+    };
+  free (qr);
+  *pnb = nb;
+  return arr;
+}				/* end rps_query_run_array */
+
+/************************ public interface ************************/
+
+static RpsQuery_t *
+rps_query_make (enum rps_query_source_en src)
+{
+  RpsQuery_t *q = RPS_ALLOC_ZEROED (sizeof (RpsQuery_t));
+  q->qu_magic = RPS_QUERY_MAGIC;
+  q->qu_source = src;
+  return q;
+}				/* end rps_query_make */
+
+RpsQuery_t *
+rps_query_of_all_objects (void)
+{
+  return rps_query_make (RPSQSRC_ALL_OBJECTS);
+}				/* end rps_query_of_all_objects */
+
+RpsQuery_t *
+rps_query_of_class (RpsObject_t * obcla, bool withsub)
+{
+  if (!obcla)
+    return NULL;
+  RpsQuery_t *q = rps_query_make (RPSQSRC_CLASS);
+  q->qu_obclass = obcla;
+  q->qu_withsub = withsub;
+  return q;
+}				/* end rps_query_of_class */
+
+RpsQuery_t *
+rps_query_of_set (const RpsSetOb_t * set)
+{
+  if (set && rps_value_type ((RpsValue_t) set) != RPS_TYPE_SET)
+    return NULL;
+  RpsQuery_t *q = rps_query_make (RPSQSRC_SET);
+  q->qu_set = set;
+  return q;
+}				/* end rps_query_of_set */
+
+static struct rps_query_stage_st *
+rps_query_add_stage (RpsQuery_t * q, enum rps_query_stage_en kind)
+{
+  RPS_ASSERT (q && q->qu_magic == RPS_QUERY_MAGIC);
+  if (q->qu_nbstages >= q->qu_sizestages)
+    {
+      unsigned newsize = q->qu_sizestages + q->qu_sizestages / 2 + 4;
+      struct rps_query_stage_st *newarr =
+	RPS_ALLOC_ZEROED (newsize * sizeof (struct rps_query_stage_st));
+      if (q->qu_nbstages > 0)
+	memcpy (newarr, q->qu_stages,
+		q->qu_nbstages * sizeof (struct rps_query_stage_st));
+      free (q->qu_stages);
+      q->qu_stages = newarr;
+      q->qu_sizestages = newsize;
+    };
+  struct rps_query_stage_st *st = q->qu_stages + q->qu_nbstages++;
+  st->qs_kind = kind;
+  return st;
+}				/* end rps_query_add_stage */
+
+void
+rps_query_filter (RpsQuery_t * q, const RpsClosure_t * clos)
+{
+  if (!clos || rps_value_type ((RpsValue_t) clos) != RPS_TYPE_CLOSURE)
+    RPS_FATAL ("rps_query_filter without closure");
+  rps_query_add_stage (q, RPSQSTAGE_FILTER_CLOSURE)->qs_clos = clos;
+}				/* end rps_query_filter */
+
+void
+rps_query_filter_c (RpsQuery_t * q, rps_object_callback_sig_t * rout,
+		    void *data)
+{
+  if (!rout)
+    RPS_FATAL ("rps_query_filter_c without routine");
+  struct rps_query_stage_st *st =
+    rps_query_add_stage (q, RPSQSTAGE_FILTER_C);
+  st->qs_crout = rout;
+  st->qs_cdata = data;
+}				/* end rps_query_filter_c */
+
+void
+rps_query_follow_attribute (RpsQuery_t * q, RpsObject_t * obattr)
+{
+  if (!obattr)
+    RPS_FATAL ("rps_query_follow_attribute without attribute");
+  rps_query_add_stage (q, RPSQSTAGE_FOLLOW_ATTRIBUTE)->qs_obattr = obattr;
+}				/* end rps_query_follow_attribute */
+
+void
+rps_query_follow_component (RpsQuery_t * q, int rank)
+{
+  rps_query_add_stage (q, RPSQSTAGE_FOLLOW_COMPONENT)->qs_rank = rank;
+}				/* end rps_query_follow_component */
+
+void
+rps_query_join (RpsQuery_t * q, RpsQuery_t * other, RpsObject_t * obattr,
+		int nbthreads)
+{
+  RPS_ASSERT (other && other->qu_magic == RPS_QUERY_MAGIC);
+  RPS_ASSERT (q != other);
+  unsigned long nb = 0;
+  RpsObject_t **arr = rps_query_run_array (other, nbthreads, &nb);
+  struct rps_query_stage_st *st = rps_query_add_stage (q, RPSQSTAGE_JOIN);
+  st->qs_obattr = obattr;
+  st->qs_joinarr = arr;
+  st->qs_joinnb = nb;
+}				/* end rps_query_join */
+
+void
+rps_query_free (RpsQuery_t * q)
+{
+  if (!q)
+    return;
+  RPS_ASSERT (q->qu_magic == RPS_QUERY_MAGIC);
+  for (unsigned six = 0; six < q->qu_nbstages; six++)
+    free (q->qu_stages[six].qs_joinarr);
+  free (q->qu_stages);
+  memset (q, 0, sizeof (RpsQuery_t));
+  free (q);
+}				/* end rps_query_free */
+
+const RpsSetOb_t *
+rps_query_run_set (RpsQuery_t * q, int nbthreads)
+{
+  unsigned long nb = 0;
+  RpsObject_t **arr = rps_query_run_array (q, nbthreads, &nb);
+  const RpsSetOb_t *set =
+    rps_alloc_set_sized ((unsigned) nb, (const RpsObject_t **) arr);
+  free (arr);
+  return set;
+}				/* end rps_query_run_set */
+
+const RpsTupleOb_t *
+rps_query_run_tuple (RpsQuery_t * q, int nbthreads)
+{
+  unsigned long nb = 0;
+  RpsObject_t **arr = rps_query_run_array (q, nbthreads, &nb);
+  const RpsTupleOb_t *tup = rps_alloc_tuple_sized ((unsigned) nb, arr);
+  free (arr);
+  return tup;
+}				/* end rps_query_run_tuple */
+
+unsigned long
+rps_query_count (RpsQuery_t * q, int nbthreads)
+{
+  unsigned long nb = 0;
+  RpsObject_t **arr = rps_query_run_array (q, nbthreads, &nb);
+  free (arr);
+  return nb;
+}				/* end rps_query_count */
+
+struct rps_query_keyed_st
+{
+  RpsValue_t qk_key;
+  RpsObject_t *qk_ob;
+};
+
+struct rps_query_grouping_st
+{
+  RpsObject_t **qg_arr;
+  struct rps_query_keyed_st *qg_keyedarr;
+  RpsObject_t *qg_obattr;
+};
+
+static rps_parallel_index_callback_sig_t rps_query_key_cb;
+static void
+rps_query_key_cb (unsigned long ix, int workix, void *data)
+{
+  struct rps_query_grouping_st *gr = data;
+  RpsObject_t *ob = gr->qg_arr[ix];
+  pthread_mutex_lock (&ob->ob_mtx);
+  gr->qg_keyedarr[ix].qk_key =
+    rps_locked_object_get_any_attribute (ob, gr->qg_obattr);
+  pthread_mutex_unlock (&ob->ob_mtx);
+  gr->qg_keyedarr[ix].qk_ob = ob;
+}				/* end rps_query_key_cb */
+
+static int
+rps_query_keyed_qcmp (const void *p1, const void *p2)
+{
+  const struct rps_query_keyed_st *k1 = p1;
+  const struct rps_query_keyed_st *k2 = p2;
+  int cmp = rps_value_cmp (k1->qk_key, k2->qk_key);
+  if (cmp)
+    return cmp;
+  return rps_object_cmp (k1->qk_ob, k2->qk_ob);
+}				/* end rps_query_keyed_qcmp */
+
+/* Run the query and group its resulting objects by their value of
+   OBATTR, which may be the class or space attribute.  Gives a malloc-ed
+   array of *PNBGROUPS groups ordered by rps_value_cmp on their keys;
+   objects without that attribute are in the group of the nil key. */
+struct rps_query_group_st *
+rps_query_group_by (RpsQuery_t * q, RpsObject_t * obattr, int nbthreads,
+		    unsigned *pnbgroups)
+{
+  RPS_ASSERT (pnbgroups != NULL);
+  *pnbgroups = 0;
+  if (!obattr)
+    return NULL;
+  nbthreads = rps_query_nb_threads (nbthreads);
+  unsigned long nb = 0;
+  struct rps_query_grouping_st gr = {.qg_obattr = obattr };
+  gr.qg_arr = rps_query_run_array (q, nbthreads, &nb);
+  gr.qg_keyedarr =
+    RPS_ALLOC_ZEROED ((nb + 1) * sizeof (struct rps_query_keyed_st));
+  rps_parallel_for_each_index (nb, nbthreads, rps_query_key_cb, &gr);
+  free (gr.qg_arr);
+  qsort (gr.qg_keyedarr, nb, sizeof (struct rps_query_keyed_st),
+	 rps_query_keyed_qcmp);
+  unsigned nbgroups = 0;
+  for (unsigned long ix = 0; ix < nb; ix++)
+    if (ix == 0 || rps_value_cmp (gr.qg_keyedarr[ix - 1].qk_key,
+				  gr.qg_keyedarr[ix].qk_key))
+      nbgroups++;
+  struct rps_query_group_st *grparr =
+    RPS_ALLOC_ZEROED ((nbgroups + 1) * sizeof (struct rps_query_group_st));
+  RpsObject_t **obarr = RPS_ALLOC_ZEROED ((nb + 1) * sizeof (RpsObject_t *));
+  unsigned long start = 0;
+  unsigned gix = 0;
+  while (start < nb)
+    {
+      unsigned long end = start + 1;
+      while (end < nb && !rps_value_cmp (gr.qg_keyedarr[start].qk_key,
+					 gr.qg_keyedarr[end].qk_key))
+	end++;
+      for (unsigned long ix = start; ix < end; ix++)
+	obarr[ix - start] = gr.qg_keyedarr[ix].qk_ob;
+      grparr[gix].qg_key = gr.qg_keyedarr[start].qk_key;
+      grparr[gix].qg_count = end - start;
+      grparr[gix].qg_set =
+	rps_alloc_set_sized ((unsigned) (end - start),
+			     (const RpsObject_t **) obarr);
+      gix++;
+      start = end;
+    };
+  RPS_ASSERT (gix == nbgroups);
+  free (obarr);
+  free (gr.qg_keyedarr);
+  *pnbgroups = nbgroups;
+  return grparr;
+}				/* end rps_query_group_by */
+
+/****** end of file query_rps.c ******/
@@ -0,0 +1,294 @@
+/****************************************************************
+ * file refgraph_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the reverse reference index, telling which objects
+ *      refer to a given one, and shortest reference paths from the
+ *      global roots, computed by a parallel heap walk.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "Refpersys.h"
+
+/* The heap is walked from the global root objects by the parallel
+   mode of rps_traverse_objects, keeping every edge.  The traversal is
+   level by level, so the object from which each object is first
+   reached, its parent, is at the previous level; following these
+   parents from any object gives a shortest path to some root.  The
+   edges are then sorted by their target, giving for each object index
+   the range of its referring objects.  The result is a snapshot of
+   the heap at walk time, not maintained after. */
+
+struct rps_refedge_st
+{
+  RpsObject_t *re_from;
+  RpsObject_t *re_to;
+};
+
+struct rps_refgraph_st
+{
+  uint32_t rg_bound;		/* the object index bound at walk time */
+  /// the parent of every reached object, a root is its own parent
+  RpsObject_t **rg_parentarr;
+  /// the referring objects of the object of index ix are
+  /// rg_referarr[rg_startarr[ix]] ... rg_referarr[rg_startarr[ix+1]-1]
+  unsigned long *rg_startarr;
+  RpsObject_t **rg_referarr;
+  unsigned long rg_nbreached;
+  double rg_walktime;
+};
+
+static pthread_mutex_t rps_refgraph_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct rps_refgraph_st *rps_refgraph;
+
+struct rps_refwalk_buf_st
+{
+  struct rps_refedge_st *rwb_edgarr;
+  unsigned long rwb_nbedges, rwb_sizedges;
+};
+
+struct rps_refwalk_st
+{
+  uint32_t rw_bound;
+  RpsObject_t **rw_parentarr;
+  struct rps_refwalk_buf_st rw_bufarr[RPS_MAX_NB_THREADS];
+};
+
+static rps_traversal_visitor_sig_t rps_refwalk_visitor;
+static enum rps_visit_en
+rps_refwalk_visitor (RpsObject_t * ob, RpsObject_t * obfrom,
+		     unsigned depth, int workix, void *data)
+{
+  struct rps_refwalk_st *rw = data;
+  uint32_t ix = rps_object_index (ob);
+  /// objects created during the walk are ignored
+  if (ix == 0 || ix >= rw->rw_bound)
+    return RPS_VISIT_PRUNE;
+  rw->rw_parentarr[ix] = obfrom ? obfrom : ob;
+  return RPS_VISIT_CONTINUE;
+}				/* end rps_refwalk_visitor */
+
+static rps_traversal_edge_sig_t rps_refwalk_edge;
+static void
+rps_refwalk_edge (RpsObject_t * obfrom, RpsObject_t * obto, int workix,
+		  void *data)
+{
+  struct rps_refwalk_st *rw = data;
+  struct rps_refwalk_buf_st *wb = rw->rw_bufarr + workix;
+  uint32_t ix = rps_object_index (obto);
+  if (ix == 0 || ix >= rw->rw_bound)
+    return;
+  if (wb->rwb_nbedges >= wb->rwb_sizedges)
+    {
+      unsigned long newsize =
+	rps_prime_above (wb->rwb_sizedges + wb->rwb_sizedges / 2 + 100);
+      struct rps_refedge_st *newarr =
+	RPS_ALLOC_ZEROED (newsize * sizeof (struct rps_refedge_st));
+      if (wb->rwb_nbedges > 0)
+	memcpy (newarr, wb->rwb_edgarr,
+		wb->rwb_nbedges * sizeof (struct rps_refedge_st));
+      free (wb->rwb_edgarr);
+      wb->rwb_edgarr = newarr;
+      wb->rwb_sizedges = newsize;
+    };
+  wb->rwb_edgarr[wb->rwb_nbedges].re_from = obfrom;
+  wb->rwb_edgarr[wb->rwb_nbedges].re_to = obto;
+  wb->rwb_nbedges++;
+}				/* end rps_refwalk_edge */
+
+static int
+rps_refedge_qcmp (const void *p1, const void *p2)
+{
+  const struct rps_refedge_st *e1 = p1;
+  const struct rps_refedge_st *e2 = p2;
+  uint32_t ix1 = rps_object_index (e1->re_to);
+  uint32_t ix2 = rps_object_index (e2->re_to);
+  if (ix1 != ix2)
+    return (ix1 < ix2) ? -1 : 1;
+  return rps_object_cmp (e1->re_from, e2->re_from);
+}				/* end rps_refedge_qcmp */
+
+static void
+rps_refgraph_free (struct rps_refgraph_st *rg)
+{
+  if (!rg)
+    return;
+  free (rg->rg_parentarr);
+  free (rg->rg_startarr);
+  free (rg->rg_referarr);
+  free (rg);
+}				/* end rps_refgraph_free */
+
+/* Walk the heap from the global roots in NBTHREADS threads (or
+   rps_nb_threads if not positive) and replace the reverse reference
+   index; gives the number of visited objects.  Objects should not be
+   freed meanwhile. */
+unsigned long
+rps_build_reverse_references (int nbthreads)
+{
+  if (nbthreads <= 0)
+    nbthreads = rps_nb_threads;
+  if (nbthreads <= 0)
+    nbthreads = 1;
+  else if (nbthreads > RPS_MAX_NB_THREADS)
+    nbthreads = RPS_MAX_NB_THREADS;
+  struct rps_refwalk_st *rw = RPS_ALLOC_ZEROED (sizeof (*rw));
+  rw->rw_bound = rps_object_index_bound ();
+  rw->rw_parentarr =
+    RPS_ALLOC_ZEROED ((rw->rw_bound + 1) * sizeof (RpsObject_t *));
+  unsigned long nbreached =
+    rps_traverse_objects (rps_set_of_global_root_objects (),
+			  RPS_TRAVERSE_PARALLEL, RPS_VISITED_MARKS,
+			  rps_refwalk_visitor, rps_refwalk_edge, rw,
+			  nbthreads);
+  /// gather, sort and deduplicate the edges by their target
+  unsigned long nbedges = 0;
+  for (int wix = 0; wix < nbthreads; wix++)
+    nbedges += rw->rw_bufarr[wix].rwb_nbedges;
+  struct rps_refedge_st *edgarr =
+    RPS_ALLOC_ZEROED ((nbedges + 1) * sizeof (struct rps_refedge_st));
+  {
+    unsigned long eix = 0;
+    for (int wix = 0; wix < nbthreads; wix++)
+      {
+	struct rps_refwalk_buf_st *wb = rw->rw_bufarr + wix;
+	if (wb->rwb_nbedges > 0)
+	  memcpy (edgarr + eix, wb->rwb_edgarr,
+		  wb->rwb_nbedges * sizeof (struct rps_refedge_st));
+	eix += wb->rwb_nbedges;
+	free (wb->rwb_edgarr);
+      };
+  }
+  qsort (edgarr, nbedges, sizeof (struct rps_refedge_st), rps_refedge_qcmp);
+  struct rps_refgraph_st *rg = RPS_ALLOC_ZEROED (sizeof (*rg));
+  rg->rg_bound = rw->rw_bound;
+  rg->rg_parentarr = rw->rw_parentarr;
+  rg->rg_startarr =
+    RPS_ALLOC_ZEROED ((rw->rw_bound + 1) * sizeof (unsigned long));
+  rg->rg_referarr = RPS_ALLOC_ZEROED ((nbedges + 1) * sizeof (RpsObject_t *));
+  unsigned long nbrefer = 0;
+  uint32_t curix = 0;
+  for (unsigned long eix = 0; eix < nbedges; eix++)
+    {
+      if (eix > 0 && edgarr[eix].re_to == edgarr[eix - 1].re_to
+	  && edgarr[eix].re_from == edgarr[eix - 1].re_from)
+	continue;
+      uint32_t toix = rps_object_index (edgarr[eix].re_to);
+      while (curix < toix)
+	rg->rg_startarr[++curix] = nbrefer;
+      rg->rg_referarr[nbrefer++] = edgarr[eix].re_from;
+    };
+  while (curix < rw->rw_bound)
+    rg->rg_startarr[++curix] = nbrefer;
+  free (edgarr);
+  free (rw);
+  rg->rg_nbreached = nbreached;
+  rg->rg_walktime = rps_clocktime (CLOCK_REALTIME);
+  pthread_mutex_lock (&rps_refgraph_mtx);
+  struct rps_refgraph_st *oldrg = rps_refgraph;
+  rps_refgraph = rg;
+  pthread_mutex_unlock (&rps_refgraph_mtx);
+  rps_refgraph_free (oldrg);
+  return nbreached;
+}				/* end rps_build_reverse_references */
+
+bool
+rps_reverse_references_built (void)
+{
+  pthread_mutex_lock (&rps_refgraph_mtx);
+  bool built = rps_refgraph != NULL;
+  pthread_mutex_unlock (&rps_refgraph_mtx);
+  return built;
+}				/* end rps_reverse_references_built */
+
+void
+rps_forget_reverse_references (void)
+{
+  pthread_mutex_lock (&rps_refgraph_mtx);
+  struct rps_refgraph_st *oldrg = rps_refgraph;
+  rps_refgraph = NULL;
+  pthread_mutex_unlock (&rps_refgraph_mtx);
+  rps_refgraph_free (oldrg);
+}				/* end rps_forget_reverse_references */
+
+/// the objects referring to OB at the last walk, NULL if none was done
+const RpsSetOb_t *
+rps_objects_referring_to (RpsObject_t * ob)
+{
+  const RpsSetOb_t *set = NULL;
+  uint32_t ix = rps_object_index (ob);
+  pthread_mutex_lock (&rps_refgraph_mtx);
+  struct rps_refgraph_st *rg = rps_refgraph;
+  if (rg)
+    {
+      unsigned long start = 0, end = 0;
+      if (ix > 0 && ix < rg->rg_bound)
+	{
+	  start = rg->rg_startarr[ix];
+	  end = rg->rg_startarr[ix + 1];
+	};
+      set = rps_alloc_set_sized ((unsigned) (end - start),
+				 (const RpsObject_t **) rg->rg_referarr +
+				 start);
+    };
+  pthread_mutex_unlock (&rps_refgraph_mtx);
+  return set;
+}				/* end rps_objects_referring_to */
+
+/* A shortest reference path from a global root to OB at the last walk,
+   as a tuple starting with the root and ending with OB, or NULL if OB
+   was not reached or no walk was done. */
+const RpsTupleOb_t *
+rps_reference_path_from_roots (RpsObject_t * ob)
+{
+  const RpsTupleOb_t *tup = NULL;
+  uint32_t ix = rps_object_index (ob);
+  pthread_mutex_lock (&rps_refgraph_mtx);
+  struct rps_refgraph_st *rg = rps_refgraph;
+  if (rg && ix > 0 && ix < rg->rg_bound && rg->rg_parentarr[ix])
+    {
+      unsigned len = 1;
+      for (RpsObject_t * cur = ob; rg->rg_parentarr[rps_object_index (cur)]
+	   != cur; cur = rg->rg_parentarr[rps_object_index (cur)])
+	len++;
+      RpsObject_t **patharr =
+	RPS_ALLOC_ZEROED ((len + 1) * sizeof (RpsObject_t *));
+      RpsObject_t *cur = ob;
+      for (unsigned pix = len; pix > 0; pix--)
+	{
+	  patharr[pix - 1] = cur;
+	  cur = rg->rg_parentarr[rps_object_index (cur)];
+	};
+      tup = rps_alloc_tuple_sized (len, patharr);
+      free (patharr);
+    };
+  pthread_mutex_unlock (&rps_refgraph_mtx);
+  return tup;
+}				/* end rps_reference_path_from_roots */
+
+/****** end of file refgraph_rps.c ******/
@@ -0,0 +1,375 @@
+/****************************************************************
+ * file selector_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the dense numbering of selectors, and the
+ *      flattened method tables of classes indexed by them.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "Refpersys.h"
+
+/* Selector numbers are found in an insert only open-addressed table
+   read without locking, like shape transitions in shape_rps.c; it is
+   updated under rps_selnum_mtx, and replaced by a bigger copy when
+   too full, the old one being retired (see epoch_rps.c) since a
+   reader could still scan it.  Threads not registered for that
+   reclamation read it under rps_selnum_mtx.  The rps_selnum_selarr
+   maps numbers back to selectors. */
+
+struct rps_selnum_entry_st
+{
+  const RpsObject_t *_Atomic sne_selob;	/* stored after sne_num */
+  unsigned sne_num;
+};
+
+struct rps_selnum_table_st
+{
+  unsigned snt_size;		/* a prime */
+  struct rps_selnum_entry_st snt_arr[];
+};
+
+static pthread_mutex_t rps_selnum_mtx = PTHREAD_MUTEX_INITIALIZER;
+static struct rps_selnum_table_st *_Atomic rps_selnum_table;
+static atomic_uint rps_selnum_bound = 1;	/* 0 is no selector */
+static unsigned rps_selnum_selsize;
+static const RpsObject_t **rps_selnum_selarr;
+
+static unsigned
+rps_selnum_find (struct rps_selnum_table_st *tbl, const RpsObject_t * selob)
+{
+  if (!tbl)
+    return 0;
+  unsigned tsiz = tbl->snt_size;
+  unsigned ix = selob->zv_hash % tsiz;
+  for (unsigned cnt = 0; cnt < tsiz; cnt++)
+    {
+      struct rps_selnum_entry_st *ent = tbl->snt_arr + ix;
+      const RpsObject_t *cursel = atomic_load (&ent->sne_selob);
+      if (cursel == selob)
+	return ent->sne_num;
+      if (cursel == NULL)
+	return 0;
+      if (++ix >= tsiz)
+	ix = 0;
+    };
+  return 0;
+}				/* end rps_selnum_find */
+
+static void
+rps_selnum_insert (struct rps_selnum_table_st *tbl,
+		   const RpsObject_t * selob, unsigned num)
+{
+  unsigned tsiz = tbl->snt_size;
+  unsigned ix = selob->zv_hash % tsiz;
+  while (atomic_load (&tbl->snt_arr[ix].sne_selob) != NULL)
+    if (++ix >= tsiz)
+      ix = 0;
+  tbl->snt_arr[ix].sne_num = num;
+  atomic_store (&tbl->snt_arr[ix].sne_selob, selob);
+}				/* end rps_selnum_insert */
+
+unsigned
+rps_selector_number (const RpsObject_t * selob)
+{
+  if (!selob)
+    return 0;
+  unsigned num = 0;
+  if (rps_epoch_is_registered ())
+    {
+      num = rps_selnum_find (atomic_load (&rps_selnum_table), selob);
+      if (num > 0)
+	return num;
+    };
+  pthread_mutex_lock (&rps_selnum_mtx);
+  struct rps_selnum_table_st *tbl = atomic_load (&rps_selnum_table);
+  num = rps_selnum_find (tbl, selob);
+  if (num > 0)
+    goto end;
+  num = atomic_load (&rps_selnum_bound);
+  if (!tbl || 3 * num > 2 * tbl->snt_size)
+    {
+      unsigned newsiz = (unsigned) rps_prime_above (2 * num + 30);
+      struct rps_selnum_table_st *newtbl =
+	RPS_ALLOC_ZEROED (sizeof (struct rps_selnum_table_st)
+			  + newsiz * sizeof (struct rps_selnum_entry_st));
+      newtbl->snt_size = newsiz;
+      for (unsigned ix = 0; tbl && ix < tbl->snt_size; ix++)
+	{
+	  const RpsObject_t *cursel =
+	    atomic_load (&tbl->snt_arr[ix].sne_selob);
+	  if (cursel)
+	    rps_selnum_insert (newtbl, cursel, tbl->snt_arr[ix].sne_num);
+	};
+      atomic_store (&rps_selnum_table, newtbl);
+      rps_epoch_retire (tbl, NULL);
+      tbl = newtbl;
+    };
+  if (num >= rps_selnum_selsize)
+    {
+      unsigned newselsize = (unsigned) rps_prime_above (num + num / 2 + 20);
+      const RpsObject_t **newselarr =
+	RPS_ALLOC_ZEROED (newselsize * sizeof (RpsObject_t *));
+      if (rps_selnum_selarr)
+	memcpy (newselarr, rps_selnum_selarr,
+		rps_selnum_selsize * sizeof (RpsObject_t *));
+      free (rps_selnum_selarr);
+      rps_selnum_selarr = newselarr;
+      rps_selnum_selsize = newselsize;
+    };
+  rps_selnum_selarr[num] = selob;
+  rps_selnum_insert (tbl, selob, num);
+  atomic_store (&rps_selnum_bound, num + 1);
+end:
+  pthread_mutex_unlock (&rps_selnum_mtx);
+  return num;
+}				/* end rps_selector_number */
+
+unsigned
+rps_selector_number_bound (void)
+{
+  return atomic_load (&rps_selnum_bound);
+}				/* end rps_selector_number_bound */
+
+RpsObject_t *
+rps_selector_of_number (unsigned selnum)
+{
+  RpsObject_t *selob = NULL;
+  pthread_mutex_lock (&rps_selnum_mtx);
+  if (selnum > 0 && selnum < atomic_load (&rps_selnum_bound))
+    selob = (RpsObject_t *) rps_selnum_selarr[selnum];
+  pthread_mutex_unlock (&rps_selnum_mtx);
+  return selob;
+}				/* end rps_selector_of_number */
+
+
+/*****************************************************************
+ * Flattened method tables.  They are computed without holding the
+ * lock of the class, since every ancestor class is locked in turn,
+ * and installed afterwards.  A table is stamped with the method cache
+ * epoch read before computing it, so any concurrent change of some
+ * class makes it stale.
+ *
+ * The table is installed under the class lock, by an atomic pointer,
+ * and the replaced one is retired (see epoch_rps.c), so threads
+ * registered for that reclamation dispatch without locking the class.
+ * Class information payloads are never freed but by the garbage
+ * collector, so they are also found without locking.  Other threads
+ * read the current table under the class lock, which is needed to
+ * replace it.
+ *****************************************************************/
+
+struct rps_flatpair_st
+{
+  unsigned fp_selnum;
+  RpsClosure_t *fp_clos;
+};
+
+static struct rps_flatmethods_st *
+rps_build_flat_methods (RpsObject_t * obcla, unsigned long epoch)
+{
+  unsigned nbpairs = 0, sizepairs = 16, maxselnum = 0;
+  struct rps_flatpair_st *pairarr =
+    RPS_ALLOC_ZEROED (sizepairs * sizeof (struct rps_flatpair_st));
+  RpsObject_t *curcla = obcla;
+  int depth = 0;
+  // Even with buggy heap, we don't want to loop indefinitely....
+  while (curcla && depth < 100)
+    {
+      RpsObject_t *superob = NULL;
+      pthread_mutex_lock (&curcla->ob_mtx);
+      RpsClassInfo_t *clinf = rps_locked_object_classinfo (curcla);
+      if (clinf && clinf->pclass_magic == RPS_CLASSINFO_MAGIC)
+	{
+	  RpsAttrTable_t *methdict = clinf->pclass_methdict;
+	  unsigned dictsiz =
+	    methdict ? (unsigned) rps_prime_of_index (methdict->zm_xtra) : 0;
+	  for (unsigned mix = 0; mix < dictsiz; mix++)
+	    {
+	      RpsObject_t *selob = methdict->attr_entries[mix].ent_attr;
+	      RpsValue_t methv = methdict->attr_entries[mix].ent_val;
+	      if (!selob || rps_value_type (methv) != RPS_TYPE_CLOSURE)
+		continue;
+	      if (nbpairs >= sizepairs)
+		{
+		  unsigned newsizepairs = 2 * sizepairs + 16;
+		  struct rps_flatpair_st *newpairarr =
+		    RPS_ALLOC_ZEROED (newsizepairs *
+				      sizeof (struct rps_flatpair_st));
+		  memcpy (newpairarr, pairarr,
+			  nbpairs * sizeof (struct rps_flatpair_st));
+		  free (pairarr);
+		  pairarr = newpairarr;
+		  sizepairs = newsizepairs;
+		};
+	      unsigned selnum = rps_selector_number (selob);
+	      pairarr[nbpairs].fp_selnum = selnum;
+	      pairarr[nbpairs].fp_clos = (RpsClosure_t *) methv;
+	      nbpairs++;
+	      if (selnum > maxselnum)
+		maxselnum = selnum;
+	    };
+	  superob = clinf->pclass_super;
+	};
+      pthread_mutex_unlock (&curcla->ob_mtx);
+      curcla = superob;
+      depth++;
+    };
+  struct rps_flatmethods_st *flat =
+    RPS_ALLOC_ZEROED (sizeof (struct rps_flatmethods_st)
+		      + (maxselnum + 1) * sizeof (RpsClosure_t *));
+  flat->fm_epoch = epoch;
+  flat->fm_size = maxselnum + 1;
+  /// the pairs of subclasses come first, and override inherited methods
+  for (unsigned pix = 0; pix < nbpairs; pix++)
+    {
+      unsigned selnum = pairarr[pix].fp_selnum;
+      if (!flat->fm_arr[selnum])
+	{
+	  flat->fm_arr[selnum] = pairarr[pix].fp_clos;
+	  flat->fm_count++;
+	}
+    };
+  free (pairarr);
+  return flat;
+}				/* end rps_build_flat_methods */
+
+/* return the up to date flattened table of a class, or NULL if it
+   should be rebuilt; the class is locked, or the caller is registered
+   for reclamation */
+static struct rps_flatmethods_st *
+rps_locked_class_current_flat_methods (RpsObject_t * obcla,
+				       unsigned long epoch)
+{
+  RpsClassInfo_t *clinf = rps_locked_object_classinfo (obcla);
+  if (!clinf || clinf->pclass_magic != RPS_CLASSINFO_MAGIC)
+    return NULL;
+  struct rps_flatmethods_st *flat = atomic_load (&clinf->pclass_flatmeth);
+  if (flat && flat->fm_epoch == epoch)
+    return flat;
+  return NULL;
+}				/* end rps_locked_class_current_flat_methods */
+
+/* lock the class OBCLA, with an up to date flattened table in *PFLAT
+   (which is NULL if OBCLA is not a class) */
+static void
+rps_lock_class_with_flat_methods (RpsObject_t * obcla,
+				  struct rps_flatmethods_st **pflat)
+{
+  unsigned long epoch = rps_method_cache_epoch ();
+  pthread_mutex_lock (&obcla->ob_mtx);
+  *pflat = rps_locked_class_current_flat_methods (obcla, epoch);
+  if (*pflat || !rps_locked_object_classinfo (obcla))
+    return;
+  pthread_mutex_unlock (&obcla->ob_mtx);
+  struct rps_flatmethods_st *newflat = rps_build_flat_methods (obcla, epoch);
+  pthread_mutex_lock (&obcla->ob_mtx);
+  RpsClassInfo_t *clinf = rps_locked_object_classinfo (obcla);
+  if (!clinf || clinf->pclass_magic != RPS_CLASSINFO_MAGIC)
+    {
+      free (newflat);
+      *pflat = NULL;
+      return;
+    };
+  /// lock-free readers may still use the old table
+  rps_epoch_retire (atomic_exchange (&clinf->pclass_flatmeth, newflat),
+		    NULL);
+  *pflat = newflat;
+}				/* end rps_lock_class_with_flat_methods */
+
+RpsClosure_t *
+rps_obclass_flat_method (RpsObject_t * obcla, unsigned selnum)
+{
+  RpsClosure_t *clos = NULL;
+  struct rps_flatmethods_st *flat = NULL;
+  if (!obcla || !rps_is_valid_object (obcla) || selnum == 0)
+    return NULL;
+  if (rps_epoch_is_registered ())
+    {
+      /// the common case, without locking, see comment above
+      flat = rps_locked_class_current_flat_methods
+	(obcla, rps_method_cache_epoch ());
+      if (!flat)
+	{
+	  rps_lock_class_with_flat_methods (obcla, &flat);
+	  pthread_mutex_unlock (&obcla->ob_mtx);
+	};
+      if (flat && selnum < flat->fm_size)
+	clos = flat->fm_arr[selnum];
+      return clos;
+    };
+  rps_lock_class_with_flat_methods (obcla, &flat);
+  if (flat && selnum < flat->fm_size)
+    clos = flat->fm_arr[selnum];
+  pthread_mutex_unlock (&obcla->ob_mtx);
+  return clos;
+}				/* end rps_obclass_flat_method */
+
+bool
+rps_obclass_responds_to (RpsObject_t * obcla, const RpsObject_t * selob)
+{
+  if (!selob)
+    return false;
+  return rps_obclass_flat_method (obcla, rps_selector_number (selob)) != NULL;
+}				/* end rps_obclass_responds_to */
+
+const RpsSetOb_t *
+rps_obclass_set_of_selectors (RpsObject_t * obcla)
+{
+  struct rps_flatmethods_st *flat = NULL;
+  if (!obcla || !rps_is_valid_object (obcla))
+    return NULL;
+  rps_lock_class_with_flat_methods (obcla, &flat);
+  if (!flat)
+    {
+      pthread_mutex_unlock (&obcla->ob_mtx);
+      return NULL;
+    };
+  const RpsObject_t **selarr =
+    RPS_ALLOC_ZEROED ((flat->fm_count + 1) * sizeof (RpsObject_t *));
+  unsigned nbsel = 0;
+  pthread_mutex_lock (&rps_selnum_mtx);
+  for (unsigned selnum = 1; selnum < flat->fm_size; selnum++)
+    if (flat->fm_arr[selnum])
+      selarr[nbsel++] = rps_selnum_selarr[selnum];
+  pthread_mutex_unlock (&rps_selnum_mtx);
+  RPS_ASSERT (nbsel == flat->fm_count);
+  pthread_mutex_unlock (&obcla->ob_mtx);
+  const RpsSetOb_t *setv = rps_alloc_set_sized (nbsel, selarr);
+  free (selarr);
+  return setv;
+}				/* end rps_obclass_set_of_selectors */
+
+void
+rps_classinfo_free_flat_methods (RpsClassInfo_t * clinf)
+{
+  if (!clinf)
+    return;
+  rps_epoch_retire (atomic_exchange (&clinf->pclass_flatmeth, NULL), NULL);
+}				/* end rps_classinfo_free_flat_methods */
+
+/****** end of file selector_rps.c ******/
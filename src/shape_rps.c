@@ -0,0 +1,531 @@
+/****************************************************************
+ * file shape_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the shapes (or hidden classes) describing the
+ *      attributes of most objects, and their transitions.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "Refpersys.h"
+
+/* A shape lists its attributes by slot index.  Small shapes are
+   scanned linearly by pointer equality, larger ones have an immutable
+   hashed index built once at creation.  The transitions from a shape,
+   adding one attribute, are in an open-addressed table which is read
+   without locking; it is only updated while holding rps_shape_mtx,
+   and entries are never removed.  A full transition table is replaced
+   by a bigger copy, and the old one is retired, see epoch_rps.c, since
+   some reader could still scan it.
+
+   Likewise, rps_get_object_attribute_cached reads the ob_shape and
+   ob_shapvals of objects without locking them.  Writers, holding the
+   object lock, publish a grown values array before the shape using
+   it, and retire the replaced array.  Since shapes only grow, slots
+   keep their index, so any values array seen after some shape has
+   all its slots. */
+
+struct rps_shape_transentry_st
+{
+  RpsObject_t *_Atomic stra_attr;	/* stored after stra_shape */
+  const RpsShape_t *stra_shape;
+};
+
+struct rps_shape_transitions_st
+{
+  unsigned strans_size;		/* a prime */
+  unsigned strans_count;
+  struct rps_shape_transentry_st strans_arr[];
+};
+
+static pthread_mutex_t rps_shape_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+static RpsShape_t rps_shape_root_shape = {
+  .shap_magic = RPS_SHAPE_MAGIC,
+  .shap_nbattrs = 0,
+  .shap_parent = NULL,
+  .shap_transitions = NULL,
+  .shap_indexsize = 0,
+  .shap_index = NULL,
+};
+
+const RpsShape_t *
+rps_shape_root (void)
+{
+  return &rps_shape_root_shape;
+}				/* end rps_shape_root */
+
+bool
+rps_is_valid_shape (const RpsShape_t * sh)
+{
+  if (!sh)
+    return false;
+  if (sh->shap_magic != RPS_SHAPE_MAGIC)
+    return false;
+  if (sh->shap_nbattrs > RPS_SHAPE_MAX_ATTRS)
+    return false;
+  return true;
+}				/* end rps_is_valid_shape */
+
+int
+rps_shape_slot_of_attribute (const RpsShape_t * sh,
+			     const RpsObject_t * obattr)
+{
+  RPS_ASSERT (rps_is_valid_shape (sh));
+  if (!obattr)
+    return -1;
+  unsigned nbattrs = sh->shap_nbattrs;
+  if (sh->shap_indexsize == 0)
+    {
+      for (unsigned ix = 0; ix < nbattrs; ix++)
+	if (sh->shap_attrs[ix] == obattr)
+	  return (int) ix;
+      return -1;
+    };
+  unsigned isiz = sh->shap_indexsize;
+  unsigned ix = obattr->zv_hash % isiz;
+  for (unsigned cnt = 0; cnt < isiz; cnt++)
+    {
+      unsigned slotp1 = sh->shap_index[ix];
+      if (slotp1 == 0)
+	return -1;
+      if (sh->shap_attrs[slotp1 - 1] == obattr)
+	return (int) slotp1 - 1;
+      if (++ix >= isiz)
+	ix = 0;
+    };
+  return -1;
+}				/* end rps_shape_slot_of_attribute */
+
+static const RpsShape_t *
+rps_shape_find_transition (const RpsShape_t * sh, const RpsObject_t * obattr)
+{
+  struct rps_shape_transitions_st *trans =
+    atomic_load (&((RpsShape_t *) sh)->shap_transitions);
+  if (!trans)
+    return NULL;
+  unsigned tsiz = trans->strans_size;
+  unsigned ix = obattr->zv_hash % tsiz;
+  for (unsigned cnt = 0; cnt < tsiz; cnt++)
+    {
+      struct rps_shape_transentry_st *ent = trans->strans_arr + ix;
+      RpsObject_t *curattr = atomic_load (&ent->stra_attr);
+      if (curattr == obattr)
+	return ent->stra_shape;
+      if (curattr == NULL)
+	return NULL;
+      if (++ix >= tsiz)
+	ix = 0;
+    };
+  return NULL;
+}				/* end rps_shape_find_transition */
+
+/* add an entry, known to be absent, into a transition table with
+   enough room */
+static void
+rps_shape_transitions_insert (struct rps_shape_transitions_st *trans,
+			      RpsObject_t * obattr,
+			      const RpsShape_t * newsh)
+{
+  unsigned tsiz = trans->strans_size;
+  unsigned ix = obattr->zv_hash % tsiz;
+  RPS_ASSERT (trans->strans_count < tsiz);
+  while (atomic_load (&trans->strans_arr[ix].stra_attr) != NULL)
+    if (++ix >= tsiz)
+      ix = 0;
+  trans->strans_arr[ix].stra_shape = newsh;
+  atomic_store (&trans->strans_arr[ix].stra_attr, obattr);
+  trans->strans_count++;
+}				/* end rps_shape_transitions_insert */
+
+/* make the shape extending SH with OBATTR, called with rps_shape_mtx
+   locked */
+static RpsShape_t *
+rps_shape_make_child (const RpsShape_t * sh, RpsObject_t * obattr)
+{
+  unsigned nbattrs = sh->shap_nbattrs + 1;
+  RpsShape_t *newsh =
+    RPS_ALLOC_ZEROED (sizeof (RpsShape_t) + nbattrs * sizeof (RpsObject_t *));
+  newsh->shap_magic = RPS_SHAPE_MAGIC;
+  newsh->shap_nbattrs = nbattrs;
+  newsh->shap_parent = sh;
+  memcpy (newsh->shap_attrs, sh->shap_attrs,
+	  (nbattrs - 1) * sizeof (RpsObject_t *));
+  newsh->shap_attrs[nbattrs - 1] = obattr;
+  if (nbattrs > RPS_ATTR_TABLE_SMALL_SIZE)
+    {
+      unsigned isiz = (unsigned) rps_prime_above (2 * nbattrs);
+      newsh->shap_index = RPS_ALLOC_ZEROED (isiz * sizeof (unsigned short));
+      newsh->shap_indexsize = isiz;
+      for (unsigned slot = 0; slot < nbattrs; slot++)
+	{
+	  unsigned ix = newsh->shap_attrs[slot]->zv_hash % isiz;
+	  while (newsh->shap_index[ix] != 0)
+	    if (++ix >= isiz)
+	      ix = 0;
+	  newsh->shap_index[ix] = (unsigned short) (slot + 1);
+	}
+    };
+  return newsh;
+}				/* end rps_shape_make_child */
+
+const RpsShape_t *
+rps_shape_add_attribute (const RpsShape_t * sh, RpsObject_t * obattr)
+{
+  RPS_ASSERT (rps_is_valid_shape (sh));
+  RPS_ASSERT (rps_is_valid_object (obattr));
+  if (sh->shap_nbattrs >= RPS_SHAPE_MAX_ATTRS)
+    return NULL;
+  RPS_ASSERT (rps_shape_slot_of_attribute (sh, obattr) < 0);
+  /// the common case, without locking
+  const RpsShape_t *newsh = rps_shape_find_transition (sh, obattr);
+  if (newsh)
+    return newsh;
+  pthread_mutex_lock (&rps_shape_mtx);
+  newsh = rps_shape_find_transition (sh, obattr);
+  if (newsh)
+    goto end;
+  RpsShape_t *mutsh = (RpsShape_t *) sh;
+  struct rps_shape_transitions_st *trans =
+    atomic_load (&mutsh->shap_transitions);
+  if (!trans || 3 * (trans->strans_count + 1) > 2 * trans->strans_size)
+    {
+      unsigned oldcount = trans ? trans->strans_count : 0;
+      unsigned newsiz = (unsigned) rps_prime_above (2 * oldcount + 4);
+      struct rps_shape_transitions_st *newtrans =
+	RPS_ALLOC_ZEROED (sizeof (struct rps_shape_transitions_st)
+			  +
+			  newsiz * sizeof (struct rps_shape_transentry_st));
+      newtrans->strans_size = newsiz;
+      for (unsigned ix = 0; trans && ix < trans->strans_size; ix++)
+	{
+	  RpsObject_t *curattr = atomic_load (&trans->strans_arr[ix].stra_attr);
+	  if (curattr)
+	    rps_shape_transitions_insert (newtrans, curattr,
+					  trans->strans_arr[ix].stra_shape);
+	};
+      atomic_store (&mutsh->shap_transitions, newtrans);
+      rps_epoch_retire (trans, NULL);
+      trans = newtrans;
+    };
+  newsh = rps_shape_make_child (sh, obattr);
+  rps_shape_transitions_insert (trans, obattr, newsh);
+end:
+  pthread_mutex_unlock (&rps_shape_mtx);
+  RPS_ASSERT (newsh->shap_parent == sh);
+  return newsh;
+}				/* end rps_shape_add_attribute */
+
+
+/*****************************************************************
+ * Attributes of locked objects.  An object without shape and without
+ * attribute table has no attributes.
+ *****************************************************************/
+
+RpsValue_t
+rps_locked_object_get_attribute (RpsObject_t * ob,
+				 const RpsObject_t * obattr)
+{
+  RPS_ASSERT (ob != NULL);
+  const RpsShape_t *sh = ob->ob_shape;
+  if (sh)
+    {
+      int slot = rps_shape_slot_of_attribute (sh, obattr);
+      if (slot < 0)
+	return RPS_NULL_VALUE;
+      return ob->ob_shapvals[slot];
+    };
+  if (ob->ob_attrtable)
+    return rps_attr_table_find (ob->ob_attrtable, (RpsObject_t *) obattr);
+  return RPS_NULL_VALUE;
+}				/* end rps_locked_object_get_attribute */
+
+/* move the shaped attributes of a locked object into a new attribute
+   table with room for NBEXTRA more */
+static void
+rps_locked_object_unshape (RpsObject_t * ob, unsigned nbextra)
+{
+  const RpsShape_t *sh = ob->ob_shape;
+  RPS_ASSERT (rps_is_valid_shape (sh));
+  RPS_ASSERT (ob->ob_attrtable == NULL);
+  unsigned nbattrs = sh->shap_nbattrs;
+  RpsAttrTable_t *tbl = rps_alloc_empty_attr_table (nbattrs + nbextra);
+  for (unsigned slot = 0; slot < nbattrs; slot++)
+    tbl = rps_attr_table_put (tbl, sh->shap_attrs[slot],
+			      ob->ob_shapvals[slot]);
+  /// lock-free readers see a NULL ob_shape or ob_shapvals and then lock
+  RpsValue_t *oldvals = ob->ob_shapvals;
+  ob->ob_shape = NULL;
+  ob->ob_shapvals = NULL;
+  rps_epoch_retire (oldvals, NULL);
+  ob->ob_attrtable = tbl;
+}				/* end rps_locked_object_unshape */
+
+void
+rps_locked_object_put_attribute (RpsObject_t * ob, RpsObject_t * obattr,
+				 RpsValue_t val)
+{
+  RPS_ASSERT (ob != NULL);
+  if (!obattr || val == RPS_NULL_VALUE)
+    return;
+  rps_locked_object_touch (ob);
+  if (rps_attr_indexes_exist ())
+    rps_attr_index_update (ob, obattr,
+			   rps_locked_object_get_attribute (ob, obattr), val);
+  rps_trigram_note_value (ob, val);
+  if (ob->ob_attrtable)
+    {
+      RPS_ASSERT (ob->ob_shape == NULL);
+      ob->ob_attrtable = rps_attr_table_put (ob->ob_attrtable, obattr, val);
+      return;
+    };
+  const RpsShape_t *sh = ob->ob_shape;
+  if (!sh)
+    sh = &rps_shape_root_shape;
+  int slot = rps_shape_slot_of_attribute (sh, obattr);
+  if (slot >= 0)
+    {
+      ob->ob_shapvals[slot] = val;
+      return;
+    };
+  const RpsShape_t *newsh = rps_shape_add_attribute (sh, obattr);
+  if (!newsh)
+    {
+      rps_locked_object_unshape (ob, RPS_SHAPE_MAX_ATTRS / 4);
+      ob->ob_attrtable = rps_attr_table_put (ob->ob_attrtable, obattr, val);
+      return;
+    };
+  unsigned nbattrs = sh->shap_nbattrs;
+  if (rps_shape_values_capacity (nbattrs + 1) >
+      rps_shape_values_capacity (nbattrs))
+    {
+      RpsValue_t *newvals =
+	RPS_ALLOC_ZEROED (rps_shape_values_capacity (nbattrs + 1)
+			  * sizeof (RpsValue_t));
+      RpsValue_t *oldvals = ob->ob_shapvals;
+      if (nbattrs > 0)
+	memcpy (newvals, oldvals, nbattrs * sizeof (RpsValue_t));
+      ob->ob_shapvals = newvals;
+      rps_epoch_retire (oldvals, NULL);
+    };
+  ob->ob_shapvals[nbattrs] = val;
+  ob->ob_shape = newsh;
+}				/* end rps_locked_object_put_attribute */
+
+struct rps_attrpair_st
+{
+  RpsObject_t *ap_attr;
+  RpsValue_t ap_val;
+  unsigned ap_rank;		/* position in the given arrays */
+};
+
+static int
+rps_attrpair_qcmp (const void *p1, const void *p2)
+{
+  const struct rps_attrpair_st *pair1 = p1;
+  const struct rps_attrpair_st *pair2 = p2;
+  int cmp = rps_object_cmp (pair1->ap_attr, pair2->ap_attr);
+  if (cmp)
+    return cmp;
+  return (pair1->ap_rank < pair2->ap_rank) ? -1 : +1;
+}				/* end rps_attrpair_qcmp */
+
+/* Attributes are sorted by oid, so objects given the same attribute
+   set, notably by the loader, share the same shape. */
+unsigned
+rps_locked_object_put_attributes (RpsObject_t * ob, unsigned nbattrs,
+				  RpsObject_t * const *attrarr,
+				  const RpsValue_t * valarr)
+{
+  RPS_ASSERT (ob != NULL);
+  if (nbattrs == 0)
+    return 0;
+  RPS_ASSERT (attrarr != NULL && valarr != NULL);
+  rps_locked_object_touch (ob);
+  struct rps_attrpair_st *pairarr =
+    RPS_ALLOC_ZEROED (nbattrs * sizeof (struct rps_attrpair_st));
+  unsigned nbpairs = 0;
+  for (unsigned ix = 0; ix < nbattrs; ix++)
+    {
+      if (!attrarr[ix] || valarr[ix] == RPS_NULL_VALUE)
+	continue;
+      pairarr[nbpairs].ap_attr = attrarr[ix];
+      pairarr[nbpairs].ap_val = valarr[ix];
+      pairarr[nbpairs].ap_rank = ix;
+      nbpairs++;
+    };
+  qsort (pairarr, nbpairs, sizeof (struct rps_attrpair_st),
+	 rps_attrpair_qcmp);
+  /// keep only the last value of repeated attributes
+  unsigned nbuniq = 0;
+  for (unsigned ix = 0; ix < nbpairs; ix++)
+    {
+      if (nbuniq > 0 && pairarr[nbuniq - 1].ap_attr == pairarr[ix].ap_attr)
+	pairarr[nbuniq - 1] = pairarr[ix];
+      else
+	pairarr[nbuniq++] = pairarr[ix];
+    };
+  if (rps_attr_indexes_exist ())
+    for (unsigned ix = 0; ix < nbuniq; ix++)
+      {
+	RpsObject_t *curattr = pairarr[ix].ap_attr;
+	RpsValue_t oldval = rps_locked_object_get_attribute (ob, curattr);
+	rps_attr_index_update (ob, curattr, oldval, pairarr[ix].ap_val);
+      };
+  for (unsigned ix = 0; ix < nbuniq; ix++)
+    rps_trigram_note_value (ob, pairarr[ix].ap_val);
+  const RpsShape_t *sh = ob->ob_shape;
+  if (!sh && !ob->ob_attrtable)
+    sh = &rps_shape_root_shape;
+  if (sh)
+    {
+      /// find the final shape, following the cached transitions
+      const RpsShape_t *newsh = sh;
+      for (unsigned ix = 0; newsh && ix < nbuniq; ix++)
+	if (rps_shape_slot_of_attribute (sh, pairarr[ix].ap_attr) < 0)
+	  newsh = rps_shape_add_attribute (newsh, pairarr[ix].ap_attr);
+      if (newsh)
+	{
+	  unsigned oldnb = sh->shap_nbattrs;
+	  unsigned newnb = newsh->shap_nbattrs;
+	  if (rps_shape_values_capacity (newnb) >
+	      rps_shape_values_capacity (oldnb))
+	    {
+	      RpsValue_t *newvals =
+		RPS_ALLOC_ZEROED (rps_shape_values_capacity (newnb)
+				  * sizeof (RpsValue_t));
+	      RpsValue_t *oldvals = ob->ob_shapvals;
+	      if (oldnb > 0)
+		memcpy (newvals, oldvals, oldnb * sizeof (RpsValue_t));
+	      ob->ob_shapvals = newvals;
+	      rps_epoch_retire (oldvals, NULL);
+	    };
+	  for (unsigned ix = 0; ix < nbuniq; ix++)
+	    {
+	      int slot =
+		rps_shape_slot_of_attribute (newsh, pairarr[ix].ap_attr);
+	      RPS_ASSERT (slot >= 0);
+	      ob->ob_shapvals[slot] = pairarr[ix].ap_val;
+	    };
+	  if (newsh != sh)
+	    ob->ob_shape = newsh;
+	  goto end;
+	};
+      /// too many attributes for a shape
+      if (ob->ob_shape)
+	rps_locked_object_unshape (ob, nbuniq);
+    };
+  ob->ob_attrtable = rps_attr_table_reserve (ob->ob_attrtable, nbuniq);
+  for (unsigned ix = 0; ix < nbuniq; ix++)
+    ob->ob_attrtable = rps_attr_table_put (ob->ob_attrtable,
+					   pairarr[ix].ap_attr,
+					   pairarr[ix].ap_val);
+end:
+  free (pairarr);
+  return nbuniq;
+}				/* end rps_locked_object_put_attributes */
+
+unsigned
+rps_locked_object_nb_attributes (RpsObject_t * ob)
+{
+  RPS_ASSERT (ob != NULL);
+  if (ob->ob_shape)
+    return ob->ob_shape->shap_nbattrs;
+  return rps_attr_table_size (ob->ob_attrtable);
+}				/* end rps_locked_object_nb_attributes */
+
+unsigned
+rps_locked_object_iterate_attributes (RpsObject_t * ob,
+				      rps_object_callback_sig_t * routattr,
+				      rps_value_callback_sig_t * routval,
+				      void *data)
+{
+  RPS_ASSERT (ob != NULL);
+  const RpsShape_t *sh = ob->ob_shape;
+  if (!sh)
+    return rps_attr_table_iterate (ob->ob_attrtable, routattr, routval,
+				   data);
+  unsigned nbiter = 0;
+  for (unsigned slot = 0; slot < sh->shap_nbattrs; slot++)
+    {
+      if (routattr && !(*routattr) (sh->shap_attrs[slot], data))
+	break;
+      if (routval && !(*routval) (ob->ob_shapvals[slot], data))
+	break;
+      nbiter++;
+    };
+  return nbiter;
+}				/* end rps_locked_object_iterate_attributes */
+
+const RpsSetOb_t *
+rps_locked_object_set_of_attributes (RpsObject_t * ob)
+{
+  RPS_ASSERT (ob != NULL);
+  const RpsShape_t *sh = ob->ob_shape;
+  if (!sh)
+    {
+      if (!ob->ob_attrtable)
+	return NULL;
+      return rps_attr_table_set_of_attributes (ob->ob_attrtable);
+    };
+  return rps_alloc_set_sized (sh->shap_nbattrs,
+			      (const RpsObject_t **) sh->shap_attrs);
+}				/* end rps_locked_object_set_of_attributes */
+
+RpsValue_t
+rps_get_object_attribute_cached (RpsObject_t * ob, RpsObject_t * obattr,
+				 RpsAttrCache_t * cache)
+{
+  if (!ob || !obattr)
+    return RPS_NULL_VALUE;
+  RPS_ASSERT (cache != NULL);
+  RPS_ASSERT (rps_is_valid_object (ob));
+  /// without locking, see the comment at the start of this file;
+  /// only threads registered for reclamation may do that
+  const RpsShape_t *sh = ob->ob_shape;
+  const RpsValue_t *vals = ob->ob_shapvals;
+  if (sh && vals && rps_epoch_is_registered ())
+    {
+      /* the cache may be concurrently updated by another thread, so
+         its slot is checked against the immutable shape */
+      unsigned cslot = atomic_load (&cache->ac_slot);
+      if (atomic_load (&cache->ac_shape) == sh
+	  && cslot < sh->shap_nbattrs && sh->shap_attrs[cslot] == obattr)
+	return vals[cslot];
+      int slot = rps_shape_slot_of_attribute (sh, obattr);
+      if (slot >= 0)
+	{
+	  atomic_store (&cache->ac_slot, (unsigned) slot);
+	  atomic_store (&cache->ac_shape, sh);
+	  return vals[slot];
+	}
+    };
+  /// special attributes like class, or unshaped objects
+  return rps_get_object_attribute (ob, obattr);
+}				/* end rps_get_object_attribute_cached */
+
+/****** end of file shape_rps.c ******/
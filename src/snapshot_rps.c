@@ -0,0 +1,469 @@
+/****************************************************************
+ * file snapshot_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the multi-version snapshots, giving consistent
+ *      read views of objects while other threads change them.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "Refpersys.h"
+
+/* A global snapshot clock is incremented when a snapshot is opened,
+   and that snapshot gets the new clock value as its epoch.  An object
+   changed while some snapshot is open records in ob_changepoch the
+   clock at that change; a state made at an epoch E is seen by the
+   snapshots of epoch above E.  Before its first change at some clock
+   value, the previous state of an object is pushed on its ob_history,
+   so older snapshots still find it there.  Histories are pruned when
+   the oldest open snapshot goes away, and freed once no snapshot is
+   open.  Objects are only read and changed under their lock. */
+
+struct rps_snapattr_st
+{
+  RpsObject_t *sa_attr;
+  RpsValue_t sa_val;
+};
+
+struct rps_objhistory_st
+{
+  unsigned long oh_epoch;	/* seen by snapshots above this epoch */
+  struct rps_objhistory_st *oh_older;
+  RpsObject_t *oh_class;
+  RpsObject_t *oh_space;
+  unsigned oh_nbattrs;
+  unsigned oh_nbcomp;
+  RpsValue_t *oh_comparr;	/* inside the same allocation */
+  struct rps_snapattr_st oh_attrs[];	/* sorted by address */
+};
+
+#define RPS_SNAPSHOT_MAGIC 0x0e2d6b43	/*237857603 */
+struct RpsSnapshot_st
+{
+  unsigned snap_magic;		/* always RPS_SNAPSHOT_MAGIC */
+  unsigned long snap_epoch;
+  RpsSnapshot_t *snap_prev;
+  RpsSnapshot_t *snap_next;
+};
+
+static atomic_ulong rps_snapshot_clock = 1;
+static atomic_uint rps_snapshot_nbopen;
+/// epoch of the oldest open snapshot, or 0 when none is open
+static atomic_ulong rps_snapshot_oldest;
+static pthread_mutex_t rps_snapshot_mtx = PTHREAD_MUTEX_INITIALIZER;
+static RpsSnapshot_t *rps_snapshot_first;	/* by increasing epoch */
+static RpsSnapshot_t *rps_snapshot_last;
+
+/* Objects having some history, to prune them when snapshots are
+   closed; they may appear twice.  The lock order is the object lock
+   then this mutex. */
+static pthread_mutex_t rps_snapshot_kept_mtx = PTHREAD_MUTEX_INITIALIZER;
+static RpsObject_t **rps_snapshot_kept_arr;
+static unsigned rps_snapshot_kept_nb, rps_snapshot_kept_size;
+
+/* Inside an atomic change, the clock of the first change is used for
+   every object, or 0 when no snapshot was open then. */
+static _Thread_local unsigned rps_snapshot_atomic_depth;
+static _Thread_local unsigned long rps_snapshot_atomic_clock;
+
+unsigned
+rps_nb_open_snapshots (void)
+{
+  return atomic_load (&rps_snapshot_nbopen);
+}				/* end rps_nb_open_snapshots */
+
+unsigned long
+rps_snapshot_epoch (const RpsSnapshot_t * snap)
+{
+  RPS_ASSERT (snap && snap->snap_magic == RPS_SNAPSHOT_MAGIC);
+  return snap->snap_epoch;
+}				/* end rps_snapshot_epoch */
+
+RpsSnapshot_t *
+rps_snapshot_open (void)
+{
+  RpsSnapshot_t *snap = RPS_ALLOC_ZEROED (sizeof (RpsSnapshot_t));
+  snap->snap_magic = RPS_SNAPSHOT_MAGIC;
+  pthread_mutex_lock (&rps_snapshot_mtx);
+  /// the clock only moves here; the snapshot is counted before, so
+  /// changes done at the new clock value keep their previous state
+  snap->snap_epoch = atomic_load (&rps_snapshot_clock) + 1;
+  snap->snap_prev = rps_snapshot_last;
+  if (rps_snapshot_last)
+    rps_snapshot_last->snap_next = snap;
+  else
+    {
+      rps_snapshot_first = snap;
+      atomic_store (&rps_snapshot_oldest, snap->snap_epoch);
+    };
+  rps_snapshot_last = snap;
+  atomic_fetch_add (&rps_snapshot_nbopen, 1);
+  atomic_store (&rps_snapshot_clock, snap->snap_epoch);
+  pthread_mutex_unlock (&rps_snapshot_mtx);
+  return snap;
+}				/* end rps_snapshot_open */
+
+static void
+rps_objhistory_free (struct rps_objhistory_st *hist)
+{
+  while (hist)
+    {
+      struct rps_objhistory_st *older = hist->oh_older;
+      free (hist);
+      hist = older;
+    }
+}				/* end rps_objhistory_free */
+
+/// free the states of a locked object which no open snapshot can see
+static void
+rps_locked_object_prune_history (RpsObject_t * ob, unsigned long oldest)
+{
+  struct rps_objhistory_st *hist = ob->ob_history;
+  if (!hist)
+    return;
+  if (oldest == 0 || ob->ob_changepoch < oldest)
+    {
+      ob->ob_history = NULL;
+      rps_objhistory_free (hist);
+      return;
+    };
+  /// the first state older than the oldest snapshot is the last needed
+  while (hist && hist->oh_epoch >= oldest)
+    hist = hist->oh_older;
+  if (hist && hist->oh_older)
+    {
+      rps_objhistory_free (hist->oh_older);
+      hist->oh_older = NULL;
+    }
+}				/* end rps_locked_object_prune_history */
+
+/// called with rps_snapshot_kept_mtx locked
+static void
+rps_snapshot_add_kept (RpsObject_t * ob)
+{
+  if (rps_snapshot_kept_nb >= rps_snapshot_kept_size)
+    {
+      unsigned newsize = rps_prime_above (rps_snapshot_kept_nb + 8
+					  + rps_snapshot_kept_nb / 2);
+      RpsObject_t **newarr =
+	RPS_ALLOC_ZEROED (newsize * sizeof (RpsObject_t *));
+      if (rps_snapshot_kept_nb > 0)
+	memcpy (newarr, rps_snapshot_kept_arr,
+		rps_snapshot_kept_nb * sizeof (RpsObject_t *));
+      free (rps_snapshot_kept_arr);
+      rps_snapshot_kept_arr = newarr;
+      rps_snapshot_kept_size = newsize;
+    };
+  rps_snapshot_kept_arr[rps_snapshot_kept_nb++] = ob;
+}				/* end rps_snapshot_add_kept */
+
+static void
+rps_snapshot_sweep_kept (void)
+{
+  pthread_mutex_lock (&rps_snapshot_kept_mtx);
+  RpsObject_t **keptarr = rps_snapshot_kept_arr;
+  unsigned nbkept = rps_snapshot_kept_nb;
+  rps_snapshot_kept_arr = NULL;
+  rps_snapshot_kept_nb = rps_snapshot_kept_size = 0;
+  pthread_mutex_unlock (&rps_snapshot_kept_mtx);
+  if (!keptarr)
+    return;
+  rps_object_array_qsort ((const RpsObject_t **) keptarr, (int) nbkept);
+  for (unsigned ix = 0; ix < nbkept; ix++)
+    {
+      RpsObject_t *ob = keptarr[ix];
+      if (ix > 0 && keptarr[ix - 1] == ob)
+	continue;
+      pthread_mutex_lock (&ob->ob_mtx);
+      /// a snapshot might have been opened meanwhile
+      rps_locked_object_prune_history (ob,
+				       atomic_load (&rps_snapshot_oldest));
+      if (ob->ob_history)
+	{
+	  pthread_mutex_lock (&rps_snapshot_kept_mtx);
+	  rps_snapshot_add_kept (ob);
+	  pthread_mutex_unlock (&rps_snapshot_kept_mtx);
+	};
+      pthread_mutex_unlock (&ob->ob_mtx);
+    };
+  free (keptarr);
+}				/* end rps_snapshot_sweep_kept */
+
+void
+rps_snapshot_close (RpsSnapshot_t * snap)
+{
+  if (!snap)
+    return;
+  RPS_ASSERT (snap->snap_magic == RPS_SNAPSHOT_MAGIC);
+  pthread_mutex_lock (&rps_snapshot_mtx);
+  bool wasoldest = (snap == rps_snapshot_first);
+  if (snap->snap_prev)
+    snap->snap_prev->snap_next = snap->snap_next;
+  else
+    rps_snapshot_first = snap->snap_next;
+  if (snap->snap_next)
+    snap->snap_next->snap_prev = snap->snap_prev;
+  else
+    rps_snapshot_last = snap->snap_prev;
+  unsigned long oldest =
+    rps_snapshot_first ? rps_snapshot_first->snap_epoch : 0;
+  atomic_store (&rps_snapshot_oldest, oldest);
+  atomic_fetch_sub (&rps_snapshot_nbopen, 1);
+  pthread_mutex_unlock (&rps_snapshot_mtx);
+  memset (snap, 0, sizeof (RpsSnapshot_t));
+  free (snap);
+  if (wasoldest)
+    rps_snapshot_sweep_kept ();
+}				/* end rps_snapshot_close */
+
+void
+rps_snapshot_begin_atomic_change (void)
+{
+  if (rps_snapshot_atomic_depth++ > 0)
+    return;
+  rps_snapshot_atomic_clock =
+    (atomic_load (&rps_snapshot_nbopen) > 0)
+    ? atomic_load (&rps_snapshot_clock) : 0;
+}				/* end rps_snapshot_begin_atomic_change */
+
+void
+rps_snapshot_end_atomic_change (void)
+{
+  RPS_ASSERT (rps_snapshot_atomic_depth > 0);
+  if (--rps_snapshot_atomic_depth == 0)
+    rps_snapshot_atomic_clock = 0;
+}				/* end rps_snapshot_end_atomic_change */
+
+static bool
+rps_snapshot_keep_attr_cb (RpsObject_t * obattr, void *data)
+{
+  struct rps_objhistory_st *hist = data;
+  hist->oh_attrs[hist->oh_nbattrs].sa_attr = obattr;
+  return true;
+}				/* end rps_snapshot_keep_attr_cb */
+
+static bool
+rps_snapshot_keep_val_cb (RpsValue_t val, void *data)
+{
+  struct rps_objhistory_st *hist = data;
+  hist->oh_attrs[hist->oh_nbattrs++].sa_val = val;
+  return true;
+}				/* end rps_snapshot_keep_val_cb */
+
+static int
+rps_snapattr_qcmp (const void *p1, const void *p2)
+{
+  const struct rps_snapattr_st *sa1 = p1;
+  const struct rps_snapattr_st *sa2 = p2;
+  if (sa1->sa_attr == sa2->sa_attr)
+    return 0;
+  return ((uintptr_t) sa1->sa_attr < (uintptr_t) sa2->sa_attr) ? -1 : 1;
+}				/* end rps_snapattr_qcmp */
+
+/// push the current state of a locked object, made before CLOCK
+static void
+rps_locked_object_keep_state (RpsObject_t * ob, unsigned long clock)
+{
+  rps_locked_object_prune_history (ob, atomic_load (&rps_snapshot_oldest));
+  bool wasempty = (ob->ob_history == NULL);
+  unsigned nbattrs = rps_locked_object_nb_attributes (ob);
+  unsigned nbcomp = ob->ob_nbcomp;
+  struct rps_objhistory_st *hist =
+    RPS_ALLOC_ZEROED (sizeof (struct rps_objhistory_st)
+		      + nbattrs * sizeof (struct rps_snapattr_st)
+		      + nbcomp * sizeof (RpsValue_t));
+  hist->oh_epoch = ob->ob_changepoch;
+  hist->oh_class = ob->ob_class;
+  hist->oh_space = ob->ob_space;
+  (void) rps_locked_object_iterate_attributes (ob,
+					       rps_snapshot_keep_attr_cb,
+					       rps_snapshot_keep_val_cb,
+					       hist);
+  RPS_ASSERT (hist->oh_nbattrs == nbattrs);
+  if (nbattrs > 1)
+    qsort (hist->oh_attrs, nbattrs, sizeof (struct rps_snapattr_st),
+	   rps_snapattr_qcmp);
+  hist->oh_comparr = (RpsValue_t *) (hist->oh_attrs + nbattrs);
+  hist->oh_nbcomp = nbcomp;
+  if (nbcomp > 0)
+    memcpy (hist->oh_comparr, ob->ob_comparr, nbcomp * sizeof (RpsValue_t));
+  hist->oh_older = ob->ob_history;
+  ob->ob_history = hist;
+  ob->ob_changepoch = clock;
+  if (wasempty)
+    {
+      pthread_mutex_lock (&rps_snapshot_kept_mtx);
+      rps_snapshot_add_kept (ob);
+      pthread_mutex_unlock (&rps_snapshot_kept_mtx);
+    }
+}				/* end rps_locked_object_keep_state */
+
+void
+rps_locked_object_touch (RpsObject_t * ob)
+{
+  RPS_ASSERT (ob != NULL);
+  unsigned long clock = 0;
+  if (rps_snapshot_atomic_depth > 0)
+    clock = rps_snapshot_atomic_clock;
+  else if (atomic_load (&rps_snapshot_nbopen) > 0)
+    clock = atomic_load (&rps_snapshot_clock);
+  /// when no snapshot is open, the stale ob_changepoch is harmless
+  if (clock > 0 && ob->ob_changepoch < clock)
+    rps_locked_object_keep_state (ob, clock);
+  atomic_fetch_add (&ob->ob_version, 2);
+  ob->ob_mtime = rps_clocktime (CLOCK_REALTIME);
+  rps_mtime_index_note (ob, ob->ob_mtime);
+}				/* end rps_locked_object_touch */
+
+void
+rps_locked_payload_touch (void *payl)
+{
+  struct rps_owned_payload_st *ownpayl = payl;
+  if (!ownpayl || !ownpayl->payl_owner)
+    return;
+  RPS_ASSERT (RPS_ZONED_MEMORY_TYPE (ownpayl) < 0);
+  rps_locked_object_touch (ownpayl->payl_owner);
+}				/* end rps_locked_payload_touch */
+
+/* The state of a locked object seen by a snapshot: NULL for the
+   current state, else some kept older one. */
+static const struct rps_objhistory_st *
+rps_locked_object_state_at (RpsObject_t * ob, const RpsSnapshot_t * snap)
+{
+  RPS_ASSERT (snap && snap->snap_magic == RPS_SNAPSHOT_MAGIC);
+  if (ob->ob_changepoch < snap->snap_epoch)
+    return NULL;
+  for (const struct rps_objhistory_st * hist = ob->ob_history; hist;
+       hist = hist->oh_older)
+    if (hist->oh_epoch < snap->snap_epoch)
+      return hist;
+  RPS_FATAL ("missing history of object for snapshot epoch %lu",
+	     snap->snap_epoch);
+}				/* end rps_locked_object_state_at */
+
+RpsObject_t *
+rps_snapshot_object_class (const RpsSnapshot_t * snap, RpsObject_t * ob)
+{
+  if (!ob)
+    return NULL;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  pthread_mutex_lock (&ob->ob_mtx);
+  const struct rps_objhistory_st *hist = rps_locked_object_state_at (ob, snap);
+  RpsObject_t *obclass = hist ? hist->oh_class : ob->ob_class;
+  pthread_mutex_unlock (&ob->ob_mtx);
+  return obclass;
+}				/* end rps_snapshot_object_class */
+
+RpsValue_t
+rps_snapshot_get_attribute (const RpsSnapshot_t * snap, RpsObject_t * ob,
+			    RpsObject_t * obattr)
+{
+  RpsValue_t res = RPS_NULL_VALUE;
+  if (!ob || !obattr)
+    return RPS_NULL_VALUE;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  pthread_mutex_lock (&ob->ob_mtx);
+  const struct rps_objhistory_st *hist = rps_locked_object_state_at (ob, snap);
+  if (!hist)
+    res = rps_locked_object_get_any_attribute (ob, obattr);
+  else if (obattr == RPS_ROOT_OB (_41OFI3r0S1t03qdB2E))	//class∈class
+    res = (RpsValue_t) hist->oh_class;
+  else if (obattr == RPS_ROOT_OB (_2i66FFjmS7n03HNNBx)	//space∈class
+	   || obattr == RPS_ROOT_OB (_9uwZtDshW4401x6MsY))	//space∈symbol
+    res = (RpsValue_t) hist->oh_space;
+  else
+    {
+      struct rps_snapattr_st key = {.sa_attr = obattr };
+      const struct rps_snapattr_st *sa =
+	bsearch (&key, hist->oh_attrs, hist->oh_nbattrs,
+		 sizeof (struct rps_snapattr_st), rps_snapattr_qcmp);
+      if (sa)
+	res = sa->sa_val;
+    };
+  pthread_mutex_unlock (&ob->ob_mtx);
+  return res;
+}				/* end rps_snapshot_get_attribute */
+
+const RpsSetOb_t *
+rps_snapshot_set_of_attributes (const RpsSnapshot_t * snap, RpsObject_t * ob)
+{
+  const RpsSetOb_t *set = NULL;
+  if (!ob)
+    return NULL;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  pthread_mutex_lock (&ob->ob_mtx);
+  const struct rps_objhistory_st *hist = rps_locked_object_state_at (ob, snap);
+  if (!hist)
+    set = rps_locked_object_set_of_attributes (ob);
+  else if (hist->oh_nbattrs > 0)
+    {
+      const RpsObject_t **attrarr =
+	RPS_ALLOC_ZEROED (hist->oh_nbattrs * sizeof (RpsObject_t *));
+      for (unsigned ix = 0; ix < hist->oh_nbattrs; ix++)
+	attrarr[ix] = hist->oh_attrs[ix].sa_attr;
+      set = rps_alloc_set_sized (hist->oh_nbattrs, attrarr);
+      free (attrarr);
+    };
+  pthread_mutex_unlock (&ob->ob_mtx);
+  return set;
+}				/* end rps_snapshot_set_of_attributes */
+
+unsigned
+rps_snapshot_nb_components (const RpsSnapshot_t * snap, RpsObject_t * ob)
+{
+  if (!ob)
+    return 0;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  pthread_mutex_lock (&ob->ob_mtx);
+  const struct rps_objhistory_st *hist = rps_locked_object_state_at (ob, snap);
+  unsigned nbc = hist ? hist->oh_nbcomp : ob->ob_nbcomp;
+  pthread_mutex_unlock (&ob->ob_mtx);
+  return nbc;
+}				/* end rps_snapshot_nb_components */
+
+RpsValue_t
+rps_snapshot_get_component (const RpsSnapshot_t * snap, RpsObject_t * ob,
+			    int ix)
+{
+  RpsValue_t res = RPS_NULL_VALUE;
+  if (!ob)
+    return RPS_NULL_VALUE;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  pthread_mutex_lock (&ob->ob_mtx);
+  const struct rps_objhistory_st *hist = rps_locked_object_state_at (ob, snap);
+  unsigned nbc = hist ? hist->oh_nbcomp : ob->ob_nbcomp;
+  const RpsValue_t *comparr = hist ? hist->oh_comparr : ob->ob_comparr;
+  if (ix < 0)
+    ix += (int) nbc;
+  if (ix >= 0 && ix < (int) nbc)
+    res = comparr[ix];
+  pthread_mutex_unlock (&ob->ob_mtx);
+  return res;
+}				/* end rps_snapshot_get_component */
+
+/****** end of file snapshot_rps.c ******/
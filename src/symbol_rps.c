@@ -125,8 +125,7 @@ rpsldpy_symbol (RpsObject_t * obj, RpsLoader_t * ld,
   RpsSymbol_t *pysymb = rps_register_symbol (json_string_value (jsymbname));
   if (jsymbvalue)
     pysymb->symb_value = rps_loader_json_to_value (ld, jsymbvalue);
-  pysymb->payl_owner = obj;
-  obj->ob_payload = pysymb;
+  rps_object_put_payload (obj, pysymb);
 }				/* end rpsldpy_symbol */
 
 
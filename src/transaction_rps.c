@@ -0,0 +1,470 @@
+/****************************************************************
+ * file transaction_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains optimistic transactions on objects, buffering
+ *      writes and validating object versions at commit time.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "Refpersys.h"
+
+/* Every object has an ob_version, bumped by 2 by each change under
+   its lock.  A committing transaction makes the versions of its
+   written objects odd while it holds their locks, so a concurrent
+   committer reading them fails its validation; it locks its written
+   objects before validating anything, so two transactions which read
+   what the other writes cannot both commit. */
+
+#define RPS_TRANSACTION_MAGIC 0x1c5e83f9	/*475956217 */
+
+struct rps_transaccess_st
+{
+  RpsObject_t *ta_ob;
+  unsigned long ta_version;	/* when first read */
+  bool ta_read;
+  bool ta_written;
+};
+
+enum rps_transwrite_en
+{
+  RPS_TRANSW__NONE,
+  RPS_TRANSW_ATTR,
+  RPS_TRANSW_COMP,
+  RPS_TRANSW_APPEND,
+};
+
+struct rps_transwrite_st
+{
+  RpsObject_t *tw_ob;
+  enum rps_transwrite_en tw_kind;
+  int tw_index;			/* non-negative, for RPS_TRANSW_COMP */
+  RpsObject_t *tw_attr;		/* for RPS_TRANSW_ATTR */
+  RpsValue_t tw_val;
+};
+
+struct RpsTransaction_st
+{
+  unsigned tr_magic;		/* always RPS_TRANSACTION_MAGIC */
+  bool tr_doomed;
+  unsigned tr_nbwritten;	/* number of written objects */
+  unsigned tr_nbaccess, tr_sizeaccess;
+  struct rps_transaccess_st *tr_accarr;
+  unsigned tr_nbwrite, tr_sizewrite;
+  struct rps_transwrite_st *tr_wrarr;	/* in program order */
+};
+
+RpsTransaction_t *
+rps_transaction_begin (void)
+{
+  RpsTransaction_t *tr = RPS_ALLOC_ZEROED (sizeof (RpsTransaction_t));
+  tr->tr_magic = RPS_TRANSACTION_MAGIC;
+  return tr;
+}				/* end rps_transaction_begin */
+
+void
+rps_transaction_reset (RpsTransaction_t * tr)
+{
+  RPS_ASSERT (tr && tr->tr_magic == RPS_TRANSACTION_MAGIC);
+  tr->tr_doomed = false;
+  tr->tr_nbwritten = 0;
+  if (tr->tr_nbaccess > 0)
+    memset (tr->tr_accarr, 0,
+	    tr->tr_nbaccess * sizeof (struct rps_transaccess_st));
+  tr->tr_nbaccess = 0;
+  if (tr->tr_nbwrite > 0)
+    memset (tr->tr_wrarr, 0,
+	    tr->tr_nbwrite * sizeof (struct rps_transwrite_st));
+  tr->tr_nbwrite = 0;
+}				/* end rps_transaction_reset */
+
+void
+rps_transaction_destroy (RpsTransaction_t * tr)
+{
+  if (!tr)
+    return;
+  RPS_ASSERT (tr->tr_magic == RPS_TRANSACTION_MAGIC);
+  free (tr->tr_accarr);
+  free (tr->tr_wrarr);
+  memset (tr, 0, sizeof (RpsTransaction_t));
+  free (tr);
+}				/* end rps_transaction_destroy */
+
+bool
+rps_transaction_doomed (const RpsTransaction_t * tr)
+{
+  RPS_ASSERT (tr && tr->tr_magic == RPS_TRANSACTION_MAGIC);
+  return tr->tr_doomed;
+}				/* end rps_transaction_doomed */
+
+/// find or add the access entry of an object; recent ones are likelier
+static struct rps_transaccess_st *
+rps_transaction_access (RpsTransaction_t * tr, RpsObject_t * ob)
+{
+  for (int ix = (int) tr->tr_nbaccess - 1; ix >= 0; ix--)
+    if (tr->tr_accarr[ix].ta_ob == ob)
+      return tr->tr_accarr + ix;
+  if (tr->tr_nbaccess >= tr->tr_sizeaccess)
+    {
+      unsigned newsize = rps_prime_above (tr->tr_nbaccess + 4
+					  + tr->tr_nbaccess / 2);
+      struct rps_transaccess_st *newarr =
+	RPS_ALLOC_ZEROED (newsize * sizeof (struct rps_transaccess_st));
+      if (tr->tr_nbaccess > 0)
+	memcpy (newarr, tr->tr_accarr,
+		tr->tr_nbaccess * sizeof (struct rps_transaccess_st));
+      free (tr->tr_accarr);
+      tr->tr_accarr = newarr;
+      tr->tr_sizeaccess = newsize;
+    };
+  struct rps_transaccess_st *acc = tr->tr_accarr + tr->tr_nbaccess++;
+  acc->ta_ob = ob;
+  return acc;
+}				/* end rps_transaction_access */
+
+/// called after reading OB whose version was VERSION under its lock
+static void
+rps_transaction_note_read (RpsTransaction_t * tr, RpsObject_t * ob,
+			   unsigned long version)
+{
+  struct rps_transaccess_st *acc = rps_transaction_access (tr, ob);
+  if (!acc->ta_read)
+    {
+      acc->ta_read = true;
+      acc->ta_version = version;
+    }
+  else if (acc->ta_version != version)
+    tr->tr_doomed = true;
+}				/* end rps_transaction_note_read */
+
+static void
+rps_transaction_log_write (RpsTransaction_t * tr, RpsObject_t * ob,
+			   enum rps_transwrite_en kind, RpsObject_t * obattr,
+			   int ix, RpsValue_t val)
+{
+  struct rps_transaccess_st *acc = rps_transaction_access (tr, ob);
+  if (!acc->ta_written)
+    {
+      if (tr->tr_nbwritten >= RPS_MAX_LOCKED_OBJECTS)
+	RPS_FATAL ("too many objects written by transaction, at most %d",
+		   RPS_MAX_LOCKED_OBJECTS);
+      acc->ta_written = true;
+      tr->tr_nbwritten++;
+    };
+  if (tr->tr_nbwrite >= tr->tr_sizewrite)
+    {
+      unsigned newsize = rps_prime_above (tr->tr_nbwrite + 4
+					  + tr->tr_nbwrite / 2);
+      struct rps_transwrite_st *newarr =
+	RPS_ALLOC_ZEROED (newsize * sizeof (struct rps_transwrite_st));
+      if (tr->tr_nbwrite > 0)
+	memcpy (newarr, tr->tr_wrarr,
+		tr->tr_nbwrite * sizeof (struct rps_transwrite_st));
+      free (tr->tr_wrarr);
+      tr->tr_wrarr = newarr;
+      tr->tr_sizewrite = newsize;
+    };
+  struct rps_transwrite_st *wr = tr->tr_wrarr + tr->tr_nbwrite++;
+  wr->tw_ob = ob;
+  wr->tw_kind = kind;
+  wr->tw_attr = obattr;
+  wr->tw_index = ix;
+  wr->tw_val = val;
+}				/* end rps_transaction_log_write */
+
+/// the last buffered write of some kind to OB, or NULL
+static struct rps_transwrite_st *
+rps_transaction_find_write (RpsTransaction_t * tr, RpsObject_t * ob,
+			    enum rps_transwrite_en kind,
+			    const RpsObject_t * obattr, int ix)
+{
+  for (int wix = (int) tr->tr_nbwrite - 1; wix >= 0; wix--)
+    {
+      struct rps_transwrite_st *wr = tr->tr_wrarr + wix;
+      if (wr->tw_ob == ob && wr->tw_kind == kind
+	  && wr->tw_attr == obattr && wr->tw_index == ix)
+	return wr;
+    };
+  return NULL;
+}				/* end rps_transaction_find_write */
+
+/// the RANK-th buffered append to OB, or NULL
+static struct rps_transwrite_st *
+rps_transaction_nth_append (RpsTransaction_t * tr, RpsObject_t * ob,
+			    unsigned rank)
+{
+  for (unsigned wix = 0; wix < tr->tr_nbwrite; wix++)
+    {
+      struct rps_transwrite_st *wr = tr->tr_wrarr + wix;
+      if (wr->tw_ob == ob && wr->tw_kind == RPS_TRANSW_APPEND)
+	{
+	  if (rank == 0)
+	    return wr;
+	  rank--;
+	}
+    };
+  return NULL;
+}				/* end rps_transaction_nth_append */
+
+static unsigned
+rps_transaction_nb_appends (RpsTransaction_t * tr, RpsObject_t * ob)
+{
+  unsigned nbapp = 0;
+  for (unsigned wix = 0; wix < tr->tr_nbwrite; wix++)
+    if (tr->tr_wrarr[wix].tw_ob == ob
+	&& tr->tr_wrarr[wix].tw_kind == RPS_TRANSW_APPEND)
+      nbapp++;
+  return nbapp;
+}				/* end rps_transaction_nb_appends */
+
+RpsValue_t
+rps_transaction_get_attribute (RpsTransaction_t * tr, RpsObject_t * ob,
+			       RpsObject_t * obattr)
+{
+  RPS_ASSERT (tr && tr->tr_magic == RPS_TRANSACTION_MAGIC);
+  if (!ob || !obattr)
+    return RPS_NULL_VALUE;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  struct rps_transwrite_st *wr =
+    rps_transaction_find_write (tr, ob, RPS_TRANSW_ATTR, obattr, 0);
+  if (wr)
+    return wr->tw_val;
+  pthread_mutex_lock (&ob->ob_mtx);
+  unsigned long version = atomic_load (&ob->ob_version);
+  RpsValue_t res = rps_locked_object_get_any_attribute (ob, obattr);
+  pthread_mutex_unlock (&ob->ob_mtx);
+  rps_transaction_note_read (tr, ob, version);
+  return res;
+}				/* end rps_transaction_get_attribute */
+
+void
+rps_transaction_put_attribute (RpsTransaction_t * tr, RpsObject_t * ob,
+			       RpsObject_t * obattr, RpsValue_t val)
+{
+  RPS_ASSERT (tr && tr->tr_magic == RPS_TRANSACTION_MAGIC);
+  if (!ob || !obattr || val == RPS_NULL_VALUE)
+    return;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  RPS_ASSERT (rps_is_valid_object (obattr));
+  struct rps_transwrite_st *wr =
+    rps_transaction_find_write (tr, ob, RPS_TRANSW_ATTR, obattr, 0);
+  if (wr)
+    wr->tw_val = val;
+  else
+    rps_transaction_log_write (tr, ob, RPS_TRANSW_ATTR, obattr, 0, val);
+}				/* end rps_transaction_put_attribute */
+
+unsigned
+rps_transaction_nb_components (RpsTransaction_t * tr, RpsObject_t * ob)
+{
+  RPS_ASSERT (tr && tr->tr_magic == RPS_TRANSACTION_MAGIC);
+  if (!ob)
+    return 0;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  pthread_mutex_lock (&ob->ob_mtx);
+  unsigned long version = atomic_load (&ob->ob_version);
+  unsigned nbc = ob->ob_nbcomp;
+  pthread_mutex_unlock (&ob->ob_mtx);
+  rps_transaction_note_read (tr, ob, version);
+  return nbc + rps_transaction_nb_appends (tr, ob);
+}				/* end rps_transaction_nb_components */
+
+/* Read the committed number of components of OB and its component at
+   *PIX, which is made non-negative, counting the buffered appends. */
+static RpsValue_t
+rps_transaction_read_component (RpsTransaction_t * tr, RpsObject_t * ob,
+				int *pix, unsigned *pnbc, unsigned *pnbapp)
+{
+  unsigned nbapp = rps_transaction_nb_appends (tr, ob);
+  RpsValue_t res = RPS_NULL_VALUE;
+  int ix = *pix;
+  pthread_mutex_lock (&ob->ob_mtx);
+  unsigned long version = atomic_load (&ob->ob_version);
+  unsigned nbc = ob->ob_nbcomp;
+  if (ix < 0)
+    ix += (int) (nbc + nbapp);
+  if (ix >= 0 && ix < (int) nbc)
+    res = ob->ob_comparr[ix];
+  pthread_mutex_unlock (&ob->ob_mtx);
+  rps_transaction_note_read (tr, ob, version);
+  *pix = ix;
+  *pnbc = nbc;
+  *pnbapp = nbapp;
+  return res;
+}				/* end rps_transaction_read_component */
+
+RpsValue_t
+rps_transaction_get_component (RpsTransaction_t * tr, RpsObject_t * ob,
+			       int ix)
+{
+  RPS_ASSERT (tr && tr->tr_magic == RPS_TRANSACTION_MAGIC);
+  if (!ob)
+    return RPS_NULL_VALUE;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  unsigned nbc = 0, nbapp = 0;
+  RpsValue_t res =
+    rps_transaction_read_component (tr, ob, &ix, &nbc, &nbapp);
+  if (ix < 0 || ix >= (int) (nbc + nbapp))
+    return RPS_NULL_VALUE;
+  if (ix >= (int) nbc)
+    return rps_transaction_nth_append (tr, ob, ix - nbc)->tw_val;
+  struct rps_transwrite_st *wr =
+    rps_transaction_find_write (tr, ob, RPS_TRANSW_COMP, NULL, ix);
+  if (wr)
+    return wr->tw_val;
+  return res;
+}				/* end rps_transaction_get_component */
+
+bool
+rps_transaction_put_component (RpsTransaction_t * tr, RpsObject_t * ob,
+			       int ix, RpsValue_t val)
+{
+  RPS_ASSERT (tr && tr->tr_magic == RPS_TRANSACTION_MAGIC);
+  if (!ob)
+    return false;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  unsigned nbc = 0, nbapp = 0;
+  (void) rps_transaction_read_component (tr, ob, &ix, &nbc, &nbapp);
+  if (ix < 0 || ix >= (int) (nbc + nbapp))
+    return false;
+  struct rps_transwrite_st *wr = NULL;
+  if (ix >= (int) nbc)
+    wr = rps_transaction_nth_append (tr, ob, ix - nbc);
+  else
+    wr = rps_transaction_find_write (tr, ob, RPS_TRANSW_COMP, NULL, ix);
+  if (wr)
+    wr->tw_val = val;
+  else
+    rps_transaction_log_write (tr, ob, RPS_TRANSW_COMP, NULL, ix, val);
+  return true;
+}				/* end rps_transaction_put_component */
+
+void
+rps_transaction_append_component (RpsTransaction_t * tr, RpsObject_t * ob,
+				  RpsValue_t val)
+{
+  RPS_ASSERT (tr && tr->tr_magic == RPS_TRANSACTION_MAGIC);
+  if (!ob)
+    return;
+  RPS_ASSERT (rps_is_valid_object (ob));
+  rps_transaction_log_write (tr, ob, RPS_TRANSW_APPEND, NULL, 0, val);
+}				/* end rps_transaction_append_component */
+
+bool
+rps_transaction_commit (RpsTransaction_t * tr)
+{
+  RpsObject_t *lockarr[RPS_MAX_LOCKED_OBJECTS];
+  RPS_ASSERT (tr && tr->tr_magic == RPS_TRANSACTION_MAGIC);
+  if (tr->tr_doomed)
+    return false;
+  unsigned nbwritten = 0;
+  for (unsigned aix = 0; aix < tr->tr_nbaccess; aix++)
+    if (tr->tr_accarr[aix].ta_written)
+      lockarr[nbwritten++] = tr->tr_accarr[aix].ta_ob;
+  RPS_ASSERT (nbwritten == tr->tr_nbwritten);
+  unsigned nblocked = rps_lock_objects (nbwritten, lockarr);
+  for (unsigned lix = 0; lix < nblocked; lix++)
+    atomic_fetch_add (&lockarr[lix]->ob_version, 1);
+  /// validate every read object, our written ones are now odd
+  bool ok = true;
+  for (unsigned aix = 0; ok && aix < tr->tr_nbaccess; aix++)
+    {
+      struct rps_transaccess_st *acc = tr->tr_accarr + aix;
+      if (!acc->ta_read)
+	continue;
+      unsigned long curversion = atomic_load (&acc->ta_ob->ob_version);
+      if (acc->ta_written)
+	curversion--;
+      ok = (curversion == acc->ta_version);
+    };
+  if (ok)
+    {
+      /// snapshots should see all our writes or none
+      rps_snapshot_begin_atomic_change ();
+      for (unsigned wix = 0; wix < tr->tr_nbwrite; wix++)
+	{
+	  struct rps_transwrite_st *wr = tr->tr_wrarr + wix;
+	  switch (wr->tw_kind)
+	    {
+	    case RPS_TRANSW_ATTR:
+	      rps_locked_object_put_any_attribute (wr->tw_ob, wr->tw_attr,
+						   wr->tw_val);
+	      break;
+	    case RPS_TRANSW_COMP:
+	      if (!rps_locked_object_put_component (wr->tw_ob, wr->tw_index,
+						    wr->tw_val))
+		RPS_FATAL ("validated transaction component #%d is missing",
+			   wr->tw_index);
+	      break;
+	    case RPS_TRANSW_APPEND:
+	      rps_locked_object_append_component (wr->tw_ob, wr->tw_val);
+	      break;
+	    default:
+	      RPS_FATAL ("corrupted transaction write kind %d",
+			 (int) wr->tw_kind);
+	    }
+	};
+      rps_snapshot_end_atomic_change ();
+      for (unsigned lix = 0; lix < nblocked; lix++)
+	atomic_fetch_add (&lockarr[lix]->ob_version, 1);
+    }
+  else
+    {
+      /// nothing changed, so restore the previous versions
+      for (unsigned lix = 0; lix < nblocked; lix++)
+	atomic_fetch_sub (&lockarr[lix]->ob_version, 1);
+      tr->tr_doomed = true;
+    };
+  rps_unlock_objects (nblocked, lockarr);
+  return ok;
+}				/* end rps_transaction_commit */
+
+bool
+rps_run_transaction (rps_transaction_sig_t * rout, void *data,
+		     unsigned maxretries)
+{
+  RPS_ASSERT (rout != NULL);
+  RpsTransaction_t *tr = rps_transaction_begin ();
+  bool committed = false;
+  for (unsigned cnt = 0; cnt <= maxretries && !committed; cnt++)
+    {
+      if (cnt > 0)
+	{
+	  rps_transaction_reset (tr);
+	  /// back off a little, longer after repeated conflicts
+	  usleep (10 * (cnt < 64 ? cnt : 64) + (rps_gettid () % 8));
+	};
+      if (!(*rout) (tr, data))
+	break;
+      committed = rps_transaction_commit (tr);
+    };
+  rps_transaction_destroy (tr);
+  return committed;
+}				/* end rps_run_transaction */
+
+/****** end of file transaction_rps.c ******/
@@ -0,0 +1,348 @@
+/****************************************************************
+ * file traverse_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the generic traversal of the object graph, breadth
+ *      first, depth first or in parallel, with visitor callbacks.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "Refpersys.h"
+
+/* The edges of an object are enumerated by rps_object_scan_references,
+   so thru its class, space, attributes, components and payload using
+   the payload dump scanners.  The visitor is called, without any lock
+   held, once on every reached object, with the object from which it
+   was first reached (NULL for starting objects) and its depth; it
+   tells whether to continue, to skip the references of that object,
+   or to stop the whole traversal.  The optional edge routine is
+   called on every edge, with the referring object locked, so it
+   should not lock any object.
+
+   Visited objects are remembered in a bit set or a hash table, or by
+   marks in an array of atomic bytes indexed by object index, which is
+   required, and always used, in parallel mode.  Objects with an index
+   given after the start of a traversal using marks are not visited.
+   The parallel mode is breadth first, each level being processed by
+   rps_parallel_for_each_index; it gives the same depths as the serial
+   breadth first mode, but visits each level in no particular order. */
+
+struct rps_travitem_st
+{
+  RpsObject_t *ti_ob;
+  RpsObject_t *ti_from;
+  unsigned ti_depth;
+};
+
+struct rps_travbuf_st
+{
+  struct rps_travitem_st *tb_arr;
+  unsigned long tb_nb, tb_size;
+};
+
+struct rps_traversal_st
+{
+  enum rps_traversal_mode_en trv_mode;
+  enum rps_visited_kind_en trv_visited;
+  rps_traversal_visitor_sig_t *trv_visitor;
+  rps_traversal_edge_sig_t *trv_edgerout;
+  void *trv_data;
+  RpsBitSet_t *trv_bitset;
+  RpsHashTblOb_t *trv_hashtbl;
+  _Atomic uint8_t *trv_marks;
+  uint32_t trv_nbmarks;
+  atomic_bool trv_stop;
+  atomic_ulong trv_count;
+  /// in parallel mode, the current level and the next ones per worker
+  struct rps_travitem_st *trv_levelarr;
+  struct rps_travbuf_st trv_nextbuf[RPS_MAX_NB_THREADS];
+};
+
+/// the data given to the reference callback of one scanned object
+struct rps_travscan_st
+{
+  struct rps_traversal_st *trs_trav;
+  struct rps_travbuf_st *trs_buf;
+  RpsObject_t *trs_from;
+  unsigned trs_depth;
+  int trs_workix;
+};
+
+static void
+rps_travbuf_push (struct rps_travbuf_st *tb, RpsObject_t * ob,
+		  RpsObject_t * obfrom, unsigned depth)
+{
+  if (tb->tb_nb >= tb->tb_size)
+    {
+      unsigned long newsize =
+	rps_prime_above (tb->tb_size + tb->tb_size / 2 + 30);
+      struct rps_travitem_st *newarr =
+	RPS_ALLOC_ZEROED (newsize * sizeof (struct rps_travitem_st));
+      if (tb->tb_nb > 0)
+	memcpy (newarr, tb->tb_arr,
+		tb->tb_nb * sizeof (struct rps_travitem_st));
+      free (tb->tb_arr);
+      tb->tb_arr = newarr;
+      tb->tb_size = newsize;
+    };
+  tb->tb_arr[tb->tb_nb].ti_ob = ob;
+  tb->tb_arr[tb->tb_nb].ti_from = obfrom;
+  tb->tb_arr[tb->tb_nb].ti_depth = depth;
+  tb->tb_nb++;
+}				/* end rps_travbuf_push */
+
+/// mark an object as visited, true if it was not yet
+static bool
+rps_traversal_mark (struct rps_traversal_st *trv, RpsObject_t * ob)
+{
+  switch (trv->trv_visited)
+    {
+    case RPS_VISITED_BITSET:
+      return rps_bitset_put_object (trv->trv_bitset, ob);
+    case RPS_VISITED_HASHTBL:
+      return rps_hash_tbl_ob_add (trv->trv_hashtbl, ob);
+    case RPS_VISITED_MARKS:
+      {
+	uint32_t ix = rps_object_index (ob);
+	if (ix == 0 || ix >= trv->trv_nbmarks)
+	  return false;
+	return atomic_exchange (trv->trv_marks + ix, 1) == 0;
+      }
+    default:
+      RPS_FATAL ("corrupted visited kind#%d", (int) trv->trv_visited);
+    }
+}				/* end rps_traversal_mark */
+
+/// call the visitor, true if the references should be scanned
+static bool
+rps_traversal_visit (struct rps_traversal_st *trv,
+		     const struct rps_travitem_st *ti, int workix)
+{
+  atomic_fetch_add (&trv->trv_count, 1);
+  enum rps_visit_en vis = (*trv->trv_visitor) (ti->ti_ob, ti->ti_from,
+					       ti->ti_depth, workix,
+					       trv->trv_data);
+  if (vis == RPS_VISIT_STOP)
+    atomic_store (&trv->trv_stop, true);
+  return vis == RPS_VISIT_CONTINUE;
+}				/* end rps_traversal_visit */
+
+static rps_object_callback_sig_t rps_traversal_reference_cb;
+static bool
+rps_traversal_reference_cb (RpsObject_t * ob, void *data)
+{
+  struct rps_travscan_st *trs = data;
+  struct rps_traversal_st *trv = trs->trs_trav;
+  if (trv->trv_edgerout)
+    (*trv->trv_edgerout) (trs->trs_from, ob, trs->trs_workix,
+			  trv->trv_data);
+  /// depth first traversals mark objects when popping them
+  if (trv->trv_mode == RPS_TRAVERSE_DFS || rps_traversal_mark (trv, ob))
+    rps_travbuf_push (trs->trs_buf, ob, trs->trs_from, trs->trs_depth + 1);
+  return true;
+}				/* end rps_traversal_reference_cb */
+
+static void
+rps_traversal_scan (struct rps_traversal_st *trv,
+		    const struct rps_travitem_st *ti,
+		    struct rps_travbuf_st *tb, int workix)
+{
+  struct rps_travscan_st trs = {.trs_trav = trv,.trs_buf = tb,
+    .trs_from = ti->ti_ob,.trs_depth = ti->ti_depth,.trs_workix = workix
+  };
+  rps_object_scan_references (ti->ti_ob, rps_traversal_reference_cb, &trs);
+}				/* end rps_traversal_scan */
+
+static void
+rps_traversal_serial_bfs (struct rps_traversal_st *trv,
+			  struct rps_travbuf_st *queue)
+{
+  for (unsigned long qix = 0; qix < queue->tb_nb; qix++)
+    {
+      if (atomic_load (&trv->trv_stop))
+	return;
+      struct rps_travitem_st ti = queue->tb_arr[qix];
+      if (rps_traversal_visit (trv, &ti, 0))
+	rps_traversal_scan (trv, &ti, queue, 0);
+    }
+}				/* end rps_traversal_serial_bfs */
+
+static void
+rps_traversal_serial_dfs (struct rps_traversal_st *trv,
+			  struct rps_travbuf_st *stack)
+{
+  struct rps_travbuf_st children = { };
+  while (stack->tb_nb > 0 && !atomic_load (&trv->trv_stop))
+    {
+      struct rps_travitem_st ti = stack->tb_arr[--stack->tb_nb];
+      if (!rps_traversal_mark (trv, ti.ti_ob))
+	continue;
+      if (!rps_traversal_visit (trv, &ti, 0))
+	continue;
+      children.tb_nb = 0;
+      rps_traversal_scan (trv, &ti, &children, 0);
+      /// push children reversed, so the first reference is visited first
+      for (unsigned long cix = children.tb_nb; cix > 0; cix--)
+	rps_travbuf_push (stack, children.tb_arr[cix - 1].ti_ob,
+			  children.tb_arr[cix - 1].ti_from,
+			  children.tb_arr[cix - 1].ti_depth);
+    };
+  free (children.tb_arr);
+}				/* end rps_traversal_serial_dfs */
+
+static rps_parallel_index_callback_sig_t rps_traversal_level_cb;
+static void
+rps_traversal_level_cb (unsigned long ix, int workix, void *data)
+{
+  struct rps_traversal_st *trv = data;
+  if (atomic_load (&trv->trv_stop))
+    return;
+  const struct rps_travitem_st *ti = trv->trv_levelarr + ix;
+  if (rps_traversal_visit (trv, ti, workix))
+    rps_traversal_scan (trv, ti, trv->trv_nextbuf + workix, workix);
+}				/* end rps_traversal_level_cb */
+
+static void
+rps_traversal_parallel (struct rps_traversal_st *trv,
+			struct rps_travbuf_st *level, int nbthreads)
+{
+  struct rps_travitem_st *levelarr = level->tb_arr;
+  unsigned long nblevel = level->tb_nb;
+  memset (level, 0, sizeof (*level));
+  while (nblevel > 0 && !atomic_load (&trv->trv_stop))
+    {
+      trv->trv_levelarr = levelarr;
+      rps_parallel_for_each_index (nblevel, nbthreads,
+				   rps_traversal_level_cb, trv);
+      free (levelarr);
+      nblevel = 0;
+      for (int wix = 0; wix < nbthreads; wix++)
+	nblevel += trv->trv_nextbuf[wix].tb_nb;
+      levelarr =
+	RPS_ALLOC_ZEROED ((nblevel + 1) * sizeof (struct rps_travitem_st));
+      unsigned long lix = 0;
+      for (int wix = 0; wix < nbthreads; wix++)
+	{
+	  struct rps_travbuf_st *tb = trv->trv_nextbuf + wix;
+	  if (tb->tb_nb > 0)
+	    memcpy (levelarr + lix, tb->tb_arr,
+		    tb->tb_nb * sizeof (struct rps_travitem_st));
+	  lix += tb->tb_nb;
+	  tb->tb_nb = 0;
+	}
+    };
+  free (levelarr);
+  trv->trv_levelarr = NULL;
+  for (int wix = 0; wix < nbthreads; wix++)
+    free (trv->trv_nextbuf[wix].tb_arr);
+}				/* end rps_traversal_parallel */
+
+/* Traverse the objects reachable from those of STARTSET in the given
+   MODE, remembering visited objects as told by VISITED, calling
+   VISITOR on each of them and EDGEROUT, when not null, on each scanned
+   reference; DATA is passed to both.  NBTHREADS is used in parallel
+   mode, rps_nb_threads if not positive.  Gives the number of visited
+   objects. */
+unsigned long
+rps_traverse_objects (const RpsSetOb_t * startset,
+		      enum rps_traversal_mode_en mode,
+		      enum rps_visited_kind_en visited,
+		      rps_traversal_visitor_sig_t * visitor,
+		      rps_traversal_edge_sig_t * edgerout, void *data,
+		      int nbthreads)
+{
+  if (!visitor)
+    RPS_FATAL ("rps_traverse_objects without visitor");
+  if (mode != RPS_TRAVERSE_BFS && mode != RPS_TRAVERSE_DFS
+      && mode != RPS_TRAVERSE_PARALLEL)
+    RPS_FATAL ("rps_traverse_objects with bad mode#%d", (int) mode);
+  if (nbthreads <= 0)
+    nbthreads = rps_nb_threads;
+  if (nbthreads <= 0)
+    nbthreads = 1;
+  else if (nbthreads > RPS_MAX_NB_THREADS)
+    nbthreads = RPS_MAX_NB_THREADS;
+  struct rps_traversal_st *trv = RPS_ALLOC_ZEROED (sizeof (*trv));
+  trv->trv_mode = mode;
+  trv->trv_visited = (mode == RPS_TRAVERSE_PARALLEL)
+    ? RPS_VISITED_MARKS : visited;
+  trv->trv_visitor = visitor;
+  trv->trv_edgerout = edgerout;
+  trv->trv_data = data;
+  atomic_init (&trv->trv_stop, false);
+  atomic_init (&trv->trv_count, 0);
+  switch (trv->trv_visited)
+    {
+    case RPS_VISITED_BITSET:
+      trv->trv_bitset = rps_bitset_create (rps_object_index_bound ());
+      break;
+    case RPS_VISITED_HASHTBL:
+      trv->trv_hashtbl = rps_hash_tbl_ob_create (100);
+      break;
+    case RPS_VISITED_MARKS:
+      trv->trv_nbmarks = rps_object_index_bound ();
+      trv->trv_marks = RPS_ALLOC_ZEROED (trv->trv_nbmarks + 1);
+      break;
+    default:
+      RPS_FATAL ("rps_traverse_objects with bad visited kind#%d",
+		 (int) visited);
+    };
+  struct rps_travbuf_st startbuf = { };
+  unsigned card = rps_set_cardinal (startset);
+  for (unsigned six = 0; six < card; six++)
+    {
+      /// pushed reversed in depth first mode, so the first is visited first
+      unsigned rk = (mode == RPS_TRAVERSE_DFS) ? card - 1 - six : six;
+      RpsObject_t *obstart = (RpsObject_t *) rps_set_nth_member (startset,
+								  rk);
+      if (mode == RPS_TRAVERSE_DFS || rps_traversal_mark (trv, obstart))
+	rps_travbuf_push (&startbuf, obstart, NULL, 0);
+    };
+  switch (mode)
+    {
+    case RPS_TRAVERSE_BFS:
+      rps_traversal_serial_bfs (trv, &startbuf);
+      free (startbuf.tb_arr);
+      break;
+    case RPS_TRAVERSE_DFS:
+      rps_traversal_serial_dfs (trv, &startbuf);
+      free (startbuf.tb_arr);
+      break;
+    case RPS_TRAVERSE_PARALLEL:
+      rps_traversal_parallel (trv, &startbuf, nbthreads);
+      break;
+    };
+  unsigned long count = atomic_load (&trv->trv_count);
+  if (trv->trv_bitset)
+    rps_bitset_destroy (trv->trv_bitset);
+  free ((void *) trv->trv_marks);
+  free (trv);
+  return count;
+}				/* end rps_traverse_objects */
+
+/****** end of file traverse_rps.c ******/
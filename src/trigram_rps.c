@@ -0,0 +1,421 @@
+/****************************************************************
+ * file trigram_rps.c
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *
+ * Description:
+ *      This file is part of the Reflective Persistent System.
+ *
+ *      It contains the trigram index of the string values in object
+ *      attributes and components, for substring searches.
+ *
+ * Author(s):
+ *      Basile Starynkevitch <basile@starynkevitch.net>
+ *      Abhishek Chakravarti <abhishek@taranjali.org>
+ *      Nimesh Neema <nimeshneema@gmail.com>
+ *
+ *      © Copyright 2019 - 2022 The Reflective Persistent System Team
+ *      team@refpersys.org & http://refpersys.org/
+ *
+ * License:
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+
+#include "Refpersys.h"
+
+/* Every three consecutive bytes of the UTF8 strings of some object,
+   as found by rps_object_scan_strings in its attributes, components
+   and payload (e.g. symbol names or string dictionary keys), give a
+   trigram, mapped to the list of dense indexes of such objects.  A
+   substring search intersects the lists of the trigrams of the
+   searched string, then verifies the candidates with memmem, so stale
+   entries, e.g. of strings since replaced, are harmless and are never
+   removed.  A list is sorted, dropping its duplicates, when it has
+   doubled since it was last sorted, so it stays within twice the
+   number of its objects.
+
+   The index is optional and built by rps_build_trigram_index, in
+   parallel, e.g. after loading; from then on strings put into objects
+   are added by rps_trigram_note_value, called with the object locked.
+   The trigrams are spread over shards, each a hash table under its own
+   mutex, taken after object locks. */
+
+#define RPS_TRIGRAM_NB_SHARDS 64
+
+struct rps_trigram_posting_st
+{
+  uint32_t tgp_key;		/* trigram plus 1, 0 for an empty entry */
+  bool tgp_sorted;		/* no duplicates when sorted */
+  unsigned tgp_nb, tgp_size;
+  unsigned tgp_sortednb;	/* tgp_nb when last sorted */
+  uint32_t *tgp_arr;		/* object indexes */
+};
+
+struct rps_trigram_shard_st
+{
+  pthread_mutex_t tgs_mtx;
+  unsigned tgs_count;
+  unsigned tgs_size;		/* a prime, or 0 */
+  struct rps_trigram_posting_st *tgs_arr;
+} __attribute__((aligned (64)));
+
+static struct rps_trigram_shard_st rps_trigram_shardarr[RPS_TRIGRAM_NB_SHARDS];
+static atomic_bool rps_trigram_enabled;
+static pthread_once_t rps_trigram_once = PTHREAD_ONCE_INIT;
+/// objects with some string, for searches shorter than a trigram
+static pthread_mutex_t rps_trigram_strobs_mtx = PTHREAD_MUTEX_INITIALIZER;
+static RpsBitSet_t *rps_trigram_strobs;
+
+static void
+rps_trigram_initialize (void)
+{
+  for (int shix = 0; shix < RPS_TRIGRAM_NB_SHARDS; shix++)
+    pthread_mutex_init (&rps_trigram_shardarr[shix].tgs_mtx, NULL);
+  rps_trigram_strobs = rps_bitset_create (0);
+}				/* end rps_trigram_initialize */
+
+static inline uint32_t
+rps_trigram_key (const unsigned char *s)
+{
+  return ((uint32_t) s[0] << 16) | ((uint32_t) s[1] << 8) | s[2];
+}				/* end rps_trigram_key */
+
+static inline struct rps_trigram_shard_st *
+rps_trigram_shard (uint32_t key)
+{
+  return rps_trigram_shardarr + ((key * 2654435761U) >> 26);
+}				/* end rps_trigram_shard */
+
+/// find or add the posting of KEY in its locked shard
+static struct rps_trigram_posting_st *
+rps_trigram_shard_posting (struct rps_trigram_shard_st *sh, uint32_t key,
+			   bool create)
+{
+  if (sh->tgs_size == 0 && !create)
+    return NULL;
+  if (create && 4 * (sh->tgs_count + 1) > 3 * sh->tgs_size)
+    {
+      unsigned newsize = rps_prime_above (2 * sh->tgs_count + 31);
+      struct rps_trigram_posting_st *newarr =
+	RPS_ALLOC_ZEROED (newsize * sizeof (struct rps_trigram_posting_st));
+      for (unsigned ix = 0; ix < sh->tgs_size; ix++)
+	{
+	  struct rps_trigram_posting_st *oldp = sh->tgs_arr + ix;
+	  if (oldp->tgp_key == 0)
+	    continue;
+	  unsigned nix = oldp->tgp_key % newsize;
+	  while (newarr[nix].tgp_key != 0)
+	    if (++nix >= newsize)
+	      nix = 0;
+	  newarr[nix] = *oldp;
+	};
+      free (sh->tgs_arr);
+      sh->tgs_arr = newarr;
+      sh->tgs_size = newsize;
+    };
+  unsigned ix = (key + 1) % sh->tgs_size;
+  for (;;)
+    {
+      struct rps_trigram_posting_st *p = sh->tgs_arr + ix;
+      if (p->tgp_key == key + 1)
+	return p;
+      if (p->tgp_key == 0)
+	{
+	  if (!create)
+	    return NULL;
+	  p->tgp_key = key + 1;
+	  p->tgp_sorted = true;
+	  sh->tgs_count++;
+	  return p;
+	};
+      if (++ix >= sh->tgs_size)
+	ix = 0;
+    }
+}				/* end rps_trigram_shard_posting */
+
+static int rps_trigram_uint32_qcmp (const void *p1, const void *p2);
+
+/// sort a posting of a locked shard, dropping its duplicates
+static void
+rps_trigram_sort_posting (struct rps_trigram_posting_st *p)
+{
+  if (!p->tgp_sorted)
+    {
+      qsort (p->tgp_arr, p->tgp_nb, sizeof (uint32_t),
+	     rps_trigram_uint32_qcmp);
+      unsigned nbuniq = 0;
+      for (unsigned ix = 0; ix < p->tgp_nb; ix++)
+	if (nbuniq == 0 || p->tgp_arr[nbuniq - 1] != p->tgp_arr[ix])
+	  p->tgp_arr[nbuniq++] = p->tgp_arr[ix];
+      p->tgp_nb = nbuniq;
+      p->tgp_sorted = true;
+    };
+  p->tgp_sortednb = p->tgp_nb;
+}				/* end rps_trigram_sort_posting */
+
+static void
+rps_trigram_add (uint32_t key, uint32_t obix)
+{
+  struct rps_trigram_shard_st *sh = rps_trigram_shard (key);
+  pthread_mutex_lock (&sh->tgs_mtx);
+  struct rps_trigram_posting_st *p = rps_trigram_shard_posting (sh, key,
+								true);
+  if (p->tgp_nb == 0 || p->tgp_arr[p->tgp_nb - 1] != obix)
+    {
+      /// the same strings noted again, e.g. when an attribute is put
+      /// several times, should not grow the posting
+      if (!p->tgp_sorted && p->tgp_nb >= 2 * p->tgp_sortednb + 16)
+	rps_trigram_sort_posting (p);
+      if (p->tgp_nb >= p->tgp_size)
+	{
+	  unsigned newsize = p->tgp_size + p->tgp_size / 2 + 8;
+	  uint32_t *newarr = RPS_ALLOC_ZEROED (newsize * sizeof (uint32_t));
+	  if (p->tgp_nb > 0)
+	    memcpy (newarr, p->tgp_arr, p->tgp_nb * sizeof (uint32_t));
+	  free (p->tgp_arr);
+	  p->tgp_arr = newarr;
+	  p->tgp_size = newsize;
+	};
+      if (p->tgp_nb > 0 && p->tgp_arr[p->tgp_nb - 1] > obix)
+	p->tgp_sorted = false;
+      p->tgp_arr[p->tgp_nb++] = obix;
+    };
+  pthread_mutex_unlock (&sh->tgs_mtx);
+}				/* end rps_trigram_add */
+
+static void
+rps_trigram_note_string (uint32_t obix, RpsValue_t strv)
+{
+  const char *str = rps_stringv_utf8bytes (strv);
+  if (!str)
+    return;
+  pthread_mutex_lock (&rps_trigram_strobs_mtx);
+  rps_bitset_put (rps_trigram_strobs, obix);
+  pthread_mutex_unlock (&rps_trigram_strobs_mtx);
+  size_t len = strlen (str);
+  for (size_t ix = 0; ix + 3 <= len; ix++)
+    rps_trigram_add (rps_trigram_key ((const unsigned char *) str + ix),
+		     obix);
+}				/* end rps_trigram_note_string */
+
+void
+rps_trigram_note_value (RpsObject_t * ob, RpsValue_t val)
+{
+  if (!atomic_load (&rps_trigram_enabled))
+    return;
+  if (rps_value_type (val) != RPS_TYPE_STRING)
+    return;
+  uint32_t obix = rps_object_index (ob);
+  if (obix > 0)
+    rps_trigram_note_string (obix, val);
+}				/* end rps_trigram_note_value */
+
+static rps_value_callback_sig_t rps_trigram_attrval_cb;
+static bool
+rps_trigram_attrval_cb (RpsValue_t val, void *data)
+{
+  RpsObject_t *ob = data;
+  rps_trigram_note_value (ob, val);
+  return true;
+}				/* end rps_trigram_attrval_cb */
+
+void
+rps_trigram_note_payload (RpsObject_t * ob)
+{
+  if (!atomic_load (&rps_trigram_enabled))
+    return;
+  rps_locked_object_scan_payload_strings (ob, rps_trigram_attrval_cb, ob);
+}				/* end rps_trigram_note_payload */
+
+static rps_parallel_object_callback_sig_t rps_trigram_index_object_cb;
+static bool
+rps_trigram_index_object_cb (RpsObject_t * ob, int workix, void *data)
+{
+  rps_object_scan_strings (ob, rps_trigram_attrval_cb, ob);
+  return true;
+}				/* end rps_trigram_index_object_cb */
+
+void
+rps_build_trigram_index (int nbthreads)
+{
+  pthread_once (&rps_trigram_once, rps_trigram_initialize);
+  if (atomic_exchange (&rps_trigram_enabled, true))
+    return;
+  /* Strings put from now on are noted, and each object is scanned
+     under its lock, so none is missed. */
+  rps_parallel_for_each_object (rps_trigram_index_object_cb, NULL,
+				nbthreads);
+}				/* end rps_build_trigram_index */
+
+bool
+rps_trigram_index_built (void)
+{
+  return atomic_load (&rps_trigram_enabled);
+}				/* end rps_trigram_index_built */
+
+static int
+rps_trigram_uint32_qcmp (const void *p1, const void *p2)
+{
+  uint32_t u1 = *(const uint32_t *) p1;
+  uint32_t u2 = *(const uint32_t *) p2;
+  return (u1 < u2) ? -1 : (u1 > u2) ? 1 : 0;
+}				/* end rps_trigram_uint32_qcmp */
+
+/* Copy the sorted object indexes of some trigram into a malloc-ed
+   array, giving their number in *PNB */
+static uint32_t *
+rps_trigram_copy_posting (uint32_t key, unsigned *pnb)
+{
+  uint32_t *arr = NULL;
+  struct rps_trigram_shard_st *sh = rps_trigram_shard (key);
+  *pnb = 0;
+  pthread_mutex_lock (&sh->tgs_mtx);
+  struct rps_trigram_posting_st *p = rps_trigram_shard_posting (sh, key,
+								false);
+  if (p && p->tgp_nb > 0)
+    {
+      rps_trigram_sort_posting (p);
+      arr = RPS_ALLOC_ZEROED (p->tgp_nb * sizeof (uint32_t));
+      memcpy (arr, p->tgp_arr, p->tgp_nb * sizeof (uint32_t));
+      *pnb = p->tgp_nb;
+    };
+  pthread_mutex_unlock (&sh->tgs_mtx);
+  return arr;
+}				/* end rps_trigram_copy_posting */
+
+struct rps_trigram_verify_st
+{
+  const char *tgv_substr;
+  size_t tgv_len;
+  bool tgv_found;
+};
+
+static bool
+rps_trigram_string_matches (RpsValue_t val, struct rps_trigram_verify_st *tv)
+{
+  if (rps_value_type (val) != RPS_TYPE_STRING)
+    return false;
+  const char *str = rps_stringv_utf8bytes (val);
+  return str && memmem (str, strlen (str), tv->tgv_substr, tv->tgv_len);
+}				/* end rps_trigram_string_matches */
+
+static rps_value_callback_sig_t rps_trigram_verify_cb;
+static bool
+rps_trigram_verify_cb (RpsValue_t val, void *data)
+{
+  struct rps_trigram_verify_st *tv = data;
+  if (rps_trigram_string_matches (val, tv))
+    tv->tgv_found = true;
+  return !tv->tgv_found;
+}				/* end rps_trigram_verify_cb */
+
+static bool
+rps_trigram_object_matches (RpsObject_t * ob, const char *substr,
+			    size_t len)
+{
+  struct rps_trigram_verify_st tv = {.tgv_substr = substr,.tgv_len = len };
+  rps_object_scan_strings (ob, rps_trigram_verify_cb, &tv);
+  return tv.tgv_found;
+}				/* end rps_trigram_object_matches */
+
+struct rps_trigram_collect_st
+{
+  uint32_t *tgc_arr;
+  unsigned tgc_nb, tgc_size;
+};
+
+static rps_bitindex_callback_sig_t rps_trigram_collect_cb;
+static bool
+rps_trigram_collect_cb (uint32_t ix, void *data)
+{
+  struct rps_trigram_collect_st *tc = data;
+  if (tc->tgc_nb < tc->tgc_size)
+    tc->tgc_arr[tc->tgc_nb++] = ix;
+  return tc->tgc_nb < tc->tgc_size;
+}				/* end rps_trigram_collect_cb */
+
+/* The set of objects having some string attribute value or component
+   containing SUBSTR, or NULL if the index is not built. */
+const RpsSetOb_t *
+rps_trigram_search (const char *substr)
+{
+  if (!substr || !atomic_load (&rps_trigram_enabled))
+    return NULL;
+  size_t len = strlen (substr);
+  uint32_t *candarr = NULL;
+  unsigned nbcand = 0;
+  if (len < 3)
+    {
+      struct rps_trigram_collect_st tc = { };
+      pthread_mutex_lock (&rps_trigram_strobs_mtx);
+      tc.tgc_size = (unsigned) rps_bitset_popcount (rps_trigram_strobs);
+      tc.tgc_arr = RPS_ALLOC_ZEROED ((tc.tgc_size + 1) * sizeof (uint32_t));
+      rps_bitset_iterate (rps_trigram_strobs, rps_trigram_collect_cb, &tc);
+      pthread_mutex_unlock (&rps_trigram_strobs_mtx);
+      candarr = tc.tgc_arr;
+      nbcand = tc.tgc_nb;
+    }
+  else
+    {
+      /// intersect the sorted lists of every trigram of SUBSTR
+      for (size_t ix = 0; ix + 3 <= len; ix++)
+	{
+	  unsigned nbcur = 0;
+	  uint32_t *curarr =
+	    rps_trigram_copy_posting (rps_trigram_key
+				      ((const unsigned char *) substr + ix),
+				      &nbcur);
+	  if (ix == 0)
+	    {
+	      candarr = curarr;
+	      nbcand = nbcur;
+	    }
+	  else
+	    {
+	      unsigned i = 0, j = 0, nbinter = 0;
+	      while (i < nbcand && j < nbcur)
+		{
+		  if (candarr[i] < curarr[j])
+		    i++;
+		  else if (candarr[i] > curarr[j])
+		    j++;
+		  else
+		    {
+		      candarr[nbinter++] = candarr[i];
+		      i++, j++;
+		    }
+		};
+	      nbcand = nbinter;
+	      free (curarr);
+	    };
+	  if (nbcand == 0)
+	    break;
+	}
+    };
+  const RpsObject_t **obarr =
+    RPS_ALLOC_ZEROED ((nbcand + 1) * sizeof (RpsObject_t *));
+  unsigned nbob = 0;
+  for (unsigned cix = 0; cix < nbcand; cix++)
+    {
+      RpsObject_t *ob = rps_object_of_index (candarr[cix]);
+      if (ob && rps_trigram_object_matches (ob, substr, len))
+	obarr[nbob++] = ob;
+    };
+  const RpsSetOb_t *set = rps_alloc_set_sized (nbob, obarr);
+  free (obarr);
+  free (candarr);
+  return set;
+}				/* end rps_trigram_search */
+
+/****** end of file trigram_rps.c ******/